@@ -0,0 +1,498 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'bp_condition' class: a recursive-descent parser that emits
+    postfix bytecode, and a stack-machine evaluator for it. Division follows
+    the RISC-V M-extension conventions (x/0 = -1, x%0 = x, overflow wraps) so
+    evaluating a condition can never trap.
+********************************************************************************************/
+
+
+#include "bp_condition.h"
+#include "rv32i_hart.h"
+#include "memory.h"
+
+
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+
+// Deepest evaluation stack a condition may need.
+static constexpr int max_depth = 32;
+
+
+static const char *const abi_names[32] =
+{
+    "zero", "ra", "sp",  "gp",  "tp", "t0", "t1", "t2",
+    "s0",   "s1", "a0",  "a1",  "a2", "a3", "a4", "a5",
+    "a6",   "a7", "s2",  "s3",  "s4", "s5", "s6", "s7",
+    "s8",   "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+
+/***************************************************************
+Binary operators by precedence level (0 binds loosest). 'bad'
+lists characters that must not follow the token, so that "|"
+does not match the start of "||", "<" the start of "<<", etc.
+***************************************************************/
+struct binop
+{
+    int level;
+    const char *tok;
+    const char *bad;
+    uint8_t op;
+};
+
+
+/***************************************************************
+Function: bp_condition::compile
+
+
+Use:      Parses expr into bytecode, replacing any previous
+          condition.
+
+
+Arguments:
+    expr - Condition text.
+    err  - Receives a message if parsing fails.
+
+
+Returns:
+    true on success.
+***************************************************************/
+bool bp_condition::compile(const std::string &expr, std::string &err)
+{
+    code.clear();
+    depth = cur_depth = 0;
+
+
+    parser p = { expr, 0, "", 0 };
+    bool ok = parse_binary(p, 0);
+
+
+    while (ok && p.pos < expr.size() && isspace(static_cast<unsigned char>(expr[p.pos])))
+        ++p.pos;
+    if (ok && p.pos != expr.size())
+    {
+        ok = false;
+        p.err = "unexpected '" + expr.substr(p.pos, 1) + "'";
+    }
+    if (ok && depth > max_depth)
+    {
+        ok = false;
+        p.err = "expression too deeply nested";
+    }
+
+
+    if (!ok)
+    {
+        err = p.err + " at column " + std::to_string(p.pos + 1);
+        code.clear();
+    }
+    return ok;
+}
+
+
+/***************************************************************
+Function: bp_condition::eval
+
+
+Use:      Runs the bytecode. Memory operands outside the
+          simulated memory read as 0 without a warning.
+
+
+Arguments:
+    h - Hart supplying registers and pc.
+    m - Memory for memN[] operands.
+
+
+Returns:
+    true if the expression evaluates to a non-zero value.
+***************************************************************/
+bool bp_condition::eval(const rv32i_hart &h, const memory &m) const
+{
+    int32_t st[max_depth];
+    int sp = 0;
+
+
+    for (const insn &i : code)
+    {
+        int32_t a, b;
+        uint32_t addr;
+
+
+        switch (i.op)
+        {
+        case op_const: st[sp++] = i.arg; continue;
+        case op_reg:   st[sp++] = h.get_reg(i.arg); continue;
+        case op_pc:    st[sp++] = static_cast<int32_t>(h.get_pc()); continue;
+
+
+        case op_mem8:
+            addr = static_cast<uint32_t>(st[sp - 1]);
+            st[sp - 1] = addr < m.get_size() ? m.get8(addr) : 0;
+            continue;
+        case op_mem16:
+            addr = static_cast<uint32_t>(st[sp - 1]);
+            st[sp - 1] = uint64_t(addr) + 2 <= m.get_size() ? m.get16(addr) : 0;
+            continue;
+        case op_mem32:
+            addr = static_cast<uint32_t>(st[sp - 1]);
+            st[sp - 1] = uint64_t(addr) + 4 <= m.get_size() ? static_cast<int32_t>(m.get32(addr)) : 0;
+            continue;
+
+
+        case op_neg: st[sp - 1] = static_cast<int32_t>(0u - static_cast<uint32_t>(st[sp - 1])); continue;
+        case op_not: st[sp - 1] = !st[sp - 1]; continue;
+        case op_inv: st[sp - 1] = ~st[sp - 1]; continue;
+
+
+        default:
+            break;
+        }
+
+
+        b = st[--sp];
+        a = st[sp - 1];
+        uint32_t ua = static_cast<uint32_t>(a), ub = static_cast<uint32_t>(b);
+        int32_t r = 0;
+
+
+        switch (i.op)
+        {
+        case op_mul: r = static_cast<int32_t>(ua * ub); break;
+        case op_div: r = b == 0 ? -1 : (a == INT_MIN && b == -1) ? a : a / b; break;
+        case op_rem: r = b == 0 ? a : (a == INT_MIN && b == -1) ? 0 : a % b; break;
+        case op_add: r = static_cast<int32_t>(ua + ub); break;
+        case op_sub: r = static_cast<int32_t>(ua - ub); break;
+        case op_shl: r = static_cast<int32_t>(ua << (ub & 0x1f)); break;
+        case op_sra: r = a >> (ub & 0x1f); break;
+        case op_lt:  r = a <  b; break;
+        case op_le:  r = a <= b; break;
+        case op_gt:  r = a >  b; break;
+        case op_ge:  r = a >= b; break;
+        case op_eq:  r = a == b; break;
+        case op_ne:  r = a != b; break;
+        case op_and: r = a & b; break;
+        case op_xor: r = a ^ b; break;
+        case op_or:  r = a | b; break;
+        case op_land: r = a && b; break;
+        case op_lor:  r = a || b; break;
+        default: break;
+        }
+        st[sp - 1] = r;
+    }
+
+
+    return sp > 0 && st[sp - 1] != 0;
+}
+
+
+/***************************************************************
+Function: bp_condition::parse_binary
+
+
+Use:      Parses a left-associative chain of binary operators of
+          the given precedence level (and everything tighter).
+
+
+Arguments:
+    p     - Parser state.
+    level - Precedence level, 0..9 (10 means unary).
+
+
+Returns:
+    false on a syntax error (p.err is set).
+***************************************************************/
+bool bp_condition::parse_binary(parser &p, int level)
+{
+    static const binop ops[] =
+    {
+        { 0, "||", "",   op_lor },
+        { 1, "&&", "",   op_land },
+        { 2, "|",  "|",  op_or },
+        { 3, "^",  "",   op_xor },
+        { 4, "&",  "&",  op_and },
+        { 5, "==", "",   op_eq },
+        { 5, "!=", "",   op_ne },
+        { 6, "<=", "",   op_le },
+        { 6, ">=", "",   op_ge },
+        { 6, "<",  "<=", op_lt },
+        { 6, ">",  ">=", op_gt },
+        { 7, "<<", "",   op_shl },
+        { 7, ">>", "",   op_sra },
+        { 8, "+",  "",   op_add },
+        { 8, "-",  "",   op_sub },
+        { 9, "*",  "",   op_mul },
+        { 9, "/",  "",   op_div },
+        { 9, "%",  "",   op_rem },
+    };
+
+
+    if (level > 9)
+        return parse_unary(p);
+    if (!parse_binary(p, level + 1))
+        return false;
+
+
+    while (true)
+    {
+        while (p.pos < p.s.size() && isspace(static_cast<unsigned char>(p.s[p.pos])))
+            ++p.pos;
+
+
+        const binop *found = nullptr;
+        for (const binop &b : ops)
+        {
+            size_t n = std::strlen(b.tok);
+            if (b.level == level && p.s.compare(p.pos, n, b.tok) == 0
+                && (p.pos + n >= p.s.size() || !std::strchr(b.bad, p.s[p.pos + n])))
+            {
+                found = &b;
+                break;
+            }
+        }
+        if (!found)
+            return true;
+
+
+        p.pos += std::strlen(found->tok);
+        if (!parse_binary(p, level + 1))
+            return false;
+        emit(static_cast<op_code>(found->op));
+    }
+}
+
+
+/***************************************************************
+Function: bp_condition::parse_unary
+
+
+Use:      Parses prefix -, ! and ~ followed by a primary.
+
+
+Arguments:
+    p - Parser state.
+
+
+Returns:
+    false on a syntax error.
+***************************************************************/
+bool bp_condition::parse_unary(parser &p)
+{
+    // Every prefix operator, '(' and '[' recurses through here, so
+    // bounding the nesting here bounds the native stack too.
+    if (++p.nest > max_depth)
+    {
+        p.err = "expression too deeply nested";
+        return false;
+    }
+
+
+    bool ok;
+    if (skip_ws_match(p, "-"))
+    {
+        ok = parse_unary(p);
+        if (ok)
+            emit(op_neg);
+    }
+    else if (p.s.compare(p.pos, 2, "!=") != 0 && skip_ws_match(p, "!"))
+    {
+        ok = parse_unary(p);
+        if (ok)
+            emit(op_not);
+    }
+    else if (skip_ws_match(p, "~"))
+    {
+        ok = parse_unary(p);
+        if (ok)
+            emit(op_inv);
+    }
+    else
+        ok = parse_primary(p);
+
+
+    --p.nest;
+    return ok;
+}
+
+
+/***************************************************************
+Function: bp_condition::parse_primary
+
+
+Use:      Parses a number, register, pc, memN[expr] or a
+          parenthesised expression.
+
+
+Arguments:
+    p - Parser state.
+
+
+Returns:
+    false on a syntax error.
+***************************************************************/
+bool bp_condition::parse_primary(parser &p)
+{
+    if (skip_ws_match(p, "("))
+    {
+        if (!parse_binary(p, 0))
+            return false;
+        if (!skip_ws_match(p, ")"))
+        {
+            p.err = "expected ')'";
+            return false;
+        }
+        return true;
+    }
+
+
+    if (p.pos >= p.s.size())
+    {
+        p.err = "unexpected end of expression";
+        return false;
+    }
+
+
+    if (isdigit(static_cast<unsigned char>(p.s[p.pos])))
+    {
+        const char *start = p.s.c_str() + p.pos;
+        char *end;
+        unsigned long v = std::strtoul(start, &end, 0);
+        p.pos += end - start;
+        emit(op_const, static_cast<int32_t>(static_cast<uint32_t>(v)));
+        return true;
+    }
+
+
+    size_t start = p.pos;
+    while (p.pos < p.s.size() && isalnum(static_cast<unsigned char>(p.s[p.pos])))
+        ++p.pos;
+    std::string name = p.s.substr(start, p.pos - start);
+
+
+    if (name == "mem8" || name == "mem16" || name == "mem32")
+    {
+        if (!skip_ws_match(p, "["))
+        {
+            p.err = "expected '['";
+            return false;
+        }
+        if (!parse_binary(p, 0))
+            return false;
+        if (!skip_ws_match(p, "]"))
+        {
+            p.err = "expected ']'";
+            return false;
+        }
+        emit(name == "mem8" ? op_mem8 : name == "mem16" ? op_mem16 : op_mem32);
+        return true;
+    }
+
+
+    if (name == "pc")
+    {
+        emit(op_pc);
+        return true;
+    }
+
+
+    if (name == "fp")
+    {
+        emit(op_reg, 8);
+        return true;
+    }
+
+
+    if (name.size() > 1 && name[0] == 'x'
+        && name.find_first_not_of("0123456789", 1) == std::string::npos)
+    {
+        int r = std::atoi(name.c_str() + 1);
+        if (r < 32)
+        {
+            emit(op_reg, r);
+            return true;
+        }
+    }
+
+
+    for (int r = 0; r < 32; ++r)
+    {
+        if (name == abi_names[r])
+        {
+            emit(op_reg, r);
+            return true;
+        }
+    }
+
+
+    p.pos = start;
+    p.err = name.empty() ? "expected an operand" : "unknown name '" + name + "'";
+    return false;
+}
+
+
+/***************************************************************
+Function: bp_condition::skip_ws_match
+
+
+Use:      Skips white space and consumes tok if it comes next.
+
+
+Arguments:
+    p   - Parser state.
+    tok - Token to match.
+
+
+Returns:
+    true if tok was consumed.
+***************************************************************/
+bool bp_condition::skip_ws_match(parser &p, const char *tok)
+{
+    while (p.pos < p.s.size() && isspace(static_cast<unsigned char>(p.s[p.pos])))
+        ++p.pos;
+
+
+    size_t n = std::strlen(tok);
+    if (p.s.compare(p.pos, n, tok) != 0)
+        return false;
+    p.pos += n;
+    return true;
+}
+
+
+/***************************************************************
+Function: bp_condition::emit
+
+
+Use:      Appends one instruction and tracks the stack depth the
+          code will need.
+
+
+Arguments:
+    op  - Operation.
+    arg - Constant or register number.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void bp_condition::emit(op_code op, int32_t arg)
+{
+    code.push_back({ op, arg });
+
+
+    if (op <= op_pc)
+        ++cur_depth;
+    else if (op >= op_mul)
+        --cur_depth;
+
+
+    if (cur_depth > depth)
+        depth = cur_depth;
+}
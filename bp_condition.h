@@ -0,0 +1,103 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'bp_condition' class, a breakpoint condition such as
+
+        x10 == 0x42 && mem32[sp+8] > 100
+
+    The expression is parsed once into a compact postfix bytecode that is run
+    on a small fixed-size stack each time the breakpoint's pc is reached.
+    Operands are numbers (decimal or 0x hex), registers by number (x0-x31) or
+    ABI name (zero, ra, sp, ..., t6, fp), pc, and memory reads
+    mem8[e], mem16[e], mem32[e]. Operators, lowest precedence first:
+
+        ||   &&   |   ^   &   == !=   < <= > >=   << >>   + -   * / %   - ! ~
+
+    Comparisons are signed, as for C ints.
+********************************************************************************************/
+
+
+#ifndef BP_CONDITION_H
+#define BP_CONDITION_H
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+class rv32i_hart;
+class memory;
+
+
+/***************************************************************
+Class: bp_condition
+
+
+Use:   A compiled breakpoint condition. compile() parses the
+       expression; eval() runs it against a hart's state.
+
+
+Data:
+       code   - Postfix instructions.
+       depth  - Maximum stack depth the code needs.
+***************************************************************/
+class bp_condition
+{
+public:
+    // Parse expr. On failure returns false and describes the error.
+    bool compile(const std::string &expr, std::string &err);
+
+
+    // Evaluate against the current state; true if non-zero.
+    bool eval(const rv32i_hart &h, const memory &m) const;
+
+
+    bool empty() const { return code.empty(); }
+
+
+private:
+    enum op_code : uint8_t
+    {
+        op_const, op_reg, op_pc, op_mem8, op_mem16, op_mem32,
+        op_neg, op_not, op_inv,
+        op_mul, op_div, op_rem, op_add, op_sub, op_shl, op_sra,
+        op_lt, op_le, op_gt, op_ge, op_eq, op_ne,
+        op_and, op_xor, op_or, op_land, op_lor
+    };
+
+
+    struct insn
+    {
+        op_code op;
+        int32_t arg;
+    };
+
+
+    // Recursive-descent parser state.
+    struct parser
+    {
+        const std::string &s;
+        size_t pos;
+        std::string err;
+        int nest;
+    };
+
+
+    bool parse_binary(parser &p, int level);
+    bool parse_unary(parser &p);
+    bool parse_primary(parser &p);
+    static bool skip_ws_match(parser &p, const char *tok);
+    void emit(op_code op, int32_t arg = 0);
+
+
+    std::vector<insn> code;
+    int depth = 0;
+    int cur_depth = 0;
+};
+
+
+#endif
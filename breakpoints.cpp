@@ -0,0 +1,411 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'breakpoints' class. The page bitmaps cover the whole 32-bit
+    address space (2^20 pages, 128 KiB per bitmap). Pages that hold breakpoints
+    also get a 1024-bit map with one bit per instruction word, so an exact
+    breakpoint test is two bit tests and one hash lookup. Conditions are
+    compiled once by set_condition() and run only on an exact pc match.
+********************************************************************************************/
+
+
+#include "breakpoints.h"
+#include <algorithm>
+
+
+static constexpr uint32_t page_bitmap_words = (1u << (32 - breakpoints::page_shift)) / 64;
+static constexpr uint32_t words_per_page    = (1u << breakpoints::page_shift) / 4;
+
+
+/***************************************************************
+Function: breakpoints::breakpoints
+
+
+Use:      Constructor. Allocates the (empty) page bitmaps.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+breakpoints::breakpoints()
+    : bp_pages(page_bitmap_words, 0),
+      wp_pages(page_bitmap_words, 0)
+{
+}
+
+
+/***************************************************************
+Function: breakpoints::add_breakpoint
+
+
+Use:      Adds an execution breakpoint on the instruction at addr.
+
+
+Arguments:
+    addr - Instruction address.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void breakpoints::add_breakpoint(uint32_t addr)
+{
+    if (bp_refs[addr]++ != 0)
+        return;
+
+
+    uint32_t page = addr >> page_shift;
+    std::vector<uint64_t> &words = bp_words[page];
+    if (words.empty())
+        words.assign(words_per_page / 64, 0);
+
+
+    set_bit(words, (addr & ((1u << page_shift) - 1)) >> 2);
+    set_bit(bp_pages, page);
+}
+
+
+/***************************************************************
+Function: breakpoints::remove_breakpoint
+
+
+Use:      Removes one reference to the breakpoint at addr. The
+          breakpoint disappears when its last reference goes.
+
+
+Arguments:
+    addr - Instruction address.
+
+
+Returns:
+    false if there was no breakpoint at addr.
+***************************************************************/
+bool breakpoints::remove_breakpoint(uint32_t addr)
+{
+    auto it = bp_refs.find(addr);
+    if (it == bp_refs.end())
+        return false;
+    if (--it->second != 0)
+        return true;
+    bp_refs.erase(it);
+
+
+    uint32_t page = addr >> page_shift;
+    std::vector<uint64_t> &words = bp_words[page];
+    clear_bit(words, (addr & ((1u << page_shift) - 1)) >> 2);
+
+
+    for (uint64_t w : words)
+        if (w)
+            return true;
+
+
+    bp_words.erase(page);
+    clear_bit(bp_pages, page);
+    return true;
+}
+
+
+/***************************************************************
+Function: breakpoints::add_watchpoint
+
+
+Use:      Adds a watchpoint on the byte range [addr, addr+len).
+
+
+Arguments:
+    addr - First watched byte.
+    len  - Number of bytes watched (0 is treated as 1).
+    t    - Access types that trigger it.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void breakpoints::add_watchpoint(uint32_t addr, uint32_t len, watch_type t)
+{
+    watches.push_back({ addr, len ? len : 1, t });
+    rebuild_watch_pages();
+}
+
+
+/***************************************************************
+Function: breakpoints::remove_watchpoint
+
+
+Use:      Removes a watchpoint previously added with the same
+          range and type.
+
+
+Arguments:
+    addr - First watched byte.
+    len  - Number of bytes watched.
+    t    - Access types.
+
+
+Returns:
+    false if no such watchpoint exists.
+***************************************************************/
+bool breakpoints::remove_watchpoint(uint32_t addr, uint32_t len, watch_type t)
+{
+    if (len == 0)
+        len = 1;
+
+
+    for (auto it = watches.begin(); it != watches.end(); ++it)
+    {
+        if (it->addr == addr && it->len == len && it->type == t)
+        {
+            watches.erase(it);
+            rebuild_watch_pages();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/***************************************************************
+Function: breakpoints::set_condition
+
+
+Use:      Compiles expr and attaches it to the breakpoint at addr.
+          The hit counter restarts.
+
+
+Arguments:
+    addr - Breakpoint address.
+    expr - Condition text, or empty to remove the condition.
+    err  - Receives the parse error, if any.
+
+
+Returns:
+    false if expr does not parse (the old condition is kept).
+***************************************************************/
+bool breakpoints::set_condition(uint32_t addr, const std::string &expr, std::string &err)
+{
+    bp_condition c;
+    if (!expr.empty() && !c.compile(expr, err))
+        return false;
+
+
+    stop_rule &r = bp_stops[addr];
+    r.cond = c;
+    r.hits = 0;
+
+
+    if (r.cond.empty() && r.hits_needed <= 1)
+        bp_stops.erase(addr);
+    return true;
+}
+
+
+/***************************************************************
+Function: breakpoints::set_hit_count
+
+
+Use:      Makes the breakpoint at addr stop only from its n-th
+          qualifying hit on. The hit counter restarts.
+
+
+Arguments:
+    addr - Breakpoint address.
+    n    - Hits needed before stopping.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void breakpoints::set_hit_count(uint32_t addr, uint32_t n)
+{
+    stop_rule &r = bp_stops[addr];
+    r.hits_needed = n;
+    r.hits = 0;
+
+
+    if (r.cond.empty() && r.hits_needed <= 1)
+        bp_stops.erase(addr);
+}
+
+
+/***************************************************************
+Function: breakpoints::clear
+
+
+Use:      Removes every breakpoint and watchpoint.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void breakpoints::clear()
+{
+    for (const auto &p : bp_words)
+        clear_bit(bp_pages, p.first);
+    bp_words.clear();
+    bp_refs.clear();
+    bp_stops.clear();
+
+
+    watches.clear();
+    rebuild_watch_pages();
+}
+
+
+/***************************************************************
+Function: breakpoints::hit_word
+
+
+Use:      Exact breakpoint test, made after the page filter has
+          passed.
+
+
+Arguments:
+    pc - Instruction address.
+
+
+Returns:
+    true if the word at pc carries a breakpoint.
+***************************************************************/
+bool breakpoints::hit_word(uint32_t pc) const
+{
+    auto it = bp_words.find(pc >> page_shift);
+    if (it == bp_words.end())
+        return false;
+
+
+    uint32_t w = (pc & ((1u << page_shift) - 1)) >> 2;
+    return (it->second[w >> 6] >> (w & 63)) & 1;
+}
+
+
+/***************************************************************
+Function: breakpoints::check_stop
+
+
+Use:      Applies the condition and hit count of the breakpoint
+          at pc, counting the hit if the condition holds.
+
+
+Arguments:
+    pc - Address of the breakpoint reached.
+    h  - Hart whose state the condition reads.
+    m  - Memory the condition reads.
+
+
+Returns:
+    true if execution should stop.
+***************************************************************/
+bool breakpoints::check_stop(uint32_t pc, const rv32i_hart &h, const memory &m)
+{
+    auto it = bp_stops.find(pc);
+    if (it == bp_stops.end())
+        return true;
+
+
+    stop_rule &r = it->second;
+    if (!r.cond.empty() && !r.cond.eval(h, m))
+        return false;
+
+
+    if (r.hits < r.hits_needed)
+        ++r.hits;
+    return r.hits >= r.hits_needed;
+}
+
+
+/***************************************************************
+Function: breakpoints::condition_holds
+
+
+Use:      Evaluates the condition of the breakpoint at pc without
+          counting a hit, for stopping in reverse execution.
+
+
+Arguments:
+    pc - Address of the breakpoint reached.
+    h  - Hart whose state the condition reads.
+    m  - Memory the condition reads.
+
+
+Returns:
+    true if there is no condition or it is true.
+***************************************************************/
+bool breakpoints::condition_holds(uint32_t pc, const rv32i_hart &h, const memory &m) const
+{
+    auto it = bp_stops.find(pc);
+    return it == bp_stops.end() || it->second.cond.empty() || it->second.cond.eval(h, m);
+}
+
+
+/***************************************************************
+Function: breakpoints::hit_range
+
+
+Use:      Exact watchpoint test, made after the page filter has
+          passed.
+
+
+Arguments:
+    addr - First byte accessed.
+    len  - Access width in bytes.
+    t    - watch_read or watch_write.
+
+
+Returns:
+    true if the access overlaps a watchpoint of a matching type.
+***************************************************************/
+bool breakpoints::hit_range(uint32_t addr, uint32_t len, watch_type t) const
+{
+    uint64_t lo = addr;
+    uint64_t hi = uint64_t(addr) + len;
+
+
+    for (const watch &w : watches)
+    {
+        if ((w.type & t) && lo < uint64_t(w.addr) + w.len && w.addr < hi)
+            return true;
+    }
+    return false;
+}
+
+
+/***************************************************************
+Function: breakpoints::rebuild_watch_pages
+
+
+Use:      Recomputes the watchpoint page bitmap from the list of
+          watchpoints.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void breakpoints::rebuild_watch_pages()
+{
+    std::fill(wp_pages.begin(), wp_pages.end(), 0);
+
+
+    for (const watch &w : watches)
+    {
+        uint32_t first = w.addr >> page_shift;
+        uint32_t last  = uint32_t((uint64_t(w.addr) + w.len - 1) >> page_shift);
+        for (uint32_t p = first; p <= last && p < (1u << (32 - page_shift)); ++p)
+            set_bit(wp_pages, p);
+    }
+}
@@ -0,0 +1,172 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'breakpoints' class, which holds the execution breakpoints and
+    data watchpoints checked by a hart. Both kinds are filtered through a
+    bitmap with one bit per 4 KiB page, so an address on a page without any
+    breakpoint (or watchpoint) is rejected with a single bit test before any
+    exact comparison is made. A breakpoint may carry a condition and a hit
+    count; these are only looked at once the pc has matched.
+********************************************************************************************/
+
+
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+#include "bp_condition.h"
+
+
+/***************************************************************
+Class: breakpoints
+
+
+Use:   Set of execution breakpoints and read/write watchpoints.
+       A hart with a breakpoints object attached consults it
+       before each instruction (breakpoints) and on each load
+       and store (watchpoints).
+
+
+Data:
+       bp_pages    - One bit per page: page holds a breakpoint.
+       bp_words    - For pages with breakpoints, one bit per
+                     instruction word on the page.
+       bp_refs     - Reference count of each breakpoint address.
+       bp_stops    - Condition and hit count of breakpoints that
+                     have either.
+       wp_pages    - One bit per page: a watchpoint overlaps it.
+       watches     - The watchpoint ranges.
+***************************************************************/
+class breakpoints
+{
+public:
+    static constexpr uint32_t page_shift = 12;
+
+
+    enum watch_type : uint8_t
+    {
+        watch_read   = 1,
+        watch_write  = 2,
+        watch_access = 3
+    };
+
+
+    breakpoints();
+
+
+    // Execution breakpoints. Setting the same address twice needs two
+    // removes (debuggers may insert a breakpoint more than once).
+    void add_breakpoint(uint32_t addr);
+    bool remove_breakpoint(uint32_t addr);
+
+
+    // Watchpoints on [addr, addr+len).
+    void add_watchpoint(uint32_t addr, uint32_t len, watch_type t);
+    bool remove_watchpoint(uint32_t addr, uint32_t len, watch_type t);
+
+
+    // Attach a condition to the breakpoint at addr; an empty expr
+    // removes it. Returns false (with err set) if expr does not parse.
+    // Conditions and hit counts outlive remove_breakpoint(), since GDB
+    // takes its breakpoints out and puts them back at every stop.
+    bool set_condition(uint32_t addr, const std::string &expr, std::string &err);
+
+
+    // Stop only from the n-th time the breakpoint at addr is reached
+    // with its condition true (0 or 1 stops every time).
+    void set_hit_count(uint32_t addr, uint32_t n);
+
+
+    void clear();
+
+
+    bool has_breakpoints() const   { return !bp_refs.empty(); }
+    bool has_watchpoints() const   { return !watches.empty(); }
+
+
+    // Is there a breakpoint on the instruction at pc?
+    bool is_breakpoint(uint32_t pc) const
+    {
+        uint32_t page = pc >> page_shift;
+        if (!((bp_pages[page >> 6] >> (page & 63)) & 1))
+            return false;
+        return hit_word(pc);
+    }
+
+
+    // Called once is_breakpoint(pc) is true: evaluates the condition
+    // and hit count, if any, and says whether to stop.
+    bool should_stop(uint32_t pc, const rv32i_hart &h, const memory &m)
+    {
+        if (bp_stops.empty())
+            return true;
+        return check_stop(pc, h, m);
+    }
+
+
+    // For reverse execution: is the condition of the breakpoint at pc,
+    // if any, true? Hit counts are left alone; they count forward hits.
+    bool condition_holds(uint32_t pc, const rv32i_hart &h, const memory &m) const;
+
+
+    // Does an access of type t to [addr, addr+len) touch a watchpoint?
+    bool is_watched(uint32_t addr, uint32_t len, watch_type t) const
+    {
+        uint32_t first = addr >> page_shift;
+        uint32_t last  = (addr + len - 1) >> page_shift;
+        if (!((wp_pages[first >> 6] >> (first & 63)) & 1)
+            && !((wp_pages[last >> 6] >> (last & 63)) & 1))
+            return false;
+        return hit_range(addr, len, t);
+    }
+
+
+private:
+    struct watch
+    {
+        uint32_t addr;
+        uint32_t len;
+        watch_type type;
+    };
+
+
+    struct stop_rule
+    {
+        bp_condition cond;
+        uint32_t hits_needed = 0;
+        uint32_t hits        = 0;
+    };
+
+
+    bool hit_word(uint32_t pc) const;
+    bool check_stop(uint32_t pc, const rv32i_hart &h, const memory &m);
+    bool hit_range(uint32_t addr, uint32_t len, watch_type t) const;
+    void rebuild_watch_pages();
+
+
+    static void set_bit(std::vector<uint64_t> &v, uint32_t i)   { v[i >> 6] |= uint64_t(1) << (i & 63); }
+    static void clear_bit(std::vector<uint64_t> &v, uint32_t i) { v[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+
+
+    std::vector<uint64_t> bp_pages;
+    std::unordered_map<uint32_t, std::vector<uint64_t>> bp_words;
+    std::map<uint32_t, unsigned> bp_refs;
+    std::unordered_map<uint32_t, stop_rule> bp_stops;
+
+
+    std::vector<uint64_t> wp_pages;
+    std::vector<watch> watches;
+};
+
+
+#endif
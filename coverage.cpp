@@ -0,0 +1,363 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'coverage' class. Bits are set in on_insn and on_branch;
+    everything else, from counting blocks to mapping addresses to source
+    lines, is done once at the end of the run.
+********************************************************************************************/
+
+
+#include "coverage.h"
+
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+
+#include "rv32i_decode.h"
+
+
+/***************************************************************
+Function: coverage::coverage
+
+
+Use:      Sets up empty bitmaps for a memory, with the entry
+          point as the first block leader.
+
+
+Arguments:
+    mem   - The hart's memory.
+    entry - Address of the first instruction.
+***************************************************************/
+coverage::coverage(const memory &mem, uint32_t entry)
+    : pages((uint64_t(mem.get_size()) + memory::page_size - 1) >> memory::page_bits)
+{
+    set(leader, entry);
+}
+
+
+/***************************************************************
+Function: coverage::set / test
+
+
+Use:      Set or test an instruction's bit in a bitmap.
+
+
+Arguments:
+    b    - Bitmap.
+    addr - Instruction address.
+
+
+Returns:
+    test: the bit.
+***************************************************************/
+void coverage::set(bitmap b, uint32_t addr)
+{
+    uint32_t page = addr >> memory::page_bits;
+    if (page >= pages.size())
+        return;
+    if (!pages[page])
+        pages[page] = std::make_unique<page_map>();
+    uint32_t i = (addr & (memory::page_size - 1)) >> 2;
+    pages[page]->bits[b][i >> 6] |= uint64_t(1) << (i & 63);
+}
+
+
+bool coverage::test(bitmap b, uint32_t addr) const
+{
+    uint32_t page = addr >> memory::page_bits;
+    if (page >= pages.size() || !pages[page])
+        return false;
+    uint32_t i = (addr & (memory::page_size - 1)) >> 2;
+    return (pages[page]->bits[b][i >> 6] >> (i & 63)) & 1;
+}
+
+
+/***************************************************************
+Function: coverage::count
+
+
+Use:      Counts the executed instructions whose bit is set in a
+          bitmap.
+
+
+Arguments:
+    b - Bitmap.
+
+
+Returns:
+    The count.
+***************************************************************/
+uint64_t coverage::count(bitmap b) const
+{
+    uint64_t n = 0;
+    for (const auto &p : pages)
+    {
+        if (!p)
+            continue;
+        for (uint32_t w = 0; w < words; ++w)
+            n += __builtin_popcountll(p->bits[b][w] & p->bits[executed][w]);
+    }
+    return n;
+}
+
+
+/***************************************************************
+Function: coverage::on_insn
+
+
+Use:      Marks the instruction executed.
+
+
+Arguments:
+    pc   - Instruction address.
+    insn - Instruction word (unused).
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void coverage::on_insn(uint32_t pc, uint32_t insn)
+{
+    (void)insn;
+    set(executed, pc);
+}
+
+
+/***************************************************************
+Function: coverage::on_branch
+
+
+Use:      Marks the direction a conditional branch went, and the
+          instruction control goes to as a block leader.
+
+
+Arguments:
+    pc          - Branch address.
+    target      - Branch target.
+    taken       - The branch was taken.
+    conditional - A conditional branch (else a jump).
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void coverage::on_branch(uint32_t pc, uint32_t target, bool taken, bool conditional)
+{
+    if (conditional)
+        set(taken ? coverage::taken : fallthru, pc);
+    set(leader, taken ? target : pc + 4);
+}
+
+
+/***************************************************************
+Function: coverage::add_line_info
+
+
+Use:      Reads the line tables of an ELF image.
+
+
+Arguments:
+    fname - ELF file name.
+
+
+Returns:
+    false (after printing why) if the file can't be read.
+***************************************************************/
+bool coverage::add_line_info(const std::string &fname)
+{
+    debug_line t;
+    if (!t.read(fname))
+        return false;
+    tables.push_back(std::move(t));
+    return true;
+}
+
+
+/***************************************************************
+Function: coverage::lines
+
+
+Use:      Maps the line tables' address ranges to source lines,
+          with whether each line ran and its conditional
+          branches.
+
+
+Arguments:
+    mem - Memory holding the program.
+
+
+Returns:
+    Coverage per source file and line.
+***************************************************************/
+coverage::line_map coverage::lines(const memory &mem) const
+{
+    line_map m;
+    for (const debug_line &t : tables)
+    {
+        for (const debug_line::range &r : t.get_ranges())
+        {
+            line_info &li = m[t.get_files()[r.file]][r.line];
+            uint64_t end = std::min<uint64_t>(r.hi, mem.get_size());
+            for (uint64_t a = (uint64_t(r.lo) + 3) & ~uint64_t(3); a + 4 <= end; a += 4)
+            {
+                uint32_t addr = static_cast<uint32_t>(a);
+                if (test(executed, addr))
+                    li.hit = true;
+                if (rv32i_decode::get_opcode(mem.get32(addr)) == rv32i_decode::opcode_btype
+                    && std::find(li.branches.begin(), li.branches.end(), addr) == li.branches.end())
+                    li.branches.push_back(addr);
+            }
+        }
+    }
+    return m;
+}
+
+
+/***************************************************************
+Function: coverage::report
+
+
+Use:      Prints the number of instructions and basic blocks
+          executed and the directions taken of the branches that
+          ran, and, if there are line tables, the source lines hit
+          and the directions taken of all the conditional branches
+          they cover (the same counts as lcov's LH/LF and BRH/BRF).
+
+
+Arguments:
+    os  - Output stream.
+    mem - Memory holding the program.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void coverage::report(std::ostream &os, const memory &mem)
+{
+    uint64_t branches = 0;
+    for (const auto &p : pages)
+    {
+        if (!p)
+            continue;
+        for (uint32_t w = 0; w < words; ++w)
+            branches += __builtin_popcountll(p->bits[taken][w] | p->bits[fallthru][w]);
+    }
+    uint64_t directions = count(taken) + count(fallthru);
+
+
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+
+
+    os << "Coverage: " << count(executed) << " instructions, " << count(leader) << " basic blocks, "
+       << directions << " of " << 2 * branches << " directions of the branches run ("
+       << (branches ? 50.0 * directions / branches : 0.0) << "%)" << std::endl;
+
+
+    if (!tables.empty())
+    {
+        line_map m = lines(mem);
+        uint64_t found = 0, hit = 0, brf = 0, brh = 0;
+        for (const auto &f : m)
+        {
+            for (const auto &l : f.second)
+            {
+                ++found;
+                hit += l.second.hit;
+                for (uint32_t addr : l.second.branches)
+                {
+                    brf += 2;
+                    brh += test(taken, addr) + test(fallthru, addr);
+                }
+            }
+        }
+        os << "  lines: " << hit << " of " << found << " (" << (found ? 100.0 * hit / found : 0.0)
+           << "%) in " << m.size() << " source files" << std::endl;
+        os << "  branches: " << brh << " of " << brf << " directions ("
+           << (brf ? 100.0 * brh / brf : 0.0) << "%)" << std::endl;
+    }
+
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+
+/***************************************************************
+Function: coverage::write_lcov
+
+
+Use:      Writes an lcov tracefile: per source file, a DA record
+          per line (1 if any of its instructions ran, else 0) and
+          two BRDA records per conditional branch (taken, not
+          taken; "-" if the branch never ran).
+
+
+Arguments:
+    fname - Output file name.
+    mem   - Memory holding the program.
+
+
+Returns:
+    false (after printing why) if the file can't be written.
+***************************************************************/
+bool coverage::write_lcov(const std::string &fname, const memory &mem)
+{
+    std::ofstream out(fname, std::ios::out | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Can't open file '" << fname << "' for writing." << std::endl;
+        return false;
+    }
+
+
+    for (const auto &f : lines(mem))
+    {
+        out << "TN:\n" << "SF:" << f.first << "\n";
+
+
+        uint64_t brf = 0, brh = 0;
+        for (const auto &l : f.second)
+        {
+            for (size_t i = 0; i < l.second.branches.size(); ++i)
+            {
+                uint32_t addr = l.second.branches[i];
+                bool ran = test(executed, addr);
+                for (int dir = 0; dir < 2; ++dir)
+                {
+                    bool went = test(dir == 0 ? taken : fallthru, addr);
+                    out << "BRDA:" << l.first << "," << i << "," << dir << ","
+                        << (ran ? (went ? "1" : "0") : "-") << "\n";
+                    ++brf;
+                    brh += went;
+                }
+            }
+        }
+        out << "BRF:" << brf << "\n" << "BRH:" << brh << "\n";
+
+
+        uint64_t lh = 0;
+        for (const auto &l : f.second)
+        {
+            out << "DA:" << l.first << "," << (l.second.hit ? 1 : 0) << "\n";
+            lh += l.second.hit;
+        }
+        out << "LF:" << f.second.size() << "\n" << "LH:" << lh << "\n" << "end_of_record\n";
+    }
+
+
+    out.close();
+    if (!out)
+    {
+        std::cerr << "Error writing file '" << fname << "'." << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,116 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'coverage' class, which records which instructions, basic
+    blocks and branch directions a run executes, and maps them back to
+    source lines through the DWARF line tables of the program's ELF images.
+    The result is written as an lcov tracefile, so a firmware test suite
+    run on the simulator can be measured with the usual coverage tools
+    (genhtml, or any CI plugin that reads lcov).
+********************************************************************************************/
+
+
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+#include "debug_line.h"
+#include "memory.h"
+#include "rv32i_observer.h"
+
+
+/***************************************************************
+Class: coverage
+
+
+Use:   Observer that keeps bitmaps, one bit per instruction word,
+       of the instructions executed, the basic block leaders
+       reached (the entry point, jump and taken branch targets,
+       and the instructions after branches not taken), and the
+       branches taken and not taken. Setting a bit that is
+       already set changes nothing, so only an instruction's
+       first execution matters, and the per-instruction cost is
+       one OR into a bitmap. Bitmaps are allocated a page at a
+       time, for the pages that run code.
+
+       Line coverage: a source line is found if a line table
+       maps any address to it, and hit if any instruction at
+       those addresses ran. Each conditional branch on a line
+       adds two lcov branch records, taken and not taken.
+
+
+Data:
+       pages  - Per memory page, its bitmaps, or null.
+       tables - Line tables read from the ELF images.
+***************************************************************/
+class coverage : public rv32i_observer
+{
+public:
+    coverage(const memory &mem, uint32_t entry);
+
+
+    void on_insn(uint32_t pc, uint32_t insn) override;
+    void on_branch(uint32_t pc, uint32_t target, bool taken, bool conditional) override;
+
+
+    // Read the line tables of an ELF image. Returns false (after
+    // printing why) if it can't be read.
+    bool add_line_info(const std::string &fname);
+
+
+    // Print instruction, block, branch and line coverage.
+    void report(std::ostream &os, const memory &mem);
+
+
+    // Write line and branch coverage as an lcov tracefile.
+    // Returns false (after printing why) if it can't be written.
+    bool write_lcov(const std::string &fname, const memory &mem);
+
+
+private:
+    enum bitmap { executed, leader, taken, fallthru, bitmaps };
+
+
+    static constexpr uint32_t words = memory::page_size / 4 / 64;
+
+
+    struct page_map
+    {
+        uint64_t bits[bitmaps][words] = {{0}};
+    };
+
+
+    struct line_info
+    {
+        bool hit = false;
+        std::vector<uint32_t> branches;         // conditional branch addresses
+    };
+
+
+    // Source file -> line -> coverage.
+    using line_map = std::map<std::string, std::map<uint32_t, line_info>>;
+
+
+    void     set(bitmap b, uint32_t addr);
+    bool     test(bitmap b, uint32_t addr) const;
+    uint64_t count(bitmap b) const;
+    line_map lines(const memory &mem) const;
+
+
+    std::vector<std::unique_ptr<page_map>> pages;
+    std::vector<debug_line> tables;
+};
+
+
+#endif
@@ -6,16 +6,29 @@ Programmer:  Aasim Ghani
 Purpose:
     Implements the cpu_single_hart class run() method. This method:
       - Sets register x2 to the size of the simulated memory so that programs
-        can determine the memory size.
+        can determine the memory size, or, for a program given arguments,
+        builds its initial stack:
+
+              top of memory   argv strings, then envp strings
+                              16 AT_RANDOM bytes (16-byte aligned)
+                              auxv: AT_PAGESZ, AT_ENTRY, AT_RANDOM, AT_NULL
+                              envp[0..envc-1], 0
+                              argv[0..argc-1], 0
+              sp (16-aligned) argc
+
+        with a0 = argc, a1 = argv and a2 = envp, as in main(argc, argv, envp).
       - Executes instructions by repeatedly calling tick(), either:
           * until the hart is halted (exec_limit == 0), or
           * until the hart is halted or the instruction-count limit is reached.
+      - With a trace window, runs untraced up to each window boundary and
+        switches tracing on or off exactly there.
       - If the hart halts, prints the halt reason.
       - Always prints the total number of instructions executed.
 ********************************************************************************************/
 
 
 #include "cpu_single_hart.h"
+#include <algorithm>
 #include <iostream>
 
 
@@ -23,14 +36,131 @@ using std::cout;
 using std::endl;
 
 
-void cpu_single_hart::run(uint64_t exec_limit)
+void cpu_single_hart::start()
 {
     // Per assignment: x2 contains the memory size (in bytes) before execution.
     // mem and regs are protected members of rv32i_hart.
     regs.set(2, static_cast<int32_t>(mem.get_size()));
 
 
-    if (exec_limit == 0)
+    if (!guest_argv.empty())
+        build_stack();
+}
+
+
+bool cpu_single_hart::set_guest_args(const std::vector<std::string> &argv,
+                                     const std::vector<std::string> &envp)
+{
+    guest_argv = argv;
+    guest_envp = envp;
+    if (stack_sp() > 0)
+        return true;
+
+
+    guest_argv.clear();
+    guest_envp.clear();
+    return false;
+}
+
+
+uint64_t cpu_single_hart::stack_sp() const
+{
+    uint64_t strings = 0;
+    for (const auto &a : guest_argv)
+        strings += a.size() + 1;
+    for (const auto &e : guest_envp)
+        strings += e.size() + 1;
+
+
+    // argc, argv + NULL, envp + NULL, and four auxv pairs.
+    uint64_t words = 1 + (guest_argv.size() + 1) + (guest_envp.size() + 1) + 8;
+
+
+    uint64_t top = mem.get_size();
+    if (strings + 16 + 4 * words + 32 > top)
+        return 0;
+
+
+    uint64_t random = ((top - strings) & ~uint64_t(15)) - 16;
+    return (random - 4 * words) & ~uint64_t(15);
+}
+
+
+void cpu_single_hart::build_stack()
+{
+    static const uint32_t at_null = 0, at_pagesz = 6, at_entry = 9, at_random = 25;
+
+
+    uint32_t top = mem.get_size();
+    uint32_t sp  = static_cast<uint32_t>(stack_sp());
+
+
+    // Strings at the very top, argv's first.
+    uint32_t str = top;
+    for (const auto &a : guest_argv)
+        str -= static_cast<uint32_t>(a.size() + 1);
+    for (const auto &e : guest_envp)
+        str -= static_cast<uint32_t>(e.size() + 1);
+    uint32_t random = (str & ~15u) - 16;
+
+
+    auto put_string = [&](const std::string &s)
+    {
+        uint32_t at = str;
+        mem.write_block(at, reinterpret_cast<const uint8_t *>(s.c_str()),
+                        static_cast<uint32_t>(s.size() + 1));
+        str += static_cast<uint32_t>(s.size() + 1);
+        return at;
+    };
+
+
+    std::vector<uint32_t> argv_ptrs, envp_ptrs;
+    for (const auto &a : guest_argv)
+        argv_ptrs.push_back(put_string(a));
+    for (const auto &e : guest_envp)
+        envp_ptrs.push_back(put_string(e));
+
+
+    // AT_RANDOM bytes are fixed, so runs stay reproducible.
+    for (uint32_t i = 0; i < 16; ++i)
+        mem.set8(random + i, static_cast<uint8_t>(0x5a ^ (i * 0x1d)));
+
+
+    uint32_t p = sp;
+    auto push = [&](uint32_t w) { mem.set32(p, w); p += 4; };
+
+
+    push(static_cast<uint32_t>(guest_argv.size()));
+    for (uint32_t a : argv_ptrs)
+        push(a);
+    push(0);
+    uint32_t envp = p;
+    for (uint32_t e : envp_ptrs)
+        push(e);
+    push(0);
+    push(at_pagesz);  push(4096);
+    push(at_entry);   push(get_pc());
+    push(at_random);  push(random);
+    push(at_null);    push(0);
+
+
+    regs.set(2, static_cast<int32_t>(sp));
+    regs.set(10, static_cast<int32_t>(guest_argv.size()));
+    regs.set(11, static_cast<int32_t>(sp + 4));
+    regs.set(12, static_cast<int32_t>(envp));
+}
+
+
+void cpu_single_hart::run(uint64_t exec_limit)
+{
+    start();
+
+
+    if (window.is_set())
+    {
+        run_window(exec_limit);
+    }
+    else if (exec_limit == 0)
     {
         // No limit: run until the hart halts.
         while (!is_halted())
@@ -60,3 +190,79 @@ void cpu_single_hart::run(uint64_t exec_limit)
     cout << get_insn_counter() << " instructions executed" << endl;
 }
 
+
+void cpu_single_hart::run_window(uint64_t exec_limit)
+{
+    trace_insns = get_show_instructions();
+    trace_regs  = get_show_registers();
+
+
+    uint64_t limit = exec_limit ? exec_limit : UINT64_MAX;
+    uint64_t every = window.every > 1 ? window.every : 0;
+
+
+    while (!is_halted() && get_insn_counter() < limit)
+    {
+        uint64_t n = get_insn_counter();
+
+
+        if (n < window.start)
+        {
+            // Before the window: untraced up to its first instruction.
+            run_to(std::min(window.start, limit), false);
+        }
+        else if (n >= window.end)
+        {
+            run_to(limit, false);
+        }
+        else if (!window.pc_ranges.empty())
+        {
+            // pc filters can only be decided one instruction at a time.
+            run_to(n + 1, traced_here());
+        }
+        else if (every && n % every != 0)
+        {
+            // Untraced up to the next sampled instruction.
+            uint64_t next = n + (every - n % every);
+            run_to(std::min({ next, window.end, limit }), false);
+        }
+        else
+        {
+            run_to(every ? n + 1 : std::min(window.end, limit), true);
+        }
+    }
+
+
+    set_show_instructions(trace_insns);
+    set_show_registers(trace_regs);
+}
+
+
+void cpu_single_hart::run_to(uint64_t stop, bool traced)
+{
+    set_show_instructions(traced && trace_insns);
+    set_show_registers(traced && trace_regs);
+
+
+    while (!is_halted() && get_insn_counter() < stop)
+    {
+        tick();
+    }
+}
+
+
+bool cpu_single_hart::traced_here() const
+{
+    uint64_t n = get_insn_counter();
+    if (window.every > 1 && n % window.every != 0)
+        return false;
+
+
+    uint32_t pc = get_pc();
+    for (const auto &r : window.pc_ranges)
+    {
+        if (pc >= r.first && pc < r.second)
+            return true;
+    }
+    return false;
+}
@@ -5,12 +5,17 @@ Programmer:  Aasim Ghani
 
 Purpose:
     Declares the cpu_single_hart class, which represents a CPU containing a single
-    RV32I hart. This subclass of rv32i_hart provides a run() method that:
-      - Initializes register x2 with the size of the simulated memory.
-      - Repeatedly calls tick() to execute instructions.
-      - Honors an optional execution limit.
-      - Reports the halt reason (if any) and the total number of instructions
-        executed.
+    RV32I hart. This subclass of rv32i_hart provides:
+      - start(), which initializes register x2 with the size of the
+        simulated memory or, when the program is given arguments, lays
+        out argc, argv, envp and auxv below the top of memory as the
+        RISC-V psABI does and points sp, a0, a1 and a2 at them, and
+      - run(), which calls start() and then:
+          * repeatedly calls tick() to execute instructions,
+          * honors an optional execution limit,
+          * limits -i/-r tracing to an optional trace window, and
+          * reports the halt reason (if any) and the total number of
+            instructions executed.
 ********************************************************************************************/
 
 
@@ -19,9 +24,36 @@ Purpose:
 
 
 #include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
 #include "rv32i_hart.h"
 
 
+/***************************************************************
+Struct: trace_window
+
+
+Use:   Which instructions run() traces: those whose insn_counter
+       is in [start, end), whose pc is inside one of pc_ranges
+       (if any are given), and whose insn_counter is a multiple
+       of every (if non-zero).
+***************************************************************/
+struct trace_window
+{
+    uint64_t start = 0;
+    uint64_t end   = UINT64_MAX;
+    std::vector<std::pair<uint32_t, uint32_t>> pc_ranges;    // [lo, hi)
+    uint64_t every = 0;
+
+
+    bool is_set() const
+    {
+        return start != 0 || end != UINT64_MAX || !pc_ranges.empty() || every > 1;
+    }
+};
+
+
 class cpu_single_hart : public rv32i_hart
 {
 public:
@@ -29,8 +61,43 @@ public:
     cpu_single_hart(memory &mem) : rv32i_hart(mem) {}
 
 
+    // Set up the register state a program expects on entry.
+    void start();
+
+
     // Run the hart until halted or the instruction limit is reached.
     void run(uint64_t exec_limit);
+
+
+    // Trace (with the -i/-r flags already set) only inside w.
+    void set_trace_window(const trace_window &w) { window = w; }
+
+
+    // Arguments and environment for the program (argv[0] is its
+    // name), laid out on the stack by start(). Returns false if
+    // they do not fit in memory.
+    bool set_guest_args(const std::vector<std::string> &argv,
+                        const std::vector<std::string> &envp);
+
+
+private:
+    // Stack layout: the strings, AT_RANDOM bytes and vectors all
+    // lie in [sp, top of memory).
+    uint64_t stack_sp() const;
+    void build_stack();
+
+    void run_window(uint64_t exec_limit);
+    void run_to(uint64_t stop, bool traced);
+    bool traced_here() const;
+
+
+    trace_window window;
+    bool trace_insns = false;    // -i / -r as given, used inside the window
+    bool trace_regs  = false;
+
+
+    std::vector<std::string> guest_argv;
+    std::vector<std::string> guest_envp;
 };
 
 
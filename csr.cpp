@@ -0,0 +1,315 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'csr_file' class and holds the CSR registry. cycle and
+    instret (and their machine-mode aliases) are kept as offsets from the
+    hart's retired-instruction count, so they cost nothing per instruction;
+    one instruction takes one cycle. The performance monitor counters are
+    incremented by the hart's hpm_unit. There is no MMU, so satp is not
+    implemented.
+********************************************************************************************/
+
+
+#include "csr.h"
+
+
+#include <array>
+
+
+using desc = csr_file::desc;
+
+
+static constexpr uint32_t all = 0xffffffff;
+
+
+// The CSRs of performance monitor counter n.
+#define HPM_CSRS(n) \
+    { 0xb00 + n, "mhpmcounter" #n,       0, all,        csr_file::hook_hpm }, \
+    { 0xb80 + n, "mhpmcounter" #n "h",   0, all,        csr_file::hook_hpmh }, \
+    { 0x320 + n, "mhpmevent" #n,         0, all,        csr_file::hook_hpmevent }, \
+    { 0x720 + n, "mhpmevent" #n "h",     0, 0x80000000, csr_file::hook_hpmeventh }, \
+    { 0xc00 + n, "hpmcounter" #n,        0, 0,          csr_file::hook_hpm }, \
+    { 0xc80 + n, "hpmcounter" #n "h",    0, 0,          csr_file::hook_hpmh },
+
+
+static constexpr desc registry[] =
+{
+    // Unprivileged counters (read-only)
+    { 0xc00, "cycle",     0, 0, csr_file::hook_cycle },
+    { 0xc01, "time",      0, 0, csr_file::hook_time },
+    { 0xc02, "instret",   0, 0, csr_file::hook_instret },
+    { 0xc80, "cycleh",    0, 0, csr_file::hook_cycleh },
+    { 0xc81, "timeh",     0, 0, csr_file::hook_timeh },
+    { 0xc82, "instreth",  0, 0, csr_file::hook_instreth },
+
+
+    // Machine trap setup and handling. mstatus.MPP is fixed at M;
+    // only MIE and MPIE are writable.
+    { 0x300, "mstatus",   0x00001800, 0x00000088, csr_file::hook_none },
+    { 0x301, "misa",      0x40000100, 0,          csr_file::hook_none },
+    { 0x304, "mie",       0,          0x00000888, csr_file::hook_none },
+    { 0x305, "mtvec",     0,          all & ~2u,  csr_file::hook_none },
+    { 0x340, "mscratch",  0,          all,        csr_file::hook_none },
+    { 0x341, "mepc",      0,          all & ~3u,  csr_file::hook_none },
+    { 0x342, "mcause",    0,          all,        csr_file::hook_none },
+    { 0x343, "mtval",     0,          all,        csr_file::hook_none },
+    { 0x344, "mip",       0,          0,          csr_file::hook_none },
+
+
+    // Machine counters
+    { 0xb00, "mcycle",    0, all, csr_file::hook_cycle },
+    { 0xb02, "minstret",  0, all, csr_file::hook_instret },
+    { 0xb80, "mcycleh",   0, all, csr_file::hook_cycleh },
+    { 0xb82, "minstreth", 0, all, csr_file::hook_instreth },
+
+
+    // Performance monitor. mcountinhibit.TM is hardwired to 0.
+    { 0x320, "mcountinhibit", 0, all & ~2u, csr_file::hook_inhibit },
+    HPM_CSRS(3)  HPM_CSRS(4)  HPM_CSRS(5)  HPM_CSRS(6)  HPM_CSRS(7)
+    HPM_CSRS(8)  HPM_CSRS(9)  HPM_CSRS(10) HPM_CSRS(11) HPM_CSRS(12)
+    HPM_CSRS(13) HPM_CSRS(14) HPM_CSRS(15) HPM_CSRS(16) HPM_CSRS(17)
+    HPM_CSRS(18) HPM_CSRS(19) HPM_CSRS(20) HPM_CSRS(21) HPM_CSRS(22)
+    HPM_CSRS(23) HPM_CSRS(24) HPM_CSRS(25) HPM_CSRS(26) HPM_CSRS(27)
+    HPM_CSRS(28) HPM_CSRS(29) HPM_CSRS(30) HPM_CSRS(31)
+
+
+    // Machine information (read-only)
+    { 0xf11, "mvendorid", 0, 0, csr_file::hook_none },
+    { 0xf12, "marchid",   0, 0, csr_file::hook_none },
+    { 0xf13, "mimpid",    0, 0, csr_file::hook_none },
+    { 0xf14, "mhartid",   0, 0, csr_file::hook_mhartid },
+};
+
+
+static_assert(sizeof(registry) / sizeof(registry[0]) == csr_file::num_csrs,
+              "csr_file::num_csrs does not match the registry");
+
+
+/***************************************************************
+Function: make_index
+
+
+Use:      Builds, at compile time, the table mapping each of the
+          4096 CSR addresses to its registry entry + 1 (0 means
+          unimplemented).
+
+
+Arguments:
+    None.
+
+
+Returns:
+    The index table.
+***************************************************************/
+static constexpr std::array<uint8_t, 4096> make_index()
+{
+    std::array<uint8_t, 4096> t {};
+    for (size_t i = 0; i < csr_file::num_csrs; ++i)
+        t[registry[i].addr] = static_cast<uint8_t>(i + 1);
+    return t;
+}
+
+
+static constexpr std::array<uint8_t, 4096> csr_index = make_index();
+
+
+/***************************************************************
+Function: csr_file::lookup
+
+
+Use:      Finds the registry entry of a CSR.
+
+
+Arguments:
+    addr - 12-bit CSR address.
+
+
+Returns:
+    The entry, or nullptr if the CSR is not implemented.
+***************************************************************/
+const desc *csr_file::lookup(uint32_t addr)
+{
+    uint8_t i = csr_index[addr & 0xfff];
+    return i ? &registry[i - 1] : nullptr;
+}
+
+
+/***************************************************************
+Function: csr_file::reset
+
+
+Use:      Puts every CSR back to its reset value.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void csr_file::reset()
+{
+    for (size_t i = 0; i < num_csrs; ++i)
+        val[i] = registry[i].reset;
+    cycle_offset   = 0;
+    instret_offset = 0;
+
+
+    for (uint32_t n = 0; n < 32; ++n)
+    {
+        hpm_count[n] = 0;
+        hpm_event[n] = 0;
+    }
+    hpm_of  = 0;
+    inhibit = 0;
+}
+
+
+/***************************************************************
+Function: csr_file::get_counter
+
+
+Use:      Reads the 64-bit counter behind a counter hook.
+
+
+Arguments:
+    h       - hook_cycle[h] or hook_instret[h].
+    retired - Instructions retired so far.
+
+
+Returns:
+    The full 64-bit count.
+***************************************************************/
+uint64_t csr_file::get_counter(hook h, uint64_t retired) const
+{
+    bool cycle = h == hook_cycle || h == hook_cycleh;
+    if (inhibit & (cycle ? 1u : 4u))
+        return cycle ? cycle_offset : instret_offset;
+    return retired + (cycle ? cycle_offset : instret_offset);
+}
+
+
+/***************************************************************
+Function: csr_file::set_counter
+
+
+Use:      Writes one half of a 64-bit counter. The count seen by
+          the next instruction is the value written.
+
+
+Arguments:
+    h       - Counter hook; the 'h' variants write bits 63:32.
+    retired - Instructions retired before the writing one.
+    v       - Value written.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void csr_file::set_counter(hook h, uint64_t retired, uint32_t v)
+{
+    uint64_t cur = get_counter(h, retired);
+    uint64_t now;
+
+
+    if (h == hook_cycleh || h == hook_instreth)
+        now = (cur & 0xffffffffu) | (uint64_t(v) << 32);
+    else
+        now = (cur & ~uint64_t(0xffffffffu)) | v;
+
+
+    // The writing instruction itself does not count.
+    bool cycle = h == hook_cycle || h == hook_cycleh;
+    uint64_t &off = cycle ? cycle_offset : instret_offset;
+    off = (inhibit & (cycle ? 1u : 4u)) ? now : now - (retired + 1);
+}
+
+
+/***************************************************************
+Function: csr_file::set_hpm
+
+
+Use:      Writes one half of performance monitor counter n.
+
+
+Arguments:
+    n    - Counter number, 3..31.
+    high - Write bits 63:32 rather than 31:0.
+    v    - Value written.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void csr_file::set_hpm(uint32_t n, bool high, uint32_t v)
+{
+    uint64_t &c = hpm_count[n];
+    if (high)
+        c = (c & 0xffffffffu) | (uint64_t(v) << 32);
+    else
+        c = (c & ~uint64_t(0xffffffffu)) | v;
+}
+
+
+/***************************************************************
+Function: csr_file::set_inhibit
+
+
+Use:      Writes mcountinhibit. mcycle and minstret keep their
+          value while inhibited and resume counting from it.
+
+
+Arguments:
+    v       - New mcountinhibit.
+    retired - Instructions retired before the writing one.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void csr_file::set_inhibit(uint32_t v, uint64_t retired)
+{
+    static const hook counters[2] = { hook_cycle, hook_instret };
+    static const uint32_t bits[2] = { 1u, 4u };
+
+
+    for (int i = 0; i < 2; ++i)
+    {
+        bool was = inhibit & bits[i];
+        bool now = v & bits[i];
+        if (was == now)
+            continue;
+
+
+        // The writing instruction still counts.
+        uint64_t cur = get_counter(counters[i], retired + 1);
+        uint64_t &off = i == 0 ? cycle_offset : instret_offset;
+        off = now ? cur : cur - (retired + 1);
+    }
+    inhibit = v;
+}
+
+
+/***************************************************************
+Function: csr_file::slot
+
+
+Use:      Index of a registry entry, which is also its slot in
+          the per-hart storage.
+
+
+Arguments:
+    d - Registry entry.
+
+
+Returns:
+    The slot number.
+***************************************************************/
+size_t csr_file::slot(const desc *d)
+{
+    return static_cast<size_t>(d - registry);
+}
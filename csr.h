@@ -0,0 +1,153 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'csr_file' class, the control and status registers of one
+    hart. Only the CSRs listed in the registry (csr.cpp) exist; each has a
+    reset value, a mask of writable (WARL) bits and an optional hook for
+    CSRs whose value is computed rather than stored (counters, time,
+    mhartid, the performance monitor). Address-to-entry lookup goes
+    through a 4096-entry index built at compile time, shared by all
+    harts, so per-hart storage is one word per implemented CSR instead of
+    a 16 KiB array.
+
+    Read-only CSRs and the privilege needed for each CSR follow from the
+    address (bits 11:10 == 3 is read-only, bits 9:8 are the lowest privilege
+    level allowed), as in the privileged specification.
+********************************************************************************************/
+
+
+#ifndef CSR_H
+#define CSR_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+/***************************************************************
+Class: csr_file
+
+
+Use:   CSR registry and per-hart CSR storage. The hart looks a
+       CSR up, checks access with can_read()/can_write(), then
+       either resolves its hook or uses get()/set().
+
+
+Data:
+       val            - Stored value of each registry entry.
+       cycle_offset   - mcycle minus instructions retired (mcycle
+                        itself while inhibited).
+       instret_offset - Same for minstret.
+       hpm_count      - mhpmcounter3..31 (indexed by number).
+       hpm_event      - mhpmevent3..31.
+       hpm_of         - Overflow (OF) bit of each counter.
+       inhibit        - mcountinhibit.
+***************************************************************/
+class csr_file
+{
+public:
+    enum hook : uint8_t
+    {
+        hook_none,
+        hook_cycle,     hook_cycleh,
+        hook_instret,   hook_instreth,
+        hook_time,      hook_timeh,
+        hook_mhartid,
+        hook_hpm,       hook_hpmh,
+        hook_hpmevent,  hook_hpmeventh,
+        hook_inhibit
+    };
+
+
+    struct desc
+    {
+        uint16_t addr;
+        const char *name;
+        uint32_t reset;
+        uint32_t write_mask;    // bits a write may change (WARL)
+        hook h;
+    };
+
+
+    // Privilege levels (the hart only runs in machine mode).
+    static constexpr uint32_t priv_user    = 0;
+    static constexpr uint32_t priv_machine = 3;
+
+
+    // Number of entries in the registry.
+    static constexpr size_t num_csrs = 198;
+
+
+    csr_file() { reset(); }
+
+
+    // Registry entry for addr, or nullptr if the CSR is unimplemented.
+    static const desc *lookup(uint32_t addr);
+
+
+    static bool can_read(const desc *d, uint32_t priv)  { return priv >= ((d->addr >> 8) & 3u); }
+    static bool can_write(const desc *d, uint32_t priv) { return can_read(d, priv) && (d->addr >> 10) != 3; }
+
+
+    void reset();
+
+
+    // Stored value of a CSR without a hook.
+    uint32_t get(const desc *d) const       { return val[slot(d)]; }
+    void set(const desc *d, uint32_t v)
+    {
+        uint32_t &r = val[slot(d)];
+        r = (r & ~d->write_mask) | (v & d->write_mask);
+    }
+
+
+    // 64-bit counters, given the number of instructions retired.
+    uint64_t get_counter(hook h, uint64_t retired) const;
+    void set_counter(hook h, uint64_t retired, uint32_t v);
+
+
+    // Performance monitor counters 3..31 and their event selectors.
+    uint64_t get_hpm(uint32_t n) const             { return hpm_count[n]; }
+    void set_hpm(uint32_t n, bool high, uint32_t v);
+    uint32_t get_hpm_event(uint32_t n) const       { return hpm_event[n]; }
+    void set_hpm_event(uint32_t n, uint32_t e)     { hpm_event[n] = e; }
+    bool get_hpm_of(uint32_t n) const              { return (hpm_of >> n) & 1; }
+    void set_hpm_of(uint32_t n, bool of)           { hpm_of = (hpm_of & ~(1u << n)) | (uint32_t(of) << n); }
+
+
+    // Add one to every counter in mask (a bit per counter number).
+    void count_hpm(uint32_t mask)
+    {
+        for (; mask; mask &= mask - 1)
+        {
+            uint32_t n = __builtin_ctz(mask);
+            if (++hpm_count[n] == 0)
+                hpm_of |= 1u << n;
+        }
+    }
+
+
+    uint32_t get_inhibit() const                   { return inhibit; }
+    void set_inhibit(uint32_t v, uint64_t retired);
+
+
+private:
+    static size_t slot(const desc *d);
+
+
+    uint32_t val[num_csrs];
+    uint64_t cycle_offset   = 0;
+    uint64_t instret_offset = 0;
+
+
+    uint64_t hpm_count[32];
+    uint32_t hpm_event[32];
+    uint32_t hpm_of  = 0;
+    uint32_t inhibit = 0;
+};
+
+
+#endif
@@ -0,0 +1,759 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'debug_line' class: finds .debug_line (and the string
+    sections it refers to) through the ELF section headers, then runs each
+    unit's line number program, as described in the DWARF standard, section
+    6.2. The compilation units' first entries in .debug_info supply the
+    compilation directory that DWARF 2 to 4 line tables leave out.
+********************************************************************************************/
+
+
+#include "debug_line.h"
+
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+
+using std::cerr;
+using std::endl;
+using std::string;
+
+
+/***************************************************************
+Struct: debug_line::cursor
+
+
+Use:    Bounds-checked reader over a section. Reading past the
+        end clears ok and returns zeros, so a parser only needs
+        to test ok once it is done.
+***************************************************************/
+struct debug_line::cursor
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    bool ok = true;
+
+
+    bool need(uint64_t n)
+    {
+        if (uint64_t(end - p) >= n)
+            return true;
+        ok = false;
+        p  = end;
+        return false;
+    }
+
+
+    uint64_t fixed(uint32_t n)
+    {
+        uint64_t v = 0;
+        if (!need(n))
+            return 0;
+        for (uint32_t i = 0; i < n; ++i)
+            v |= uint64_t(p[i]) << (8 * i);
+        p += n;
+        return v;
+    }
+
+
+    uint64_t uleb()
+    {
+        uint64_t v = 0;
+        for (uint32_t shift = 0; need(1); shift += 7)
+        {
+            uint8_t b = *p++;
+            if (shift < 64)
+                v |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        return 0;
+    }
+
+
+    int64_t sleb()
+    {
+        uint64_t v = 0;
+        for (uint32_t shift = 0; need(1); )
+        {
+            uint8_t b = *p++;
+            if (shift < 64)
+                v |= uint64_t(b & 0x7f) << shift;
+            shift += 7;
+            if (!(b & 0x80))
+            {
+                if (shift < 64 && (b & 0x40))
+                    v |= ~uint64_t(0) << shift;
+                return static_cast<int64_t>(v);
+            }
+        }
+        return 0;
+    }
+
+
+    string cstr()
+    {
+        const void *z = std::memchr(p, 0, end - p);
+        if (!z)
+        {
+            ok = false;
+            p  = end;
+            return string();
+        }
+        string s(reinterpret_cast<const char *>(p), static_cast<const uint8_t *>(z) - p);
+        p = static_cast<const uint8_t *>(z) + 1;
+        return s;
+    }
+
+
+    void skip(uint64_t n)
+    {
+        if (need(n))
+            p += n;
+    }
+};
+
+
+/***************************************************************
+Function: get_le16 / get_le32
+
+
+Use:      Read a little-endian value from an ELF file.
+
+
+Arguments:
+    p - First byte.
+
+
+Returns:
+    The value.
+***************************************************************/
+static uint32_t get_le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+
+/***************************************************************
+Function: string_at
+
+
+Use:      Reads a string from a string section (.debug_str or
+          .debug_line_str).
+
+
+Arguments:
+    sec - Section contents.
+    off - Offset of the string.
+    ok  - Cleared if off is not the start of a string in sec.
+
+
+Returns:
+    The string.
+***************************************************************/
+static string string_at(const std::vector<uint8_t> &sec, uint64_t off, bool &ok)
+{
+    const void *z = off < sec.size() ? std::memchr(sec.data() + off, 0, sec.size() - off) : nullptr;
+    if (!z)
+    {
+        ok = false;
+        return string();
+    }
+    return string(reinterpret_cast<const char *>(sec.data() + off), static_cast<const uint8_t *>(z) - sec.data() - off);
+}
+
+
+/***************************************************************
+Function: join_path
+
+
+Use:      Joins a file name to its directory, unless it is
+          absolute or there is no directory.
+
+
+Arguments:
+    dir  - Directory.
+    name - File name.
+
+
+Returns:
+    The path.
+***************************************************************/
+static string join_path(const string &dir, const string &name)
+{
+    if (dir.empty() || name.empty() || name[0] == '/')
+        return name;
+    return dir.back() == '/' ? dir + name : dir + "/" + name;
+}
+
+
+/***************************************************************
+Function: debug_line::read
+
+
+Use:      Reads the line tables of an ELF32 file.
+
+
+Arguments:
+    fname - File name.
+
+
+Returns:
+    false (after printing why) if the file can't be read or its
+    tables are malformed.
+***************************************************************/
+bool debug_line::read(const string &fname)
+{
+    std::ifstream in(fname, std::ios::binary);
+    if (!in)
+    {
+        cerr << "Can't open file '" << fname << "' for reading." << endl;
+        return false;
+    }
+    std::vector<uint8_t> elf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+
+    if (elf.size() < 52 || std::memcmp(elf.data(), "\x7f" "ELF", 4) != 0 || elf[4] != 1 || elf[5] != 1)
+    {
+        cerr << "'" << fname << "' is not a little-endian ELF32 file." << endl;
+        return false;
+    }
+
+
+    uint32_t shoff     = get_le32(&elf[32]);
+    uint32_t shentsize = get_le16(&elf[46]);
+    uint32_t shnum     = get_le16(&elf[48]);
+    uint32_t shstrndx  = get_le16(&elf[50]);
+    if (shnum == 0)
+        return true;
+    if (shentsize < 40 || uint64_t(shoff) + uint64_t(shentsize) * shnum > elf.size() || shstrndx >= shnum)
+    {
+        cerr << "'" << fname << "' has a bad section header table." << endl;
+        return false;
+    }
+
+
+    auto section = [&](uint32_t i, uint32_t field) { return get_le32(&elf[shoff + i * shentsize + field]); };
+    uint32_t names = section(shstrndx, 16);
+    uint32_t names_size = section(shstrndx, 20);
+    if (uint64_t(names) + names_size > elf.size())
+    {
+        cerr << "'" << fname << "' has a bad section name table." << endl;
+        return false;
+    }
+
+
+    std::vector<uint8_t> line, line_str, str, info, abbrev;
+    for (uint32_t i = 0; i < shnum; ++i)
+    {
+        uint32_t name = section(i, 0);
+        uint32_t type = section(i, 4);
+        uint32_t off  = section(i, 16);
+        uint32_t size = section(i, 20);
+        if (type == 8 || name >= names_size || uint64_t(off) + size > elf.size())   // SHT_NOBITS
+            continue;
+
+
+        const char *p = reinterpret_cast<const char *>(&elf[names + name]);
+        string n(p, strnlen(p, names_size - name));
+        std::vector<uint8_t> *dst = n == ".debug_line"     ? &line
+                                  : n == ".debug_line_str" ? &line_str
+                                  : n == ".debug_str"      ? &str
+                                  : n == ".debug_info"     ? &info
+                                  : n == ".debug_abbrev"   ? &abbrev
+                                  : nullptr;
+        if (dst)
+            dst->assign(elf.begin() + off, elf.begin() + off + size);
+    }
+
+
+    std::unordered_map<uint64_t, string> comp_dirs;
+    read_comp_dirs(info, abbrev, line_str, str, comp_dirs);
+
+
+    cursor c { line.data(), line.data() + line.size() };
+    while (c.p < c.end)
+    {
+        auto dir = comp_dirs.find(c.p - line.data());
+        if (!parse_unit(c, dir == comp_dirs.end() ? string() : dir->second, line_str, str))
+        {
+            cerr << "'" << fname << "' has a malformed .debug_line section." << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/***************************************************************
+Function: debug_line::add_file
+
+
+Use:      Finds or adds a source file name.
+
+
+Arguments:
+    path - File name.
+
+
+Returns:
+    Its index in files.
+***************************************************************/
+uint32_t debug_line::add_file(const string &path)
+{
+    auto it = file_index.emplace(path, static_cast<uint32_t>(files.size()));
+    if (it.second)
+        files.push_back(path);
+    return it.first->second;
+}
+
+
+/***************************************************************
+Function: debug_line::read_form
+
+
+Use:      Reads one attribute of a DWARF 5 directory or file
+          name entry.
+
+
+Arguments:
+    c        - Cursor on the attribute.
+    form     - Its DW_FORM.
+    offset   - Size of a section offset (4, or 8 for 64-bit
+               DWARF).
+    line_str - .debug_line_str contents.
+    str      - .debug_str contents.
+    s        - Set to a string attribute's value.
+    v        - Set to a constant attribute's value.
+
+
+Returns:
+    false for a form a line table header can't use.
+***************************************************************/
+bool debug_line::read_form(cursor &c, uint64_t form, uint32_t offset,
+                           const std::vector<uint8_t> &line_str, const std::vector<uint8_t> &str,
+                           string &s, uint64_t &v)
+{
+    switch (form)
+    {
+    case 0x08: s = c.cstr();                                    break;  // DW_FORM_string
+    case 0x1f: s = string_at(line_str, c.fixed(offset), c.ok);  break;  // DW_FORM_line_strp
+    case 0x0e: s = string_at(str, c.fixed(offset), c.ok);       break;  // DW_FORM_strp
+    case 0x0f: v = c.uleb();                                    break;  // DW_FORM_udata
+    case 0x0b: v = c.fixed(1);                                  break;  // DW_FORM_data1
+    case 0x05: v = c.fixed(2);                                  break;  // DW_FORM_data2
+    case 0x06: v = c.fixed(4);                                  break;  // DW_FORM_data4
+    case 0x07: v = c.fixed(8);                                  break;  // DW_FORM_data8
+    case 0x1e: c.skip(16);                                      break;  // DW_FORM_data16
+    case 0x09: c.skip(c.uleb());                                break;  // DW_FORM_block
+    default:
+        return false;
+    }
+    return true;
+}
+
+
+/***************************************************************
+Function: debug_line::skip_form
+
+
+Use:      Skips one attribute value of a debugging information
+          entry.
+
+
+Arguments:
+    c         - Cursor on the value.
+    form      - Its DW_FORM.
+    offset    - Size of a section offset (4, or 8 for 64-bit
+                DWARF).
+    addr_size - Size of an address.
+    version   - The unit's DWARF version.
+
+
+Returns:
+    false for an unknown form.
+***************************************************************/
+bool debug_line::skip_form(cursor &c, uint64_t form, uint32_t offset, uint32_t addr_size,
+                           uint32_t version)
+{
+    while (form == 0x16)                                        // DW_FORM_indirect
+        form = c.uleb();
+
+    // Grouped by size; see DWARF 5, section 7.5.6.
+    switch (form)
+    {
+    case 0x19:                                              break;  // flag_present
+    case 0x0b: case 0x0c: case 0x11: case 0x25: case 0x29:  c.skip(1);          break;
+    case 0x05: case 0x12: case 0x26: case 0x2a:             c.skip(2);          break;
+    case 0x27: case 0x2b:                                   c.skip(3);          break;
+    case 0x06: case 0x13: case 0x1c: case 0x28: case 0x2c:  c.skip(4);          break;
+    case 0x07: case 0x14: case 0x20: case 0x24:             c.skip(8);          break;
+    case 0x1e:                                              c.skip(16);         break;  // data16
+    case 0x01:                                              c.skip(addr_size);  break;  // addr
+    case 0x10: c.skip(version == 2 ? addr_size : offset);   break;  // ref_addr
+    case 0x0e: case 0x17: case 0x1d: case 0x1f:             c.skip(offset);     break;
+    case 0x08:                                              c.cstr();           break;  // string
+    case 0x0d:                                              c.sleb();           break;  // sdata
+    case 0x0f: case 0x15: case 0x1a: case 0x1b:
+    case 0x22: case 0x23:                                   c.uleb();           break;
+    case 0x0a:                                              c.skip(c.fixed(1)); break;  // block1
+    case 0x03:                                              c.skip(c.fixed(2)); break;  // block2
+    case 0x04:                                              c.skip(c.fixed(4)); break;  // block4
+    case 0x09: case 0x18:                                   c.skip(c.uleb());   break;  // block, exprloc
+    default:
+        return false;
+    }
+    return true;
+}
+
+
+/***************************************************************
+Function: debug_line::read_comp_dirs
+
+
+Use:      Reads the DW_AT_comp_dir and DW_AT_stmt_list of each
+          compilation unit's first entry in .debug_info. Units
+          that can't be read are skipped: their line tables just
+          keep relative paths.
+
+
+Arguments:
+    info      - .debug_info contents.
+    abbrev    - .debug_abbrev contents.
+    line_str  - .debug_line_str contents.
+    str       - .debug_str contents.
+    comp_dirs - Receives the compilation directory for each
+                line table offset.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void debug_line::read_comp_dirs(const std::vector<uint8_t> &info, const std::vector<uint8_t> &abbrev,
+                                const std::vector<uint8_t> &line_str, const std::vector<uint8_t> &str,
+                                std::unordered_map<uint64_t, string> &comp_dirs)
+{
+    cursor c { info.data(), info.data() + info.size() };
+    while (c.p < c.end)
+    {
+        uint32_t offset = 4;
+        uint64_t length = c.fixed(4);
+        if (length == 0xffffffff)
+        {
+            offset = 8;
+            length = c.fixed(8);
+        }
+        if (!c.need(length))
+            return;
+        cursor u { c.p, c.p + length };
+        c.p += length;
+
+
+        uint32_t version = static_cast<uint32_t>(u.fixed(2));
+        uint32_t addr_size;
+        uint64_t abbrev_offset;
+        if (version == 5)
+        {
+            uint32_t type = static_cast<uint32_t>(u.fixed(1));
+            addr_size     = static_cast<uint32_t>(u.fixed(1));
+            abbrev_offset = u.fixed(offset);
+            if (type != 1 && type != 3)                 // DW_UT_compile, DW_UT_partial
+                continue;
+        }
+        else if (version >= 2 && version < 5)
+        {
+            abbrev_offset = u.fixed(offset);
+            addr_size     = static_cast<uint32_t>(u.fixed(1));
+        }
+        else
+            continue;
+
+
+        // Find the first entry's abbreviation.
+        uint64_t code = u.uleb();
+        if (code == 0 || abbrev_offset >= abbrev.size())
+            continue;
+        cursor a { abbrev.data() + abbrev_offset, abbrev.data() + abbrev.size() };
+        uint64_t found;
+        while ((found = a.uleb()) != code && found != 0 && a.ok)
+        {
+            a.uleb();                                   // tag
+            a.skip(1);                                  // children
+            for (uint64_t name = a.uleb(), form = a.uleb(); a.ok && (name || form); name = a.uleb(), form = a.uleb())
+                if (form == 0x21)                       // DW_FORM_implicit_const
+                    a.sleb();
+        }
+        if (found != code)
+            continue;
+        a.uleb();                                       // tag
+        a.skip(1);                                      // children
+
+
+        string dir;
+        uint64_t stmt_list = ~uint64_t(0);
+        for (uint64_t name = a.uleb(), form = a.uleb(); a.ok && u.ok && (name || form); name = a.uleb(), form = a.uleb())
+        {
+            string s;
+            uint64_t v = 0;
+            if (form == 0x21)
+                a.sleb();
+            else if (name == 0x1b)                      // DW_AT_comp_dir
+            {
+                if (!read_form(u, form, offset, line_str, str, s, v))
+                    break;
+                dir = s;
+            }
+            else if (name == 0x10 && (form == 0x06 || form == 0x17))      // DW_AT_stmt_list
+                stmt_list = u.fixed(form == 0x06 ? 4 : offset);
+            else if (!skip_form(u, form, offset, addr_size, version))
+                break;
+        }
+        if (a.ok && u.ok && stmt_list != ~uint64_t(0) && !dir.empty())
+            comp_dirs.emplace(stmt_list, dir);
+    }
+}
+
+
+/***************************************************************
+Function: debug_line::parse_unit
+
+
+Use:      Reads one line table: its header's directories and
+          files, then its line number program, adding a range
+          for each row.
+
+
+Arguments:
+    c        - Cursor on the unit; left after it.
+    comp_dir - Compilation directory from .debug_info, or empty.
+    line_str - .debug_line_str contents.
+    str      - .debug_str contents.
+
+
+Returns:
+    false if the unit is malformed or of an unknown version.
+***************************************************************/
+bool debug_line::parse_unit(cursor &c, const string &comp_dir,
+                            const std::vector<uint8_t> &line_str, const std::vector<uint8_t> &str)
+{
+    uint32_t offset = 4;
+    uint64_t length = c.fixed(4);
+    if (length == 0xffffffff)
+    {
+        offset = 8;
+        length = c.fixed(8);
+    }
+    if (!c.need(length))
+        return false;
+    cursor u { c.p, c.p + length };
+    c.p += length;
+
+
+    uint32_t version = static_cast<uint32_t>(u.fixed(2));
+    if (version < 2 || version > 5)
+        return false;
+    if (version >= 5)
+        u.skip(2);              // address_size, segment_selector_size
+    uint64_t header_length = u.fixed(offset);
+    if (!u.need(header_length))
+        return false;
+    const uint8_t *program = u.p + header_length;
+
+
+    uint32_t min_length = static_cast<uint32_t>(u.fixed(1));
+    if (version >= 4)
+        u.skip(1);              // maximum_operations_per_instruction
+    u.skip(1);                  // default_is_stmt
+    int32_t  line_base   = static_cast<int8_t>(u.fixed(1));
+    uint32_t line_range  = static_cast<uint32_t>(u.fixed(1));
+    uint32_t opcode_base = static_cast<uint32_t>(u.fixed(1));
+    if (line_range == 0 || opcode_base == 0)
+        return false;
+    std::vector<uint8_t> opcode_lengths(opcode_base);
+    for (uint32_t i = 1; i < opcode_base; ++i)
+        opcode_lengths[i] = static_cast<uint8_t>(u.fixed(1));
+
+
+    // Directories, then files as indices into this->files.
+    std::vector<string> dirs;
+    std::vector<uint32_t> unit_files;
+    if (version < 5)
+    {
+        dirs.push_back(comp_dir);               // not named here; from .debug_info
+        for (string d = u.cstr(); u.ok && !d.empty(); d = u.cstr())
+            dirs.push_back(join_path(comp_dir, d));
+        unit_files.push_back(~0u);              // file numbers start at 1
+        for (string f = u.cstr(); u.ok && !f.empty(); f = u.cstr())
+        {
+            uint64_t dir = u.uleb();
+            u.uleb();                           // modification time
+            u.uleb();                           // length
+            unit_files.push_back(add_file(join_path(dir < dirs.size() ? dirs[dir] : string(), f)));
+        }
+    }
+    else
+    {
+        for (int list = 0; list < 2; ++list)
+        {
+            std::vector<std::pair<uint64_t, uint64_t>> formats(u.fixed(1));
+            for (auto &f : formats)
+            {
+                f.first  = u.uleb();            // DW_LNCT_*
+                f.second = u.uleb();            // DW_FORM_*
+            }
+
+
+            // Every form takes at least a byte, so only an entry with
+            // no formats could repeat without running out of input.
+            uint64_t count = u.uleb();
+            if (count && formats.empty())
+                return false;
+            for (uint64_t i = 0; i < count && u.ok; ++i)
+            {
+                string path;
+                uint64_t dir = 0;
+                for (const auto &f : formats)
+                {
+                    string s;
+                    uint64_t v = 0;
+                    if (!read_form(u, f.second, offset, line_str, str, s, v))
+                        return false;
+                    if (f.first == 1)           // DW_LNCT_path
+                        path = s;
+                    else if (f.first == 2)      // DW_LNCT_directory_index
+                        dir = v;
+                }
+
+
+                if (list == 0)
+                    dirs.push_back(dirs.empty() ? path : join_path(dirs[0], path));
+                else
+                    unit_files.push_back(add_file(join_path(dir < dirs.size() ? dirs[dir] : string(), path)));
+            }
+        }
+    }
+    if (!u.ok)
+        return false;
+
+
+    // The line number program.
+    u.p = program;
+    uint64_t address = 0;
+    uint64_t file = 1;
+    int64_t  line = 1;
+    bool     have_row = false;
+    uint64_t row_address = 0;
+    uint64_t row_file = 0;
+    int64_t  row_line = 0;
+
+
+    auto emit = [&](bool end_sequence)
+    {
+        if (have_row && address > row_address && row_file < unit_files.size()
+            && unit_files[row_file] != ~0u && row_line > 0)
+            ranges.push_back({ static_cast<uint32_t>(row_address),
+                               static_cast<uint32_t>(std::min<uint64_t>(address, 0xffffffff)),
+                               unit_files[row_file], static_cast<uint32_t>(row_line) });
+        have_row    = !end_sequence;
+        row_address = address;
+        row_file    = file;
+        row_line    = line;
+    };
+
+
+    while (u.p < u.end && u.ok)
+    {
+        uint32_t op = static_cast<uint32_t>(u.fixed(1));
+        if (op >= opcode_base)
+        {
+            uint32_t adj = op - opcode_base;
+            address += uint64_t(adj / line_range) * min_length;
+            line    += line_base + static_cast<int32_t>(adj % line_range);
+            emit(false);
+            continue;
+        }
+
+
+        switch (op)
+        {
+        case 0:                                 // extended opcode
+        {
+            uint64_t len = u.uleb();
+            if (len == 0 || !u.need(len))
+                break;
+            const uint8_t *next = u.p + len;
+            uint32_t sub = static_cast<uint32_t>(u.fixed(1));
+            if (sub == 1)                       // DW_LNE_end_sequence
+            {
+                emit(true);
+                address = 0;
+                file    = 1;
+                line    = 1;
+            }
+            else if (sub == 2)                  // DW_LNE_set_address
+            {
+                address = u.fixed(static_cast<uint32_t>(std::min<uint64_t>(len - 1, 8)));
+            }
+            else if (sub == 3 && version < 5)   // DW_LNE_define_file
+            {
+                string f = u.cstr();
+                uint64_t dir = u.uleb();
+                unit_files.push_back(add_file(join_path(dir < dirs.size() ? dirs[dir] : string(), f)));
+            }
+            u.p = next;
+            break;
+        }
+
+
+        case 1:                                 // DW_LNS_copy
+            emit(false);
+            break;
+
+
+        case 2:                                 // DW_LNS_advance_pc
+            address += u.uleb() * min_length;
+            break;
+
+
+        case 3:                                 // DW_LNS_advance_line
+            line += u.sleb();
+            break;
+
+
+        case 4:                                 // DW_LNS_set_file
+            file = u.uleb();
+            break;
+
+
+        case 8:                                 // DW_LNS_const_add_pc
+            address += uint64_t((255 - opcode_base) / line_range) * min_length;
+            break;
+
+
+        case 9:                                 // DW_LNS_fixed_advance_pc
+            address += u.fixed(2);
+            break;
+
+
+        default:                                // column, flags, isa: skip the operands
+            for (uint32_t i = 0; i < opcode_lengths[op]; ++i)
+                u.uleb();
+            break;
+        }
+    }
+    return u.ok;
+}
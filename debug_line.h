@@ -0,0 +1,91 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'debug_line' class, which reads the DWARF line number
+    tables (.debug_line, DWARF versions 2 to 5) of an ELF32 executable and
+    turns them into address ranges, each with the source file and line its
+    instructions came from. Used to map coverage back to source lines.
+********************************************************************************************/
+
+
+#ifndef DEBUG_LINE_H
+#define DEBUG_LINE_H
+
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/***************************************************************
+Class: debug_line
+
+
+Use:   Reads an ELF file's line tables with read(). Each row of
+       a line program becomes a range from its address up to the
+       next row's; rows that end a sequence end the last range.
+
+       File names are joined to their include directory, when
+       the table names one, and relative directories to the
+       compilation directory: for DWARF 5 that is directory 0;
+       for DWARF 2 to 4 it is the DW_AT_comp_dir of the
+       compilation unit whose DW_AT_stmt_list names the table.
+
+
+Data:
+       files      - Source file names, indexed by range::file.
+       file_index - Index of each name in files, so that units
+                    naming the same file share it.
+       ranges     - Address ranges, in the order the tables give
+                    them.
+***************************************************************/
+class debug_line
+{
+public:
+    struct range
+    {
+        uint32_t lo;            // first address
+        uint32_t hi;            // one past the last
+        uint32_t file;          // index into files
+        uint32_t line;
+    };
+
+
+    // Read the line tables of an ELF32 file. Returns false (after
+    // printing why) if the file can't be read or its tables are
+    // malformed; a file without .debug_line reads as empty.
+    bool read(const std::string &fname);
+
+
+    const std::vector<std::string> &get_files() const  { return files; }
+    const std::vector<range> &get_ranges() const       { return ranges; }
+
+
+private:
+    struct cursor;
+
+
+    bool     parse_unit(cursor &c, const std::string &comp_dir,
+                        const std::vector<uint8_t> &line_str, const std::vector<uint8_t> &str);
+    uint32_t add_file(const std::string &path);
+    static bool read_form(cursor &c, uint64_t form, uint32_t offset,
+                          const std::vector<uint8_t> &line_str, const std::vector<uint8_t> &str,
+                          std::string &s, uint64_t &v);
+    static bool skip_form(cursor &c, uint64_t form, uint32_t offset, uint32_t addr_size,
+                          uint32_t version);
+    static void read_comp_dirs(const std::vector<uint8_t> &info, const std::vector<uint8_t> &abbrev,
+                               const std::vector<uint8_t> &line_str, const std::vector<uint8_t> &str,
+                               std::unordered_map<uint64_t, std::string> &comp_dirs);
+
+
+    std::vector<std::string> files;
+    std::unordered_map<std::string, uint32_t> file_index;
+    std::vector<range> ranges;
+};
+
+
+#endif
@@ -0,0 +1,395 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'defuse_profiler' class. Register reads are found by
+    decoding the instruction in on_insn, before it executes; register writes
+    come from on_reg_write after it has executed, so an instruction that
+    reads and writes the same register uses the old value first.
+********************************************************************************************/
+
+
+#include "defuse.h"
+
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+
+#include "hex.h"
+#include "rv32i_decode.h"
+
+
+/***************************************************************
+Function: for_each_word
+
+
+Use:      Splits an access into the memory words it touches.
+
+
+Arguments:
+    addr - Access address.
+    len  - Access size in bytes.
+    f    - Called with (word address, mask of bytes touched).
+
+
+Returns:
+    Nothing.
+***************************************************************/
+template <typename F>
+static void for_each_word(uint32_t addr, uint32_t len, F f)
+{
+    uint64_t a   = addr;
+    uint64_t end = a + len;
+    while (a < end)
+    {
+        uint32_t off = a & 3;
+        uint32_t n   = static_cast<uint32_t>(std::min<uint64_t>(4 - off, end - a));
+        f(static_cast<uint32_t>(a >> 2), static_cast<uint8_t>(((1u << n) - 1) << off));
+        a += n;
+    }
+}
+
+
+/***************************************************************
+Function: defuse_profiler::add_live
+
+
+Use:      Adds a live range to the pressure buckets.
+
+
+Arguments:
+    from - First instruction the value is live in.
+    to   - One past the last.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void defuse_profiler::add_live(uint64_t from, uint64_t to)
+{
+    while (from < to)
+    {
+        uint64_t b   = from / bucket_len;
+        uint64_t end = std::min(to, (b + 1) * bucket_len);
+        buckets[b] += end - from;
+        from = end;
+    }
+}
+
+
+/***************************************************************
+Function: defuse_profiler::retire_value
+
+
+Use:      Ends a register value's life: it counts as dead if it
+          was overwritten unread, and adds its live range to the
+          pressure buckets if it was read.
+
+
+Arguments:
+    v           - The value.
+    overwritten - A new value replaces it (false at the end of
+                  the run).
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void defuse_profiler::retire_value(reg_value &v, bool overwritten)
+{
+    if (!v.writer)
+        return;
+    if (v.used)
+        add_live(v.def + 1, v.last_use + 1);
+    else if (overwritten)
+        ++v.writer->dead;
+}
+
+
+/***************************************************************
+Function: defuse_profiler::read_reg
+
+
+Use:      Records a read of a register by the current
+          instruction.
+
+
+Arguments:
+    r - Register read.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void defuse_profiler::read_reg(uint32_t r)
+{
+    reg_value &v = regs[r];
+    if (!v.writer)
+        return;
+
+
+    uint64_t now = insns - 1;
+    if (!v.used)
+    {
+        v.used = true;
+        ++v.writer->used;
+        v.writer->dist += now - v.def;
+    }
+    v.last_use = now;
+}
+
+
+/***************************************************************
+Function: defuse_profiler::on_insn
+
+
+Use:      Starts a new instruction and records the registers it
+          reads. Halves the pressure resolution when the run
+          outgrows the buckets.
+
+
+Arguments:
+    pc   - Instruction address.
+    insn - Instruction word.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void defuse_profiler::on_insn(uint32_t pc, uint32_t insn)
+{
+    cur_pc = pc;
+    if (++insns > num_buckets * bucket_len)
+    {
+        for (uint32_t i = 0; i < num_buckets / 2; ++i)
+            buckets[i] = buckets[2 * i] + buckets[2 * i + 1];
+        std::fill(buckets + num_buckets / 2, buckets + num_buckets, 0);
+        bucket_len *= 2;
+    }
+
+
+    if (rv32i_decode::reads_rs1(insn))
+        read_reg(rv32i_decode::get_rs1(insn));
+    if (rv32i_decode::reads_rs2(insn))
+        read_reg(rv32i_decode::get_rs2(insn));
+}
+
+
+/***************************************************************
+Function: defuse_profiler::on_reg_write
+
+
+Use:      Replaces a register's value with the current
+          instruction's result.
+
+
+Arguments:
+    r   - Register written.
+    val - Unused.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void defuse_profiler::on_reg_write(uint32_t r, uint32_t val)
+{
+    (void)val;
+    reg_value &v = regs[r];
+    retire_value(v, true);
+
+
+    v.writer = &stats[cur_pc];
+    ++v.writer->writes;
+    v.used = false;
+    v.def  = insns - 1;
+    v.last_use = v.def;
+}
+
+
+/***************************************************************
+Function: defuse_profiler::on_load
+
+
+Use:      Marks the stores whose bytes a load reads as used.
+
+
+Arguments:
+    pc, val - Unused.
+    addr    - Load address.
+    len     - Load size in bytes.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void defuse_profiler::on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)pc; (void)val;
+    for_each_word(addr, len, [this](uint32_t w, uint8_t mask)
+    {
+        auto it = words.find(w);
+        if (it != words.end() && (it->second.mask & mask))
+            it->second.used = true;
+    });
+}
+
+
+/***************************************************************
+Function: defuse_profiler::on_store
+
+
+Use:      Records a store, and counts the store it replaces as
+          dead if that one was never loaded and is now entirely
+          overwritten.
+
+
+Arguments:
+    pc, val - Unused.
+    addr    - Store address.
+    len     - Store size in bytes.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void defuse_profiler::on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)pc; (void)val;
+    pc_stats *st = &stats[cur_pc];
+    ++st->stores;
+
+
+    for_each_word(addr, len, [this, st](uint32_t w, uint8_t mask)
+    {
+        auto it = words.find(w);
+        if (it == words.end())
+        {
+            words.emplace(w, word_value { st, mask, false });
+            return;
+        }
+
+
+        word_value &old = it->second;
+        if (!old.used && !(old.mask & ~mask))
+            ++old.writer->dead_stores;
+        old = word_value { st, mask, false };
+    });
+}
+
+
+/***************************************************************
+Function: defuse_profiler::report
+
+
+Use:      Prints totals, the instructions with the most dead
+          results, and register pressure over time.
+
+
+Arguments:
+    os  - Output stream.
+    mem - Memory, to disassemble the instructions listed.
+    top - How many instructions to list.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void defuse_profiler::report(std::ostream &os, const memory &mem, uint32_t top)
+{
+    if (!finished)
+    {
+        for (reg_value &v : regs)
+            retire_value(v, false);
+        finished = true;
+    }
+
+
+    uint64_t writes = 0, dead = 0, stores = 0, dead_stores = 0;
+    std::vector<std::pair<uint32_t, const pc_stats *>> rows;
+    for (const auto &e : stats)
+    {
+        writes      += e.second.writes;
+        dead        += e.second.dead;
+        stores      += e.second.stores;
+        dead_stores += e.second.dead_stores;
+        if (e.second.dead || e.second.dead_stores)
+            rows.emplace_back(e.first, &e.second);
+    }
+    std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b)
+    {
+        uint64_t da = a.second->dead + a.second->dead_stores;
+        uint64_t db = b.second->dead + b.second->dead_stores;
+        if (da != db)
+            return da > db;
+        return a.first < b.first;
+    });
+    if (rows.size() > top)
+        rows.resize(top);
+
+
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+
+
+    os << "Def-use profile: " << insns << " instructions" << std::endl;
+    os << "  register writes " << writes << ", dead " << dead;
+    if (writes)
+        os << " (" << 100.0 * dead / writes << "%)";
+    os << std::endl;
+    os << "  stores " << stores << ", dead " << dead_stores;
+    if (stores)
+        os << " (" << 100.0 * dead_stores / stores << "%)";
+    os << std::endl;
+
+
+    if (!rows.empty())
+    {
+        os << "  " << std::left << std::setw(12) << "pc" << std::right
+           << std::setw(10) << "results" << std::setw(10) << "dead"
+           << std::setw(8) << "dead%" << std::setw(10) << "1st-use" << "  insn" << std::endl;
+        for (const auto &r : rows)
+        {
+            const pc_stats &st = *r.second;
+            uint64_t results = st.writes + st.stores;
+            uint64_t d       = st.dead + st.dead_stores;
+            os << "  " << std::left << std::setw(12) << hex::to_hex0x32(r.first) << std::right
+               << std::setw(10) << results << std::setw(10) << d
+               << std::setw(8) << 100.0 * d / results;
+            if (st.used)
+                os << std::setw(10) << double(st.dist) / st.used;
+            else
+                os << std::setw(10) << "-";
+            os << "  " << rv32i_decode::decode(r.first, mem.get32(r.first)) << std::endl;
+        }
+    }
+
+
+    if (insns)
+    {
+        uint64_t live = 0;
+        double peak   = 0;
+        os << "  register pressure (live registers, averaged per " << bucket_len
+           << " instructions):" << std::endl;
+        for (uint64_t b = 0; b * bucket_len < insns; ++b)
+        {
+            uint64_t first = b * bucket_len;
+            uint64_t width = std::min(bucket_len, insns - first);
+            double avg = double(buckets[b]) / width;
+            live += buckets[b];
+            peak = std::max(peak, avg);
+            os << "  " << std::setw(12) << first << std::setw(8) << avg << "  "
+               << std::string(static_cast<size_t>(avg + 0.5), '#') << std::endl;
+        }
+        os << "  average " << double(live) / insns << ", peak " << peak << std::endl;
+    }
+
+
+    os.flags(flags);
+    os.precision(precision);
+}
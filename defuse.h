@@ -0,0 +1,120 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'defuse_profiler' class, which follows every value the
+    program writes to a register or to memory until it is read or
+    overwritten. Per static instruction it reports how many of its results
+    were never read (dead writes and dead stores) and how far away the first
+    read of a result was; over the whole run it reports register pressure,
+    the number of registers holding a value that will still be read.
+********************************************************************************************/
+
+
+#ifndef DEFUSE_H
+#define DEFUSE_H
+
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+
+
+#include "memory.h"
+#include "rv32i_observer.h"
+
+
+/***************************************************************
+Class: defuse_profiler
+
+
+Use:   Observer that tracks the last writer of each register
+       and memory word. A register value is dead if it is
+       overwritten before any instruction reads it; a store is
+       dead if a later store to the same word covers every byte
+       it wrote before any of them is loaded. A value still
+       unread when the run ends is not counted as dead.
+
+       A register value is live from the instruction after its
+       writer up to its last read. Pressure is the number of
+       live values per instruction, averaged over a fixed number
+       of time buckets whose width doubles as the run gets longer.
+
+
+Data:
+       regs      - Per register: writer, write time, last read.
+       words     - Per memory word written: writer, bytes
+                   written and whether any has been loaded.
+       stats     - Per static instruction counts.
+       buckets   - Live-register instruction slots per time bucket.
+       insns     - Instructions seen; the current one is
+                   number insns - 1.
+       cur_pc    - Address of the current instruction.
+***************************************************************/
+class defuse_profiler : public rv32i_observer
+{
+public:
+    void on_insn(uint32_t pc, uint32_t insn) override;
+    void on_reg_write(uint32_t r, uint32_t val) override;
+    void on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+    void on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+
+
+    // Print the top instructions by dead results (disassembled
+    // from mem) and the register pressure over time.
+    void report(std::ostream &os, const memory &mem, uint32_t top);
+
+
+private:
+    static constexpr uint32_t num_buckets = 64;
+
+
+    struct pc_stats
+    {
+        uint64_t writes = 0;
+        uint64_t dead   = 0;
+        uint64_t used   = 0;
+        uint64_t dist   = 0;        // sum of distances to first use
+        uint64_t stores = 0;
+        uint64_t dead_stores = 0;
+    };
+
+
+    // Map nodes don't move, so values point at their writer's
+    // stats directly.
+    struct reg_value
+    {
+        pc_stats *writer = nullptr;  // null until first written
+        bool     used = false;
+        uint64_t def  = 0;
+        uint64_t last_use = 0;
+    };
+
+
+    struct word_value
+    {
+        pc_stats *writer;
+        uint8_t  mask;              // bytes written by writer
+        bool     used;
+    };
+
+
+    void retire_value(reg_value &v, bool overwritten);
+    void add_live(uint64_t from, uint64_t to);
+    void read_reg(uint32_t r);
+
+
+    reg_value regs[32];
+    std::unordered_map<uint32_t, word_value> words;
+    std::unordered_map<uint32_t, pc_stats> stats;
+    uint64_t buckets[num_buckets] = {0};
+    uint64_t bucket_len = 1024;
+    uint64_t insns  = 0;
+    uint32_t cur_pc = 0;
+    bool finished   = false;
+};
+
+
+#endif
@@ -0,0 +1,988 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'gdbstub' class. Packets follow the GDB remote serial
+    protocol: "$data#cs" where cs is the modulo-256 sum of the data bytes in
+    two hex digits. Registers are exchanged in target byte order (little
+    endian), x0..x31 followed by pc, as described by the target.xml served
+    through qXfer:features:read.
+
+    Stop replies:
+        Breakpoint          T05swbreak:;
+        Watchpoint          T05awatch:<addr>;
+        EBREAK / step       T05
+        Illegal instruction T04  (SIGILL)
+        PC alignment error  T0a  (SIGBUS)
+        Replay divergence   T06  (SIGABRT)
+        Ctrl-C              T02  (SIGINT)
+        ECALL               W<a0 & 0xff> (the program has exited)
+
+    Monitor commands (qRcmd):
+        monitor cond <addr> [expr]   stop at <addr> only when expr holds
+        monitor hits <addr> <n>      stop at <addr> from the n-th hit on
+********************************************************************************************/
+
+
+#include "gdbstub.h"
+#include "hex.h"
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+using std::string;
+
+
+// Instructions executed between checks for a Ctrl-C from GDB.
+static constexpr uint32_t interrupt_poll_interval = 65536;
+
+
+static const char *const reg_names[32] =
+{
+    "zero", "ra", "sp",  "gp",  "tp", "t0", "t1", "t2",
+    "fp",   "s1", "a0",  "a1",  "a2", "a3", "a4", "a5",
+    "a6",   "a7", "s2",  "s3",  "s4", "s5", "s6", "s7",
+    "s8",   "s9", "s10", "s11", "t3", "t4", "t5", "t6"
+};
+
+
+/***************************************************************
+Function: gdbstub::gdbstub
+
+
+Use:      Constructor. Attaches the breakpoint set to the hart so
+          Z packets take effect immediately.
+
+
+Arguments:
+    h - Hart to debug.
+    m - Its memory.
+    b - Breakpoint set to maintain.
+    t - Reverse execution journal, or nullptr.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+gdbstub::gdbstub(rv32i_hart &h, memory &m, breakpoints &b, timetravel *t)
+    : hart(h), mem(m), bps(b), tt(t)
+{
+    hart.set_breakpoints(&bps);
+}
+
+
+/***************************************************************
+Function: gdbstub::~gdbstub
+
+
+Use:      Closes the sockets and removes a Unix socket file.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+gdbstub::~gdbstub()
+{
+    if (fd >= 0)
+        close(fd);
+    if (listen_fd >= 0)
+        close(listen_fd);
+    if (!unix_path.empty())
+        unlink(unix_path.c_str());
+}
+
+
+/***************************************************************
+Function: gdbstub::listen_tcp
+
+
+Use:      Creates a listening TCP socket on 127.0.0.1:port.
+
+
+Arguments:
+    port - TCP port number.
+
+
+Returns:
+    false (with a message on std::cerr) on failure.
+***************************************************************/
+bool gdbstub::listen_tcp(uint16_t port)
+{
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        perror("socket");
+        return false;
+    }
+
+
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+
+    sockaddr_in sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sin_family      = AF_INET;
+    sa.sin_port        = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) < 0
+        || listen(listen_fd, 1) < 0)
+    {
+        perror("gdb port");
+        return false;
+    }
+
+
+    std::cerr << "Waiting for GDB on localhost:" << port << std::endl;
+    return true;
+}
+
+
+/***************************************************************
+Function: gdbstub::listen_unix
+
+
+Use:      Creates a listening Unix-domain socket at path,
+          replacing any stale socket file.
+
+
+Arguments:
+    path - File system path of the socket.
+
+
+Returns:
+    false (with a message on std::cerr) on failure.
+***************************************************************/
+bool gdbstub::listen_unix(const std::string &path)
+{
+    sockaddr_un sa;
+    std::memset(&sa, 0, sizeof(sa));
+    if (path.size() >= sizeof(sa.sun_path))
+    {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return false;
+    }
+    sa.sun_family = AF_UNIX;
+    std::strcpy(sa.sun_path, path.c_str());
+
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        perror("socket");
+        return false;
+    }
+
+
+    unlink(path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&sa), sizeof(sa)) < 0
+        || listen(listen_fd, 1) < 0)
+    {
+        perror(path.c_str());
+        return false;
+    }
+    unix_path = path;
+
+
+    std::cerr << "Waiting for GDB on " << path << std::endl;
+    return true;
+}
+
+
+/***************************************************************
+Function: gdbstub::serve
+
+
+Use:      Accepts one connection and processes packets until GDB
+          detaches, kills the target, or disconnects.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void gdbstub::serve()
+{
+    fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+    {
+        perror("accept");
+        return;
+    }
+
+
+    string pkt;
+    while (get_packet(pkt))
+    {
+        if (!handle(pkt))
+            break;
+    }
+
+
+    close(fd);
+    fd = -1;
+}
+
+
+/***************************************************************
+Function: gdbstub::get_packet
+
+
+Use:      Reads the next packet, verifies its checksum and sends
+          the acknowledgement. Stray bytes (acks, Ctrl-C while
+          the target is already stopped) are skipped.
+
+
+Arguments:
+    pkt - Receives the packet data (between '$' and '#').
+
+
+Returns:
+    false if the connection was closed.
+***************************************************************/
+bool gdbstub::get_packet(std::string &pkt)
+{
+    while (true)
+    {
+        size_t start = rxbuf.find('$');
+        if (start != string::npos)
+        {
+            size_t end = rxbuf.find('#', start);
+            if (end != string::npos && end + 2 < rxbuf.size())
+            {
+                pkt = rxbuf.substr(start + 1, end - start - 1);
+                unsigned sum = 0, want = 0;
+                for (unsigned char c : pkt)
+                    sum += c;
+                std::sscanf(rxbuf.substr(end + 1, 2).c_str(), "%2x", &want);
+                rxbuf.erase(0, end + 3);
+
+
+                bool ok = (sum & 0xff) == want;
+                if (!no_ack)
+                    send(fd, ok ? "+" : "-", 1, 0);
+                if (ok)
+                    return true;
+                continue;
+            }
+        }
+
+
+        char buf[4096];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+            return false;
+        rxbuf.append(buf, n);
+    }
+}
+
+
+/***************************************************************
+Function: gdbstub::put_packet
+
+
+Use:      Frames data as a packet and sends it.
+
+
+Arguments:
+    data - Packet payload.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void gdbstub::put_packet(const std::string &data)
+{
+    unsigned sum = 0;
+    for (unsigned char c : data)
+        sum += c;
+
+
+    char cs[4];
+    std::snprintf(cs, sizeof(cs), "#%02x", sum & 0xff);
+    string frame = "$" + data + cs;
+    send(fd, frame.data(), frame.size(), 0);
+}
+
+
+/***************************************************************
+Function: gdbstub::handle
+
+
+Use:      Executes one command packet and sends its reply.
+
+
+Arguments:
+    pkt - Packet data.
+
+
+Returns:
+    false when the session should end (k or D).
+***************************************************************/
+bool gdbstub::handle(const std::string &pkt)
+{
+    if (pkt.empty())
+    {
+        put_packet("");
+        return true;
+    }
+
+
+    static const string xfer_target = "qXfer:features:read:target.xml";
+    uint32_t addr = 0, len = 0;
+
+
+    switch (pkt[0])
+    {
+    case '?':
+        put_packet(hart.is_halted() ? stop_reply() : "S05");
+        return true;
+
+
+    case 'g':
+        put_packet(read_registers());
+        return true;
+
+
+    case 'G':
+        put_packet(write_registers(pkt.substr(1)) ? "OK" : "E01");
+        return true;
+
+
+    case 'p':
+    {
+        uint32_t r = std::strtoul(pkt.c_str() + 1, nullptr, 16);
+        if (r < 32)
+            put_packet(hex32_le(static_cast<uint32_t>(hart.get_reg(r))));
+        else if (r == 32)
+            put_packet(hex32_le(hart.get_pc()));
+        else
+            put_packet("E01");
+        return true;
+    }
+
+
+    case 'P':
+    {
+        size_t eq = pkt.find('=');
+        if (eq == string::npos)
+        {
+            put_packet("E01");
+            return true;
+        }
+        uint32_t r = std::strtoul(pkt.c_str() + 1, nullptr, 16);
+        uint32_t v = parse_hex32_le(pkt.substr(eq + 1));
+        if (r < 32)
+            hart.set_reg(r, static_cast<int32_t>(v));
+        else if (r == 32)
+            hart.set_pc(v);
+        else
+        {
+            put_packet("E01");
+            return true;
+        }
+        if (tt)
+            tt->forget();
+        put_packet("OK");
+        return true;
+    }
+
+
+    case 'm':
+        if (std::sscanf(pkt.c_str() + 1, "%x,%x", &addr, &len) != 2)
+            put_packet("E01");
+        else
+            put_packet(read_memory(addr, len));
+        return true;
+
+
+    case 'M':
+    {
+        size_t colon = pkt.find(':');
+        if (colon == string::npos
+            || std::sscanf(pkt.c_str() + 1, "%x,%x", &addr, &len) != 2)
+            put_packet("E01");
+        else
+            put_packet(write_memory(addr, len, pkt.substr(colon + 1)) ? "OK" : "E14");
+        return true;
+    }
+
+
+    case 'c':
+    case 's':
+        if (pkt.size() > 1)
+        {
+            hart.set_pc(std::strtoul(pkt.c_str() + 1, nullptr, 16));
+            if (tt)
+                tt->forget();
+        }
+        put_packet(resume(pkt[0] == 's'));
+        return true;
+
+
+    case 'b':
+        if (tt && (pkt == "bs" || pkt == "bc"))
+            put_packet(reverse(pkt == "bs"));
+        else
+            put_packet("");
+        return true;
+
+
+    case 'Z':
+    case 'z':
+        put_packet(update_breakpoint(pkt));
+        return true;
+
+
+    case 'H':
+    case 'T':
+        put_packet("OK");
+        return true;
+
+
+    case 'k':
+        return false;
+
+
+    case 'D':
+        put_packet("OK");
+        return false;
+
+
+    default:
+        break;
+    }
+
+
+    if (pkt.compare(0, 10, "qSupported") == 0)
+    {
+        string features = "PacketSize=4000;qXfer:features:read+;"
+                          "QStartNoAckMode+;swbreak+;hwbreak+";
+        if (tt)
+            features += ";ReverseStep+;ReverseContinue+";
+        put_packet(features);
+    }
+    else if (pkt == "QStartNoAckMode")
+    {
+        put_packet("OK");
+        no_ack = true;
+    }
+    else if (pkt.compare(0, xfer_target.size(), xfer_target) == 0)
+        put_packet(target_xml(pkt.substr(xfer_target.size())));
+    else if (pkt.compare(0, 6, "qRcmd,") == 0)
+    {
+        string cmd;
+        for (size_t i = 6; i + 1 < pkt.size(); i += 2)
+            cmd += static_cast<char>(std::strtoul(pkt.substr(i, 2).c_str(), nullptr, 16));
+
+
+        string out, reply = monitor(cmd);
+        for (unsigned char c : reply)
+            out += hex::to_hex8(c);
+        put_packet(out);
+    }
+    else if (pkt == "qAttached")
+        put_packet("1");
+    else if (pkt == "qC")
+        put_packet("QC1");
+    else if (pkt == "qfThreadInfo")
+        put_packet("m1");
+    else if (pkt == "qsThreadInfo")
+        put_packet("l");
+    else if (pkt == "vCont?")
+        put_packet("vCont;c;C;s;S");
+    else if (pkt.compare(0, 6, "vCont;") == 0)
+        put_packet(resume(pkt[6] == 's' || pkt[6] == 'S'));
+    else
+        put_packet("");
+
+
+    return true;
+}
+
+
+/***************************************************************
+Function: gdbstub::read_registers
+
+
+Use:      Formats x0..x31 and pc for a 'g' reply.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    264 hex digits.
+***************************************************************/
+std::string gdbstub::read_registers() const
+{
+    string s;
+    for (uint32_t r = 0; r < 32; ++r)
+        s += hex32_le(static_cast<uint32_t>(hart.get_reg(r)));
+    s += hex32_le(hart.get_pc());
+    return s;
+}
+
+
+/***************************************************************
+Function: gdbstub::write_registers
+
+
+Use:      Loads x0..x31 and pc from a 'G' packet. Reverse
+          execution history is discarded, as restoring it would
+          undo the change.
+
+
+Arguments:
+    hex - Register data in 'g' format.
+
+
+Returns:
+    false if hex is too short.
+***************************************************************/
+bool gdbstub::write_registers(const std::string &hex)
+{
+    if (hex.size() < 33 * 8)
+        return false;
+
+
+    for (uint32_t r = 0; r < 32; ++r)
+        hart.set_reg(r, static_cast<int32_t>(parse_hex32_le(hex.substr(r * 8, 8))));
+    hart.set_pc(parse_hex32_le(hex.substr(32 * 8, 8)));
+    if (tt)
+        tt->forget();
+    return true;
+}
+
+
+/***************************************************************
+Function: gdbstub::read_memory
+
+
+Use:      Formats len bytes at addr for an 'm' reply. A read that
+          runs off the end of memory returns the bytes before the
+          boundary, as the protocol allows.
+
+
+Arguments:
+    addr - First byte.
+    len  - Byte count.
+
+
+Returns:
+    Hex bytes, or "E14" if addr itself is out of range.
+***************************************************************/
+std::string gdbstub::read_memory(uint32_t addr, uint32_t len) const
+{
+    string s;
+    for (uint32_t i = 0; i < len && addr + i >= addr && addr + i < mem.get_size(); ++i)
+        s += hex::to_hex8(mem.get8(addr + i));
+    return s.empty() && len ? "E14" : s;
+}
+
+
+/***************************************************************
+Function: gdbstub::write_memory
+
+
+Use:      Stores the bytes of an 'M' packet. Reverse execution
+          history is discarded, as restoring it would undo the
+          change.
+
+
+Arguments:
+    addr - First byte.
+    len  - Byte count.
+    hex  - 2*len hex digits.
+
+
+Returns:
+    false if the data is short or the range is out of memory.
+***************************************************************/
+bool gdbstub::write_memory(uint32_t addr, uint32_t len, const std::string &hex)
+{
+    if (hex.size() < 2 * size_t(len)
+        || (len && (uint64_t(addr) + len > mem.get_size())))
+        return false;
+
+
+    for (uint32_t i = 0; i < len; ++i)
+        mem.set8(addr + i, static_cast<uint8_t>(std::strtoul(hex.substr(2 * i, 2).c_str(), nullptr, 16)));
+    if (tt && len)
+        tt->forget();
+    return true;
+}
+
+
+/***************************************************************
+Function: gdbstub::update_breakpoint
+
+
+Use:      Handles Z (insert) and z (remove) packets:
+            0, 1 - software / hardware breakpoint
+            2    - write watchpoint
+            3    - read watchpoint
+            4    - access watchpoint
+
+
+Arguments:
+    pkt - "Ztype,addr,kind" or "ztype,addr,kind".
+
+
+Returns:
+    "OK", "E01" on a malformed/unknown request, or "" for an
+    unsupported type.
+***************************************************************/
+std::string gdbstub::update_breakpoint(const std::string &pkt)
+{
+    unsigned type = 0;
+    uint32_t addr = 0, kind = 0;
+    if (std::sscanf(pkt.c_str() + 1, "%u,%x,%x", &type, &addr, &kind) < 2)
+        return "E01";
+
+
+    bool insert = pkt[0] == 'Z';
+    breakpoints::watch_type wt;
+
+
+    switch (type)
+    {
+    case 0:
+    case 1:
+        if (insert)
+            bps.add_breakpoint(addr);
+        else if (!bps.remove_breakpoint(addr))
+            return "E01";
+        return "OK";
+
+
+    case 2: wt = breakpoints::watch_write;  break;
+    case 3: wt = breakpoints::watch_read;   break;
+    case 4: wt = breakpoints::watch_access; break;
+    default:
+        return "";
+    }
+
+
+    if (insert)
+        bps.add_watchpoint(addr, kind, wt);
+    else if (!bps.remove_watchpoint(addr, kind, wt))
+        return "E01";
+    return "OK";
+}
+
+
+/***************************************************************
+Function: gdbstub::monitor
+
+
+Use:      Runs a 'monitor' command from GDB: "cond addr [expr]"
+          sets or (without expr) clears a breakpoint condition,
+          "hits addr n" sets a hit count. The breakpoint itself is
+          still placed with GDB's own 'break' command.
+
+
+Arguments:
+    cmd - Decoded command text.
+
+
+Returns:
+    Text for GDB to print.
+***************************************************************/
+std::string gdbstub::monitor(const std::string &cmd)
+{
+    std::istringstream iss(cmd);
+    string verb;
+    uint32_t addr;
+
+
+    if (!(iss >> verb) || (verb != "cond" && verb != "hits")
+        || !(iss >> std::hex >> addr))
+        return "usage: monitor cond <addr> [expr] | monitor hits <addr> <n>\n";
+
+
+    if (verb == "hits")
+    {
+        uint32_t n;
+        if (!(iss >> std::dec >> n))
+            return "usage: monitor hits <addr> <n>\n";
+        bps.set_hit_count(addr, n);
+        return "ok\n";
+    }
+
+
+    string expr, err;
+    std::getline(iss, expr);
+    expr.erase(0, expr.find_first_not_of(" \t"));
+    if (!bps.set_condition(addr, expr, err))
+        return "bad condition: " + err + "\n";
+    return expr.empty() ? "condition removed\n" : "ok\n";
+}
+
+
+/***************************************************************
+Function: gdbstub::target_xml
+
+
+Use:      Serves the RV32I target description in the chunks GDB
+          asks for.
+
+
+Arguments:
+    annex - ":offset,length" from the qXfer request.
+
+
+Returns:
+    'm' + data if more follows, 'l' + data for the last chunk.
+***************************************************************/
+std::string gdbstub::target_xml(const std::string &annex) const
+{
+    std::ostringstream os;
+    os << "<?xml version=\"1.0\"?>"
+       << "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+       << "<target version=\"1.0\">"
+       << "<architecture>riscv:rv32</architecture>"
+       << "<feature name=\"org.gnu.gdb.riscv.cpu\">";
+    for (int r = 0; r < 32; ++r)
+    {
+        os << "<reg name=\"" << reg_names[r] << "\" bitsize=\"32\" type=\""
+           << (r == 1 ? "code_ptr" : r == 2 || r == 8 ? "data_ptr" : "int")
+           << "\" regnum=\"" << r << "\"/>";
+    }
+    os << "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\" regnum=\"32\"/>"
+       << "</feature></target>";
+
+
+    string xml = os.str();
+    uint32_t off = 0, len = 0;
+    if (std::sscanf(annex.c_str(), ":%x,%x", &off, &len) != 2)
+        return "E01";
+    if (off >= xml.size())
+        return "l";
+
+
+    string chunk = xml.substr(off, len);
+    return (off + chunk.size() < xml.size() ? "m" : "l") + chunk;
+}
+
+
+/***************************************************************
+Function: gdbstub::resume
+
+
+Use:      Single-steps or continues the hart. A continue runs the
+          ordinary tick() loop and checks the socket for Ctrl-C
+          only every interrupt_poll_interval instructions.
+
+
+Arguments:
+    step - true to execute exactly one instruction.
+
+
+Returns:
+    The stop reply to send.
+***************************************************************/
+std::string gdbstub::resume(bool step)
+{
+    // A program that has exited (ECALL) can't be resumed.
+    if (hart.is_halted() && hart.get_halt_reason() == "ECALL instruction")
+        return stop_reply();
+
+
+    hart.resume();
+
+
+    if (step)
+    {
+        hart.tick();
+        return hart.is_halted() ? stop_reply() : "T05";
+    }
+
+
+    while (!hart.is_halted())
+    {
+        for (uint32_t i = 0; i < interrupt_poll_interval && !hart.is_halted(); ++i)
+            hart.tick();
+
+
+        if (!hart.is_halted() && interrupted())
+            return "T02";
+    }
+    return stop_reply();
+}
+
+
+/***************************************************************
+Function: gdbstub::reverse
+
+
+Use:      Reverse-step (bs) or reverse-continue (bc). Reverse
+          continue stops at the most recent earlier state whose
+          pc has a breakpoint whose condition, if any, holds. Hit
+          counts don't apply in reverse.
+
+
+Arguments:
+    step - true for a single reverse step.
+
+
+Returns:
+    The stop reply to send.
+***************************************************************/
+std::string gdbstub::reverse(bool step)
+{
+    if (step)
+        return tt->reverse_step() ? "T05" : "T05replaylog:begin;";
+
+
+    bool hit = tt->reverse_continue([this]()
+    {
+        uint32_t pc = hart.get_pc();
+        return bps.is_breakpoint(pc) && bps.condition_holds(pc, hart, mem);
+    });
+    return hit ? "T05swbreak:;" : "T05replaylog:begin;";
+}
+
+
+/***************************************************************
+Function: gdbstub::stop_reply
+
+
+Use:      Translates the hart's halt reason into a stop reply.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    A T, S or W packet payload.
+***************************************************************/
+std::string gdbstub::stop_reply() const
+{
+    const string &r = hart.get_halt_reason();
+
+
+    if (r == "Breakpoint")
+        return "T05swbreak:;";
+    if (r == "Watchpoint")
+        return "T05awatch:" + hex::to_hex32(hart.get_watch_addr()) + ";";
+    if (r == "ECALL instruction")
+        return "W" + hex::to_hex8(static_cast<uint8_t>(hart.get_reg(10)));
+    if (r == "Illegal instruction")
+        return "T04";
+    if (r == "PC alignment error")
+        return "T0a";
+    if (r == "Replay divergence")
+        return "T06";
+    return "T05";
+}
+
+
+/***************************************************************
+Function: gdbstub::interrupted
+
+
+Use:      Checks, without blocking, whether GDB sent a Ctrl-C
+          (0x03) while the target was running.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    true if an interrupt byte was received.
+***************************************************************/
+bool gdbstub::interrupted()
+{
+    pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, 0) <= 0)
+        return false;
+
+
+    char buf[256];
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0)
+        return true;        // connection gone; stop and let serve() notice
+
+
+    rxbuf.append(buf, n);
+    size_t pos = rxbuf.find('\x03');
+    if (pos == string::npos)
+        return false;
+    rxbuf.erase(pos, 1);
+    return true;
+}
+
+
+/***************************************************************
+Function: gdbstub::hex32_le
+
+
+Use:      Formats a 32-bit value as 8 hex digits in little-endian
+          byte order (GDB register format).
+
+
+Arguments:
+    v - Value.
+
+
+Returns:
+    The hex string.
+***************************************************************/
+std::string gdbstub::hex32_le(uint32_t v)
+{
+    string s;
+    for (int i = 0; i < 4; ++i)
+        s += hex::to_hex8(static_cast<uint8_t>(v >> (8 * i)));
+    return s;
+}
+
+
+/***************************************************************
+Function: gdbstub::parse_hex32_le
+
+
+Use:      Inverse of hex32_le().
+
+
+Arguments:
+    s - Up to 8 hex digits, little-endian byte order.
+
+
+Returns:
+    The value.
+***************************************************************/
+uint32_t gdbstub::parse_hex32_le(const std::string &s)
+{
+    uint32_t v = 0;
+    for (size_t i = 0; i + 1 < s.size() && i < 8; i += 2)
+        v |= static_cast<uint32_t>(std::strtoul(s.substr(i, 2).c_str(), nullptr, 16)) << (4 * i);
+    return v;
+}
@@ -0,0 +1,110 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'gdbstub' class, a GDB remote serial protocol server that lets
+    riscv*-gdb debug a program running on a simulated hart. It listens on a TCP
+    port bound to localhost or on a Unix-domain socket and supports register
+    and memory access, software/hardware breakpoints, watchpoints, single-step,
+    continue, conditional breakpoints through 'monitor' commands, and (when
+    a timetravel journal is attached) reverse-step and
+    reverse-continue. Writing registers or memory from GDB discards the
+    reverse execution history, which would otherwise undo the change.
+
+    'continue' runs the hart's normal tick() loop with the breakpoints engine
+    attached, so execution between stops runs at full speed; the socket is
+    only polled for an interrupt (Ctrl-C) every few thousand instructions.
+********************************************************************************************/
+
+
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+
+#include <cstdint>
+#include <string>
+
+
+#include "rv32i_hart.h"
+#include "memory.h"
+#include "breakpoints.h"
+#include "timetravel.h"
+
+
+/***************************************************************
+Class: gdbstub
+
+
+Use:   Serves one GDB connection at a time for a single hart.
+       Call listen_tcp() or listen_unix(), then serve().
+
+
+Data:
+       hart, mem, bps - Target being debugged.
+       tt             - Reverse execution journal (may be null).
+       listen_fd      - Listening socket.
+       fd             - Connected socket.
+       no_ack         - GDB switched off packet acknowledgements.
+***************************************************************/
+class gdbstub
+{
+public:
+    gdbstub(rv32i_hart &h, memory &m, breakpoints &b, timetravel *t);
+    ~gdbstub();
+
+
+    // Listen on 127.0.0.1:port. Returns false on error.
+    bool listen_tcp(uint16_t port);
+
+
+    // Listen on a Unix-domain socket at path. Returns false on error.
+    bool listen_unix(const std::string &path);
+
+
+    // Accept a connection and process commands until GDB detaches or
+    // kills the target.
+    void serve();
+
+
+private:
+    bool get_packet(std::string &pkt);
+    void put_packet(const std::string &data);
+    bool handle(const std::string &pkt);
+
+
+    std::string read_registers() const;
+    bool write_registers(const std::string &hex);
+    std::string read_memory(uint32_t addr, uint32_t len) const;
+    bool write_memory(uint32_t addr, uint32_t len, const std::string &hex);
+    std::string update_breakpoint(const std::string &pkt);
+    std::string target_xml(const std::string &annex) const;
+    std::string monitor(const std::string &cmd);
+
+
+    std::string resume(bool step);
+    std::string reverse(bool step);
+    std::string stop_reply() const;
+    bool interrupted();
+
+
+    static std::string hex32_le(uint32_t v);
+    static uint32_t parse_hex32_le(const std::string &s);
+
+
+    rv32i_hart &hart;
+    memory &mem;
+    breakpoints &bps;
+    timetravel *tt;
+
+
+    int listen_fd = -1;
+    int fd        = -1;
+    bool no_ack   = false;
+    std::string unix_path;
+    std::string rxbuf;
+};
+
+
+#endif
@@ -0,0 +1,518 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'hex_image' parsers. decode8() turns eight ASCII hex
+    digits, loaded as one 64-bit word, into four bytes and checks that all
+    eight were hex digits, with a fixed sequence of adds, masks and shifts and
+    no per-character branches. Data records and words go straight into the
+    segment buffers; line numbers are only worked out when reporting an error.
+********************************************************************************************/
+
+
+#include "hex_image.h"
+
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+
+using std::string;
+
+
+/***************************************************************
+Function: make_digits
+
+
+Use:      Builds, at compile time, the value of each character as
+          a hex digit.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    A table giving 0..15 for hex digits and 0x80 for anything
+    else.
+***************************************************************/
+static constexpr std::array<uint8_t, 256> make_digits()
+{
+    std::array<uint8_t, 256> t {};
+    for (int c = 0; c < 256; ++c)
+    {
+        if (c >= '0' && c <= '9')
+            t[c] = static_cast<uint8_t>(c - '0');
+        else if (c >= 'a' && c <= 'f')
+            t[c] = static_cast<uint8_t>(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            t[c] = static_cast<uint8_t>(c - 'A' + 10);
+        else
+            t[c] = 0x80;
+    }
+    return t;
+}
+
+
+static constexpr std::array<uint8_t, 256> digit = make_digits();
+
+
+/***************************************************************
+Function: is_space
+
+
+Use:      Whitespace test for the parsers.
+
+
+Arguments:
+    c - Character.
+
+
+Returns:
+    true for space, tab, newline, carriage return, vertical tab
+    and form feed.
+***************************************************************/
+static inline bool is_space(uint8_t c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+
+/***************************************************************
+Function: decode8
+
+
+Use:      Decodes eight hex digits into four bytes, in text order.
+          Each character c yields (c & 0xf) + 9 * bit 6 of c; the
+          range checks use the carry into bit 7 of each byte.
+
+
+Arguments:
+    p   - Eight characters.
+    out - Receives four bytes.
+
+
+Returns:
+    false if any of the characters is not a hex digit (out is
+    then meaningless).
+***************************************************************/
+static inline bool decode8(const char *p, uint8_t *out)
+{
+    const uint64_t ones = 0x0101010101010101ull;
+    const uint64_t high = 0x8080808080808080ull;
+    uint64_t x;
+
+
+    std::memcpy(&x, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+
+
+    // For bytes below 0x80, bit 7 of (y + 0x80 - lo) is set when
+    // y >= lo, and bit 7 of (y + 0x7f - hi) is clear when y <= hi.
+    uint64_t lower    = x | (0x20 * ones);
+    uint64_t is_digit = (x + (0x80 - '0') * ones) & ~(x + (0x7f - '9') * ones);
+    uint64_t is_alpha = (lower + (0x80 - 'a') * ones) & ~(lower + (0x7f - 'f') * ones);
+    bool ok = ((is_digit | is_alpha) & ~x & high) == high;
+
+
+    uint64_t nib = (x & (0x0f * ones)) + ((x >> 6) & ones) * 9;
+
+
+    // Pair the nibbles into bytes, then pack the bytes together.
+    uint64_t t = ((nib & 0x00ff00ff00ff00ffull) << 4) | ((nib >> 8) & 0x00ff00ff00ff00ffull);
+    t = (t | (t >> 8)) & 0x0000ffff0000ffffull;
+    t = (t | (t >> 16)) & 0xffffffffull;
+
+
+    out[0] = static_cast<uint8_t>(t);
+    out[1] = static_cast<uint8_t>(t >> 8);
+    out[2] = static_cast<uint8_t>(t >> 16);
+    out[3] = static_cast<uint8_t>(t >> 24);
+    return ok;
+}
+
+
+/***************************************************************
+Function: decode_bytes
+
+
+Use:      Decodes 2 * n hex digits into n bytes.
+
+
+Arguments:
+    p   - The digits.
+    n   - Number of bytes.
+    out - Receives the bytes.
+
+
+Returns:
+    false if any character is not a hex digit.
+***************************************************************/
+static inline bool decode_bytes(const char *p, size_t n, uint8_t *out)
+{
+    bool ok = true;
+    uint8_t bad = 0;
+    size_t i = 0;
+
+
+    for (; i + 4 <= n; i += 4)
+        ok &= decode8(p + 2 * i, out + i);
+    for (; i < n; ++i)
+    {
+        uint8_t hi = digit[static_cast<uint8_t>(p[2 * i])];
+        uint8_t lo = digit[static_cast<uint8_t>(p[2 * i + 1])];
+        bad |= hi | lo;
+        out[i] = static_cast<uint8_t>(hi << 4 | lo);
+    }
+    return ok && !(bad & 0x80);
+}
+
+
+/***************************************************************
+Function: fail
+
+
+Use:      Sets a parser error message naming the line of pos.
+
+
+Arguments:
+    p    - Start of the buffer.
+    pos  - Offset of the error.
+    what - Description.
+    err  - Receives the message.
+
+
+Returns:
+    false, for the parser to return.
+***************************************************************/
+static bool fail(const char *p, size_t pos, const char *what, string &err)
+{
+    size_t line = 1 + std::count(p, p + pos, '\n');
+    err = "line " + std::to_string(line) + ": " + what;
+    return false;
+}
+
+
+/***************************************************************
+Function: append_at
+
+
+Use:      Extends the last segment if addr follows on from it, or
+          starts a new one, and makes room for len more bytes.
+
+
+Arguments:
+    segs - Segments so far.
+    addr - Address of the bytes.
+    len  - Number of bytes.
+    hint - Expected total size, reserved for the first segment.
+
+
+Returns:
+    Where to write the bytes.
+***************************************************************/
+static uint8_t *append_at(std::vector<hex_image::segment> &segs, uint32_t addr, size_t len, size_t hint)
+{
+    if (segs.empty() || uint64_t(segs.back().addr) + segs.back().data.size() != addr)
+    {
+        segs.push_back({ addr, {} });
+        if (segs.size() == 1)
+            segs.back().data.reserve(hint);
+    }
+
+
+    std::vector<uint8_t> &d = segs.back().data;
+    d.resize(d.size() + len);
+    return d.data() + d.size() - len;
+}
+
+
+/***************************************************************
+Function: hex_image::parse_ihex
+
+
+Use:      Decodes an Intel HEX image.
+
+
+Arguments:
+    p, n      - The file contents.
+    segs      - Receives the data.
+    has_entry - Set if there is a start address record.
+    entry     - Receives the start address.
+    err       - Receives an error message.
+
+
+Returns:
+    false on a malformed record.
+***************************************************************/
+bool hex_image::parse_ihex(const char *p, size_t n, std::vector<segment> &segs,
+                           bool &has_entry, uint32_t &entry, string &err)
+{
+    uint32_t upper = 0;            // from type 02/04 records
+    size_t pos = 0;
+    uint8_t rec[256];
+
+
+    // Contiguous data records are collected here and appended to
+    // segs in batches.
+    uint8_t run[4096];
+    size_t run_len = 0;
+    uint32_t run_addr = 0;
+    auto flush = [&]
+    {
+        if (run_len)
+            std::memcpy(append_at(segs, run_addr, run_len, n / 2), run, run_len);
+        run_len = 0;
+    };
+
+
+    while (pos < n)
+    {
+        if (is_space(static_cast<uint8_t>(p[pos])))
+        {
+            ++pos;
+            continue;
+        }
+        if (p[pos] != ':' || n - pos < 11)
+            return fail(p, pos, "malformed record.", err);
+
+
+        uint8_t hdr[4];
+        if (!decode_bytes(p + pos + 1, 4, hdr))
+            return fail(p, pos, "bad hex digit.", err);
+
+
+        uint32_t len  = hdr[0];
+        uint32_t type = hdr[3];
+        size_t chars  = 1 + 2 * (len + 5);
+        if (n - pos < chars || (n - pos > chars && !is_space(static_cast<uint8_t>(p[pos + chars]))))
+            return fail(p, pos, "length does not match the record.", err);
+
+
+        uint32_t addr = upper + (uint32_t(hdr[1]) << 8 | hdr[2]);
+        uint8_t *out  = rec;
+        if (type == 0x00)
+        {
+            if (run_len && (run_addr + run_len != addr || run_len + len > sizeof(run)))
+                flush();
+            if (!run_len)
+                run_addr = addr;
+            out = run + run_len;
+        }
+
+
+        uint8_t check;
+        if (!decode_bytes(p + pos + 9, len, out) || !decode_bytes(p + pos + 9 + 2 * len, 1, &check))
+            return fail(p, pos, "bad hex digit.", err);
+
+
+        uint8_t sum = hdr[0] + hdr[1] + hdr[2] + hdr[3] + check;
+        for (uint32_t i = 0; i < len; ++i)
+            sum += out[i];
+        if (sum != 0)
+            return fail(p, pos, "bad checksum.", err);
+
+
+        switch (type)
+        {
+        case 0x00:
+            run_len += len;
+            break;
+
+
+        case 0x01:
+            flush();
+            return true;
+
+
+        case 0x02:
+        case 0x04:
+            if (len != 2)
+                return fail(p, pos, "bad address record.", err);
+            upper = (uint32_t(out[0]) << 8 | out[1]) << (type == 0x02 ? 4 : 16);
+            break;
+
+
+        case 0x03:
+        case 0x05:
+            if (len != 4)
+                return fail(p, pos, "bad start address record.", err);
+            has_entry = true;
+            if (type == 0x03)
+                entry = (uint32_t(out[0]) << 8 | out[1]) * 16 + (uint32_t(out[2]) << 8 | out[3]);
+            else
+                entry = uint32_t(out[0]) << 24 | uint32_t(out[1]) << 16 | uint32_t(out[2]) << 8 | out[3];
+            break;
+
+
+        default:
+            return fail(p, pos, "unknown record type.", err);
+        }
+        pos += chars;
+    }
+
+
+    flush();
+    return true;
+}
+
+
+/***************************************************************
+Function: hex_image::parse_readmemh
+
+
+Use:      Decodes a $readmemh image. 8-digit words (the usual
+          32-bit case) take the decode8() path; other widths, the
+          last word of a file with no final newline, and words
+          with '_' separators are decoded a digit at a time.
+
+
+Arguments:
+    p, n - The file contents.
+    base - Byte address of word 0.
+    segs - Receives the data.
+    err  - Receives an error message.
+
+
+Returns:
+    false on malformed input, x/z digits, a word wider than the
+    first one, or an address past 4 GiB.
+***************************************************************/
+bool hex_image::parse_readmemh(const char *p, size_t n, uint32_t base,
+                               std::vector<segment> &segs, string &err)
+{
+    uint32_t width = 0;            // bytes per word, set by the first word
+    uint64_t word  = 0;            // address of the next word, in words
+    size_t pos = 0;
+
+
+    while (pos < n)
+    {
+        uint8_t c = static_cast<uint8_t>(p[pos]);
+        if (is_space(c))
+        {
+            ++pos;
+            continue;
+        }
+
+
+        if (c == '/')
+        {
+            if (pos + 1 < n && p[pos + 1] == '/')
+            {
+                const void *eol = std::memchr(p + pos, '\n', n - pos);
+                pos = eol ? static_cast<const char *>(eol) - p : n;
+                continue;
+            }
+            if (pos + 1 < n && p[pos + 1] == '*')
+            {
+                size_t i = pos + 2;
+                while (i + 1 < n && !(p[i] == '*' && p[i + 1] == '/'))
+                    ++i;
+                if (i + 1 >= n)
+                    return fail(p, pos, "unterminated comment.", err);
+                pos = i + 2;
+                continue;
+            }
+            return fail(p, pos, "stray '/'.", err);
+        }
+
+
+        uint8_t bytes[8];
+        bool at = c == '@';
+
+
+        // The common case: runs of 32-bit words of exactly 8 digits,
+        // each followed by one whitespace character. They are
+        // decoded into a local buffer and appended in batches.
+        if (!at && width == 4)
+        {
+            uint8_t run[512];
+            size_t k = 0;
+            while (k < sizeof(run) && n - pos >= 9
+                   && is_space(static_cast<uint8_t>(p[pos + 8])) && decode8(p + pos, bytes))
+            {
+                run[k]     = bytes[3];
+                run[k + 1] = bytes[2];
+                run[k + 2] = bytes[1];
+                run[k + 3] = bytes[0];
+                k   += 4;
+                pos += 9;
+            }
+
+
+            if (k)
+            {
+                uint64_t addr = base + word * 4;
+                if (addr + k > 0x100000000ull)
+                    return fail(p, pos, "address past 4 GiB.", err);
+                std::memcpy(append_at(segs, static_cast<uint32_t>(addr), k, n / 2), run, k);
+                word += k / 4;
+                continue;
+            }
+        }
+
+
+        // Anything else: one digit at a time.
+        size_t start = pos + at;
+        size_t end   = start;
+        uint64_t v   = 0;
+        uint32_t nd  = 0;
+        uint8_t bad  = 0;
+        for (; end < n && !is_space(static_cast<uint8_t>(p[end])) && p[end] != '/'; ++end)
+        {
+            if (p[end] == '_')
+                continue;
+            uint8_t d = digit[static_cast<uint8_t>(p[end])];
+            bad |= d;
+            v = v << 4 | (d & 0xf);
+            ++nd;
+        }
+
+
+        if (bad & 0x80)
+        {
+            bool xz = std::find_if(p + start, p + end, [](char ch)
+                                   { return ch == 'x' || ch == 'X' || ch == 'z' || ch == 'Z'; }) != p + end;
+            return fail(p, pos, xz ? "x/z digits are not supported." : "bad hex digit.", err);
+        }
+        if (nd == 0)
+            return fail(p, pos, "missing address.", err);
+        if (nd > 16)
+            return fail(p, pos, "word or address too long.", err);
+
+
+        if (at)
+        {
+            if (v > 0xffffffffull)
+                return fail(p, pos, "address past 4 GiB.", err);
+            word = v;
+            pos  = end;
+            continue;
+        }
+
+
+        if (width == 0)
+            width = (nd + 1) / 2;
+        if (nd > 2 * width)
+            return fail(p, pos, "word wider than the first word.", err);
+
+
+        uint64_t addr = base + word * width;
+        if (word > 0xffffffffull || addr + width > 0x100000000ull)
+            return fail(p, pos, "address past 4 GiB.", err);
+
+
+        uint8_t *out = append_at(segs, static_cast<uint32_t>(addr), width, n / 2);
+        for (uint32_t i = 0; i < width; ++i)
+            out[i] = static_cast<uint8_t>(v >> (8 * i));
+        ++word;
+        pos = end;
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'hex_image' class, which decodes textual hex memory images:
+    Intel HEX files and the Verilog $readmemh format produced by RTL test
+    flows. The parsers work on a buffer holding the whole file (normally a
+    mapping of it) and decode eight hex digits at a time with SWAR bit
+    tricks, so large images load at hundreds of MB/s.
+********************************************************************************************/
+
+
+#ifndef HEX_IMAGE_H
+#define HEX_IMAGE_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/***************************************************************
+Class: hex_image
+
+
+Use:   Static decoders from hex text to address/bytes segments.
+       Contiguous data ends up in a single segment. On an error
+       the parsers return false with err naming the line.
+***************************************************************/
+class hex_image
+{
+public:
+    // One contiguous run of decoded bytes.
+    struct segment
+    {
+        uint32_t addr;
+        std::vector<uint8_t> data;
+    };
+
+
+    // Intel HEX: data (00), EOF (01), extended segment/linear
+    // address (02/04) and start address (03/05) records, each with
+    // its checksum checked. A start address sets entry.
+    static bool parse_ihex(const char *p, size_t n, std::vector<segment> &segs,
+                           bool &has_entry, uint32_t &entry, std::string &err);
+
+
+    // $readmemh: whitespace-separated hex words, "@addr" (in words)
+    // address changes and // or /* */ comments. The word width is
+    // that of the first word (2 digits = bytes, 8 = 32-bit words);
+    // words are stored little-endian from byte address base.
+    static bool parse_readmemh(const char *p, size_t n, uint32_t base,
+                               std::vector<segment> &segs, std::string &err);
+};
+
+
+#endif
@@ -0,0 +1,165 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'hpm_unit' class. Each event keeps a bitmask of the
+    counters that count it, so an event nobody selected costs one test.
+********************************************************************************************/
+
+
+#include "hpm.h"
+#include "rv32i_decode.h"
+
+
+/***************************************************************
+Function: hpm_unit::rebuild
+
+
+Use:      Recomputes the per-event counter masks from mhpmevent3..31
+          and mcountinhibit.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void hpm_unit::rebuild()
+{
+    for (uint32_t &m : masks)
+        m = 0;
+
+
+    uint32_t inhibit = csrs.get_inhibit();
+    for (uint32_t n = 3; n < 32; ++n)
+    {
+        uint32_t e = csrs.get_hpm_event(n);
+        if (e != ev_none && e < num_events && !((inhibit >> n) & 1))
+            masks[e] |= 1u << n;
+    }
+
+
+    active = false;
+    for (uint32_t m : masks)
+        active = active || m != 0;
+}
+
+
+/***************************************************************
+Function: hpm_unit::on_insn
+
+
+Use:      Counts the instruction, and a load-use stall if it
+          reads the register loaded by the previous instruction.
+
+
+Arguments:
+    pc   - Instruction address.
+    insn - Instruction word.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void hpm_unit::on_insn(uint32_t pc, uint32_t insn)
+{
+    (void)pc;
+    count(ev_insn);
+
+
+    uint32_t opcode = rv32i_decode::get_opcode(insn);
+    if (last_load)
+    {
+        if ((rv32i_decode::reads_rs1(insn) && rv32i_decode::get_rs1(insn) == last_load)
+            || (rv32i_decode::reads_rs2(insn) && rv32i_decode::get_rs2(insn) == last_load))
+            count(ev_load_use);
+    }
+
+
+    last_load = opcode == rv32i_decode::opcode_load ? rv32i_decode::get_rd(insn) : 0;
+    indirect  = opcode == rv32i_decode::opcode_jalr;
+}
+
+
+/***************************************************************
+Function: hpm_unit::on_load
+
+
+Use:      Counts a load.
+
+
+Arguments:
+    pc, addr, len, val - Unused.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void hpm_unit::on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)pc; (void)addr; (void)len; (void)val;
+    count(ev_load);
+}
+
+
+/***************************************************************
+Function: hpm_unit::on_store
+
+
+Use:      Counts a store.
+
+
+Arguments:
+    pc, addr, len, val - Unused.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void hpm_unit::on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)pc; (void)addr; (void)len; (void)val;
+    count(ev_store);
+}
+
+
+/***************************************************************
+Function: hpm_unit::on_branch
+
+
+Use:      Counts branches, taken branches, jumps and mispredicts.
+          Conditional branches are predicted taken when they go
+          backwards; jal always predicts right, jalr never does.
+
+
+Arguments:
+    pc          - Branch address.
+    target      - Branch target.
+    taken       - Whether the branch was taken.
+    conditional - Conditional branch (else a jump).
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void hpm_unit::on_branch(uint32_t pc, uint32_t target, bool taken, bool conditional)
+{
+    if (!conditional)
+    {
+        count(ev_jump);
+        if (indirect)
+            count(ev_mispredict);
+        return;
+    }
+
+
+    count(ev_branch);
+    if (taken)
+        count(ev_branch_taken);
+    if (taken != (target < pc))
+        count(ev_mispredict);
+}
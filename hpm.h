@@ -0,0 +1,116 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'hpm_unit' class, which drives the hardware performance
+    monitor counters mhpmcounter3..31. Writing an event number to mhpmeventN
+    makes counter N count that event; the unit attaches itself to the hart
+    as an observer only while at least one counter has an event selected and
+    is not inhibited by mcountinhibit, so an idle unit costs nothing.
+
+    Events (the value written to mhpmeventN):
+        0   none
+        1   instructions retired
+        2   loads
+        3   stores
+        4   conditional branches
+        5   conditional branches taken
+        6   branch mispredicts (static backward-taken/forward-not-taken
+            prediction; jalr counts as mispredicted)
+        7   jumps (jal, jalr)
+        8   load-use stalls (an instruction reads the register loaded by
+            the one before it, as in a classic 5-stage pipeline)
+
+    Any other value reads back as 0. There is no cache model, so no cache
+    events are offered. A counter that wraps sets the OF bit (bit 31) of
+    its mhpmeventNh.
+********************************************************************************************/
+
+
+#ifndef HPM_H
+#define HPM_H
+
+
+#include <cstdint>
+
+
+#include "csr.h"
+#include "rv32i_observer.h"
+
+
+/***************************************************************
+Class: hpm_unit
+
+
+Use:   Counts the selected events into a hart's csr_file.
+       rebuild() must be called after mhpmeventN or
+       mcountinhibit change.
+
+
+Data:
+       csrs       - The hart's CSRs, which hold the counters.
+       masks      - For each event, the counters that count it.
+       last_load  - rd of the previous instruction if it was a
+                    load (0 otherwise), for load-use stalls.
+       indirect   - The current instruction is a jalr.
+***************************************************************/
+class hpm_unit : public rv32i_observer
+{
+public:
+    enum event : uint32_t
+    {
+        ev_none,
+        ev_insn,
+        ev_load,
+        ev_store,
+        ev_branch,
+        ev_branch_taken,
+        ev_mispredict,
+        ev_jump,
+        ev_load_use,
+        num_events
+    };
+
+
+    explicit hpm_unit(csr_file &c) : csrs(c) {}
+
+
+    // Recompute which counters count which events.
+    void rebuild();
+
+
+    // Does any counter need events?
+    bool is_active() const { return active; }
+
+
+    // Pipeline history carried from one instruction to the next,
+    // saved and restored with hart snapshots.
+    uint32_t get_history() const      { return last_load; }
+    void set_history(uint32_t h)      { last_load = h; }
+
+
+    void on_insn(uint32_t pc, uint32_t insn) override;
+    void on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+    void on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+    void on_branch(uint32_t pc, uint32_t target, bool taken, bool conditional) override;
+
+
+private:
+    void count(event e)
+    {
+        if (masks[e])
+            csrs.count_hpm(masks[e]);
+    }
+
+
+    csr_file &csrs;
+    uint32_t masks[num_events] = {0};
+    bool active = false;
+    uint32_t last_load = 0;
+    bool indirect = false;
+};
+
+
+#endif
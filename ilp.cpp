@@ -0,0 +1,330 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'ilp_profiler' class. The observer hooks give the
+    instruction word before it executes (its register sources), the address
+    of any load or store, and the register written afterwards; an
+    instruction is scheduled in on_insn and adjusted by those later hooks,
+    and retires into the windowed schedules when the next instruction
+    arrives (or at report time).
+********************************************************************************************/
+
+
+#include "ilp.h"
+
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+
+#include "rv32i_decode.h"
+
+
+/***************************************************************
+Function: ilp_profiler::ilp_profiler
+
+
+Use:      Sets up the unlimited model and one model per window.
+
+
+Arguments:
+    windows - Window sizes in instructions (0s are ignored).
+***************************************************************/
+ilp_profiler::ilp_profiler(const std::vector<uint32_t> &windows)
+{
+    std::vector<uint32_t> sizes { 0 };
+    for (uint32_t w : windows)
+    {
+        if (w && std::find(sizes.begin(), sizes.end(), w) == sizes.end())
+            sizes.push_back(w);
+    }
+    std::sort(sizes.begin() + 1, sizes.end());
+
+
+    models.resize(sizes.size());
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        model &m = models[i];
+        m.window = sizes[i];
+        m.mem_word.assign(size_t(1) << mem_shadow_bits, 0);
+        m.mem_ready.assign(size_t(1) << mem_shadow_bits, 0);
+        m.retire.assign(m.window, 0);
+    }
+}
+
+
+/***************************************************************
+Function: ilp_profiler::shadow_slot
+
+
+Use:      Hashes a word address to its memory shadow slot.
+
+
+Arguments:
+    word - Byte address / 4.
+
+
+Returns:
+    Slot index.
+***************************************************************/
+uint32_t ilp_profiler::shadow_slot(uint32_t word)
+{
+    return (word * 0x9e3779b1u) >> (32 - mem_shadow_bits);
+}
+
+
+/***************************************************************
+Function: ilp_profiler::mem_read
+
+
+Use:      Delays the current instruction of a model until the
+          memory words it loads have been stored.
+
+
+Arguments:
+    m    - The model.
+    addr - Load address.
+    len  - Load size in bytes.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void ilp_profiler::mem_read(model &m, uint32_t addr, uint32_t len)
+{
+    for (uint32_t w = addr >> 2; w <= (addr + len - 1) >> 2; ++w)
+    {
+        uint32_t s = shadow_slot(w);
+        if (m.mem_ready[s] && m.mem_word[s] == w)
+            m.start = std::max(m.start, m.mem_ready[s]);
+    }
+}
+
+
+/***************************************************************
+Function: ilp_profiler::mem_write
+
+
+Use:      Records that the memory words a store writes are ready
+          when the current instruction of a model completes.
+
+
+Arguments:
+    m    - The model.
+    addr - Store address.
+    len  - Store size in bytes.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void ilp_profiler::mem_write(model &m, uint32_t addr, uint32_t len)
+{
+    for (uint32_t w = addr >> 2; w <= (addr + len - 1) >> 2; ++w)
+    {
+        uint32_t s = shadow_slot(w);
+        if (m.mem_ready[s] && m.mem_word[s] != w)
+            ++m.evictions;
+        m.mem_word[s]  = w;
+        m.mem_ready[s] = m.start + 1;
+    }
+}
+
+
+/***************************************************************
+Function: ilp_profiler::retire_pending
+
+
+Use:      Completes the pending instruction in every model: it
+          finishes one cycle after it starts and retires, in
+          order, no earlier than the instruction before it.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void ilp_profiler::retire_pending()
+{
+    if (!pending)
+        return;
+    pending = false;
+
+
+    for (model &m : models)
+    {
+        uint64_t done = m.start + 1;
+        m.length = std::max(m.length, done);
+        if (m.window)
+        {
+            m.last_retire = std::max(m.last_retire, done);
+            m.retire[(insns - 1) % m.window] = m.last_retire;
+        }
+    }
+}
+
+
+/***************************************************************
+Function: ilp_profiler::on_insn
+
+
+Use:      Schedules an instruction after the registers it reads
+          and, in a finite window, after the instruction a window
+          earlier has retired.
+
+
+Arguments:
+    pc   - Unused.
+    insn - Instruction word.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void ilp_profiler::on_insn(uint32_t pc, uint32_t insn)
+{
+    (void)pc;
+    retire_pending();
+
+
+    bool r1 = rv32i_decode::reads_rs1(insn);
+    bool r2 = rv32i_decode::reads_rs2(insn);
+    uint32_t rs1 = rv32i_decode::get_rs1(insn);
+    uint32_t rs2 = rv32i_decode::get_rs2(insn);
+
+
+    for (model &m : models)
+    {
+        m.start = 0;
+        if (r1)
+            m.start = m.reg_ready[rs1];
+        if (r2)
+            m.start = std::max(m.start, m.reg_ready[rs2]);
+        if (m.window)
+            m.start = std::max(m.start, m.retire[insns % m.window]);
+    }
+
+
+    ++insns;
+    pending = true;
+}
+
+
+/***************************************************************
+Function: ilp_profiler::on_reg_write
+
+
+Use:      Marks the destination register ready when the current
+          instruction completes.
+
+
+Arguments:
+    r   - Register written.
+    val - Unused.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void ilp_profiler::on_reg_write(uint32_t r, uint32_t val)
+{
+    (void)val;
+    for (model &m : models)
+        m.reg_ready[r] = m.start + 1;
+}
+
+
+/***************************************************************
+Function: ilp_profiler::on_load
+
+
+Use:      Adds the load's memory dependency.
+
+
+Arguments:
+    pc, val - Unused.
+    addr    - Load address.
+    len     - Load size in bytes.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void ilp_profiler::on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)pc; (void)val;
+    for (model &m : models)
+        mem_read(m, addr, len);
+}
+
+
+/***************************************************************
+Function: ilp_profiler::on_store
+
+
+Use:      Records the words the store produces.
+
+
+Arguments:
+    pc, val - Unused.
+    addr    - Store address.
+    len     - Store size in bytes.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void ilp_profiler::on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)pc; (void)val;
+    for (model &m : models)
+        mem_write(m, addr, len);
+}
+
+
+/***************************************************************
+Function: ilp_profiler::report
+
+
+Use:      Prints the instruction count and, per window size, the
+          schedule length and the ILP it gives.
+
+
+Arguments:
+    os - Output stream.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void ilp_profiler::report(std::ostream &os)
+{
+    retire_pending();
+
+
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << "ILP profile: " << insns << " instructions (unit latency, perfect branch prediction)" << std::endl;
+    os << "  " << std::left << std::setw(12) << "window"
+       << std::right << std::setw(14) << "cycles" << std::setw(10) << "ILP" << std::endl;
+    for (const model &m : models)
+    {
+        double ilp = m.length ? double(insns) / double(m.length) : 0.0;
+        os << "  " << std::left << std::setw(12) << (m.window ? std::to_string(m.window) : "unlimited")
+           << std::right << std::setw(14) << m.length
+           << std::setw(10) << std::fixed << std::setprecision(2) << ilp << std::endl;
+    }
+    os << "  critical path: " << models[0].length << " cycles";
+    if (models[0].evictions)
+        os << " (" << models[0].evictions << " memory shadow evictions; may be short)";
+    os << std::endl;
+    os.flags(flags);
+    os.precision(precision);
+}
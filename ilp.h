@@ -0,0 +1,108 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'ilp_profiler' class, which measures how much instruction-
+    level parallelism a run exposes. Each instruction is scheduled as early
+    as its data dependencies allow: it may start once the registers it reads
+    and (for a load) the memory word it reads have been produced, and takes
+    one cycle. Branches are assumed perfectly predicted and there are no
+    false (WAR/WAW) dependencies, so the length of the resulting schedule is
+    the dataflow critical path, and instructions / critical path is the
+    ideal ILP.
+
+    The same schedule is also computed for machines with a finite
+    instruction window of W instructions, where an instruction cannot start
+    before the one W places earlier in program order has retired (retiring
+    in order), which shows how much of the ideal ILP a realistic window can
+    reach.
+********************************************************************************************/
+
+
+#ifndef ILP_H
+#define ILP_H
+
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+
+#include "rv32i_observer.h"
+
+
+/***************************************************************
+Class: ilp_profiler
+
+
+Use:   Observer that computes the dataflow schedule of the
+       instructions it sees, once with an unlimited window and
+       once per window size given. report() prints the result.
+
+       Register ready times are kept in a 32-entry array. Memory
+       ready times are kept per 32-bit word in a direct-mapped
+       hash table; a word evicted from it by a collision is
+       treated as ready at time 0, which can only shorten the
+       critical path, and the number of evictions is reported.
+
+
+Data:
+       models   - One schedule per window size (the first is
+                  unlimited).
+       insns    - Instructions seen.
+       pending  - An instruction has been seen but not yet
+                  retired into the schedule.
+***************************************************************/
+class ilp_profiler : public rv32i_observer
+{
+public:
+    // Window sizes (in instructions) to model besides the
+    // unlimited one.
+    explicit ilp_profiler(const std::vector<uint32_t> &windows);
+
+
+    void on_insn(uint32_t pc, uint32_t insn) override;
+    void on_reg_write(uint32_t r, uint32_t val) override;
+    void on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+    void on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+
+
+    // Print instruction count, critical path and ILP per window.
+    void report(std::ostream &os);
+
+
+private:
+    static constexpr uint32_t mem_shadow_bits = 16;
+
+
+    struct model
+    {
+        uint32_t window = 0;                // 0 = unlimited
+        uint64_t reg_ready[32] = {0};
+        std::vector<uint32_t> mem_word;     // shadow tags (word address)
+        std::vector<uint64_t> mem_ready;    // 0 = empty slot
+        std::vector<uint64_t> retire;       // ring: retire time of the last window insns
+        uint64_t last_retire = 0;
+        uint64_t start  = 0;                // current instruction's start time
+        uint64_t length = 0;                // latest completion so far
+        uint64_t evictions = 0;
+    };
+
+
+    void retire_pending();
+
+
+    static uint32_t shadow_slot(uint32_t word);
+    static void     mem_read(model &m, uint32_t addr, uint32_t len);
+    static void     mem_write(model &m, uint32_t addr, uint32_t len);
+
+
+    std::vector<model> models;
+    uint64_t insns = 0;
+    bool pending = false;
+};
+
+
+#endif
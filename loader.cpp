@@ -0,0 +1,537 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'loader' class. Each image is mapped and decoded into a list
+    of segments on its own thread; the segments of all images are then
+    checked against each other and against the memory size, and copied into
+    memory with one block write per segment.
+********************************************************************************************/
+
+
+#include "loader.h"
+
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <thread>
+
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+#include "hex.h"
+
+
+using std::cerr;
+using std::endl;
+using std::string;
+
+
+/***************************************************************
+Function: ends_with
+
+
+Use:      Case-insensitive file name suffix test.
+
+
+Arguments:
+    s      - File name.
+    suffix - Lower-case suffix, including the dot.
+
+
+Returns:
+    true if s ends with suffix.
+***************************************************************/
+static bool ends_with(const string &s, const string &suffix)
+{
+    if (s.size() < suffix.size())
+        return false;
+    for (size_t i = 0; i < suffix.size(); ++i)
+    {
+        char c = s[s.size() - suffix.size() + i];
+        if (std::tolower(static_cast<unsigned char>(c)) != suffix[i])
+            return false;
+    }
+    return true;
+}
+
+
+/***************************************************************
+Class: mapped_file
+
+
+Use:   Read-only view of a whole file: an mmap of it where that
+       works, else (e.g. for a pipe) a copy read into memory.
+***************************************************************/
+class mapped_file
+{
+public:
+    ~mapped_file()
+    {
+        if (map)
+            munmap(map, len);
+    }
+
+
+    bool open(const string &fname)
+    {
+        int fd = ::open(fname.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void *m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m != MAP_FAILED)
+            {
+                map = m;
+                len = static_cast<size_t>(st.st_size);
+                ptr = static_cast<const uint8_t *>(m);
+                madvise(m, len, MADV_SEQUENTIAL);
+                ::close(fd);
+                return true;
+            }
+        }
+
+
+        uint8_t chunk[65536];
+        ssize_t got;
+        while ((got = ::read(fd, chunk, sizeof(chunk))) > 0)
+            copy.insert(copy.end(), chunk, chunk + got);
+        ::close(fd);
+        ptr = copy.data();
+        len = copy.size();
+        return got == 0;
+    }
+
+
+    const uint8_t *data() const { return ptr; }
+    size_t size() const         { return len; }
+
+
+private:
+    void *map = nullptr;
+    const uint8_t *ptr = nullptr;
+    size_t len = 0;
+    std::vector<uint8_t> copy;
+};
+
+
+/***************************************************************
+Function: get_le16 / get_le32
+
+
+Use:      Read little-endian fields of an ELF file.
+
+
+Arguments:
+    p - Field address.
+
+
+Returns:
+    The field value.
+***************************************************************/
+static uint32_t get_le16(const uint8_t *p)
+{
+    return p[0] | (uint32_t(p[1]) << 8);
+}
+
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+
+/***************************************************************
+Function: loader::add
+
+
+Use:      Adds an image spec: "file" or "file@addr", addr in hex.
+          A spec whose text after the last '@' is not a hex
+          number is all file name, so names holding '@' work.
+
+
+Arguments:
+    spec - The spec.
+
+
+Returns:
+    false (after printing why) if the spec is malformed.
+***************************************************************/
+bool loader::add(const string &spec)
+{
+    image img;
+    img.file = spec;
+
+
+    size_t at = spec.rfind('@');
+    if (at != string::npos)
+    {
+        string addr = spec.substr(at + 1);
+        size_t used = 0;
+        unsigned long v = 0;
+        try
+        {
+            v = std::stoul(addr, &used, 16);
+        }
+        catch (...)
+        {
+            used = 0;
+        }
+        if (!addr.empty() && std::isxdigit(static_cast<unsigned char>(addr[0]))
+            && used == addr.size() && v <= 0xffffffffUL)
+        {
+            img.file  = spec.substr(0, at);
+            img.based = true;
+            img.base  = static_cast<uint32_t>(v);
+        }
+    }
+    if (img.file.empty())
+    {
+        cerr << "No file name in '" << spec << "'" << endl;
+        return false;
+    }
+
+
+    if (ends_with(img.file, ".hex") || ends_with(img.file, ".ihex") || ends_with(img.file, ".ihx"))
+        img.fmt = format::ihex;
+    else if (ends_with(img.file, ".mem") || ends_with(img.file, ".memh") || ends_with(img.file, ".vmem"))
+        img.fmt = format::memh;
+    else if (ends_with(img.file, ".elf"))
+        img.fmt = format::elf;
+    else
+        img.fmt = format::raw;    // read_image() still spots ELF files by their header
+
+
+    images.push_back(img);
+    return true;
+}
+
+
+/***************************************************************
+Function: loader::add_raw
+
+
+Use:      Adds a file as a raw image, without looking at its name
+          or contents.
+
+
+Arguments:
+    file - File name.
+    addr - Load address.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void loader::add_raw(const string &file, uint32_t addr)
+{
+    image img;
+    img.file  = file;
+    img.based = true;
+    img.base  = addr;
+    img.sniff = false;
+    images.push_back(img);
+}
+
+
+/***************************************************************
+Function: loader::read_image
+
+
+Use:      Reads one image file and decodes it into segments. Runs
+          on a worker thread, so errors are left in img.error
+          rather than printed.
+
+
+Arguments:
+    img      - The image; segs, entry and error are filled in.
+    mem_size - Size of the memory it will be loaded into.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void loader::read_image(image &img, uint32_t mem_size)
+{
+    mapped_file f;
+    if (!f.open(img.file))
+    {
+        img.error = "Can't open file '" + img.file + "' for reading.";
+        return;
+    }
+
+
+    const uint8_t *buf = f.data();
+    size_t size = f.size();
+    if (img.fmt == format::raw && img.sniff && size >= 4
+        && buf[0] == 0x7f && buf[1] == 'E' && buf[2] == 'L' && buf[3] == 'F')
+        img.fmt = format::elf;
+
+
+    if ((img.fmt == format::elf || img.fmt == format::ihex) && img.based)
+    {
+        img.error = "'" + img.file + "' carries its own load addresses; drop the @addr.";
+        return;
+    }
+
+
+    const char *text = reinterpret_cast<const char *>(buf);
+    string err;
+    switch (img.fmt)
+    {
+    case format::elf:
+        parse_elf(img, buf, size, mem_size);
+        break;
+
+
+    case format::ihex:
+        if (!hex_image::parse_ihex(text, size, img.segs, img.has_entry, img.entry, err))
+            img.error = "'" + img.file + "' " + err;
+        break;
+
+
+    case format::memh:
+        if (!hex_image::parse_readmemh(text, size, img.base, img.segs, err))
+            img.error = "'" + img.file + "' " + err;
+        break;
+
+
+    case format::raw:
+        if (size)
+            img.segs.push_back({ img.base, std::vector<uint8_t>(buf, buf + size) });
+        break;
+    }
+}
+
+
+/***************************************************************
+Function: loader::parse_elf
+
+
+Use:      Decodes a little-endian ELF32 RISC-V executable. Each
+          PT_LOAD segment is loaded at its physical address, with
+          the part past p_filesz zero-filled (.bss). A segment
+          that doesn't fit in memory is rejected here, before the
+          .bss is allocated, so a bogus p_memsz can't exhaust the
+          host's memory.
+
+
+Arguments:
+    img      - The image.
+    p, size  - File contents.
+    mem_size - Size of the memory the image will be loaded into.
+
+
+Returns:
+    false (with img.error set) if the file is not a usable ELF.
+***************************************************************/
+bool loader::parse_elf(image &img, const uint8_t *p, size_t size, uint32_t mem_size)
+{
+
+    if (size < 52 || p[4] != 1 || p[5] != 1)
+    {
+        img.error = "'" + img.file + "' is not a little-endian ELF32 file.";
+        return false;
+    }
+    if (get_le16(p + 18) != 243)
+    {
+        img.error = "'" + img.file + "' is not a RISC-V ELF file.";
+        return false;
+    }
+
+
+    uint32_t phoff     = get_le32(p + 28);
+    uint32_t phentsize = get_le16(p + 42);
+    uint32_t phnum     = get_le16(p + 44);
+    if (phentsize < 32 || uint64_t(phoff) + uint64_t(phentsize) * phnum > size)
+    {
+        img.error = "'" + img.file + "' has a bad program header table.";
+        return false;
+    }
+
+
+    for (uint32_t i = 0; i < phnum; ++i)
+    {
+        const uint8_t *ph = p + phoff + i * phentsize;
+        uint32_t type   = get_le32(ph);
+        uint32_t offset = get_le32(ph + 4);
+        uint32_t paddr  = get_le32(ph + 12);
+        uint32_t filesz = get_le32(ph + 16);
+        uint32_t memsz  = get_le32(ph + 20);
+
+
+        if (type != 1 || memsz == 0)         // PT_LOAD only
+            continue;
+        if (filesz > memsz || uint64_t(offset) + filesz > size)
+        {
+            img.error = "'" + img.file + "' has a bad PT_LOAD segment.";
+            return false;
+        }
+        if (uint64_t(paddr) + memsz > mem_size)
+        {
+            img.error = "'" + img.file + "' (" + hex::to_hex0x32(paddr) + "-"
+                        + hex::to_hex0x32(static_cast<uint32_t>(uint64_t(paddr) + memsz - 1))
+                        + ") does not fit in memory of size " + hex::to_hex0x32(mem_size);
+            return false;
+        }
+
+
+        segment s;
+        s.addr = paddr;
+        s.data.assign(p + offset, p + offset + filesz);
+        s.data.resize(memsz, 0);
+        img.segs.push_back(std::move(s));
+    }
+
+
+    img.has_entry = true;
+    img.entry     = get_le32(p + 24);
+    return true;
+}
+
+
+/***************************************************************
+Function: loader::load
+
+
+Use:      Reads every image (in parallel when there are several),
+          checks that no two segments overlap and that all fit
+          in memory, then copies them in and picks the entry
+          point.
+
+
+Arguments:
+    mem - Memory to load into.
+
+
+Returns:
+    false (after printing why) if any image can't be loaded;
+    memory is then left as it was.
+***************************************************************/
+bool loader::load(memory &mem)
+{
+    if (images.size() == 1)
+        read_image(images[0], mem.get_size());
+    else
+    {
+        std::vector<std::thread> workers;
+        for (image &img : images)
+            workers.emplace_back(read_image, std::ref(img), mem.get_size());
+        for (std::thread &t : workers)
+            t.join();
+    }
+
+
+    bool ok = true;
+    for (const image &img : images)
+    {
+        if (!img.error.empty())
+        {
+            cerr << img.error << endl;
+            ok = false;
+        }
+    }
+    if (!ok)
+        return false;
+
+
+    // Every segment, by address: (start, end, image).
+    struct extent { uint64_t start, end; const image *img; };
+    std::vector<extent> all;
+    for (const image &img : images)
+    {
+        for (const segment &s : img.segs)
+        {
+            if (s.data.empty())
+                continue;
+            extent e { s.addr, uint64_t(s.addr) + s.data.size(), &img };
+            if (e.end > mem.get_size())
+            {
+                cerr << "'" << img.file << "' (" << hex::to_hex0x32(s.addr) << "-"
+                     << hex::to_hex0x32(static_cast<uint32_t>(e.end - 1))
+                     << ") does not fit in memory of size " << hex::to_hex0x32(mem.get_size()) << endl;
+                ok = false;
+            }
+            all.push_back(e);
+        }
+    }
+    std::sort(all.begin(), all.end(),
+              [](const extent &a, const extent &b) { return a.start < b.start; });
+    for (size_t i = 1; i < all.size(); ++i)
+    {
+        if (all[i].start < all[i - 1].end)
+        {
+            cerr << "'" << all[i - 1].img->file << "' ("
+                 << hex::to_hex0x32(static_cast<uint32_t>(all[i - 1].start)) << "-"
+                 << hex::to_hex0x32(static_cast<uint32_t>(all[i - 1].end - 1)) << ") overlaps '"
+                 << all[i].img->file << "' ("
+                 << hex::to_hex0x32(static_cast<uint32_t>(all[i].start)) << "-"
+                 << hex::to_hex0x32(static_cast<uint32_t>(all[i].end - 1)) << ")" << endl;
+            ok = false;
+        }
+    }
+    if (!ok)
+        return false;
+
+
+    for (image &img : images)
+    {
+        for (segment &s : img.segs)
+        {
+            mem.load_image(s.addr, s.data);
+            std::vector<uint8_t>().swap(s.data);
+        }
+    }
+
+
+    entry = images.front().base;
+    if (!images.front().based && !images.front().segs.empty())
+        entry = images.front().segs.front().addr;
+    for (const image &img : images)
+    {
+        if (img.has_entry)
+        {
+            entry = img.entry;
+            break;
+        }
+    }
+    return true;
+}
+
+
+/***************************************************************
+Function: loader::get_elf_files
+
+
+Use:      Lists the images that load() read as ELF files, e.g. to
+          find their debug information.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Their file names.
+***************************************************************/
+std::vector<string> loader::get_elf_files() const
+{
+    std::vector<string> files;
+    for (const image &img : images)
+    {
+        if (img.fmt == format::elf)
+            files.push_back(img.file);
+    }
+    return files;
+}
@@ -0,0 +1,106 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'loader' class, which puts a whole system image into memory
+    from several files: e.g. a bootloader, an application and data blobs,
+    each at its own base address. Every file is a raw binary, an ELF32
+    executable, an Intel HEX file or a Verilog $readmemh image. The files
+    are mapped, decoded in parallel, checked for overlaps and for fitting
+    in memory, and only then copied in, so a bad manifest leaves memory
+    untouched.
+********************************************************************************************/
+
+
+#ifndef LOADER_H
+#define LOADER_H
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+#include "hex_image.h"
+#include "memory.h"
+
+
+/***************************************************************
+Class: loader
+
+
+Use:   Collects image specs with add(), then loads them all with
+       load(). A spec is "file" or "file@addr" (hex). Raw images
+       load at addr, and $readmemh word 0 goes to addr (default
+       0); ELF and Intel HEX images carry their own addresses.
+
+       The entry point is the first entry address carried by an
+       image (ELF e_entry, Intel HEX start address record), in
+       the order the images were added, else the base of the
+       first image.
+
+
+Data:
+       images    - The images added, in order.
+       entry     - Entry point found by load().
+***************************************************************/
+class loader
+{
+public:
+    enum class format { raw, elf, ihex, memh };
+
+
+    // Add an image spec ("file[@addr]"); the format comes from the
+    // file name (.hex, .ihex, .ihx; .mem, .memh, .vmem) or its ELF
+    // header.
+    bool add(const std::string &spec);
+
+
+    // Add a file as a raw image at addr, whatever its name.
+    void add_raw(const std::string &file, uint32_t addr);
+
+
+    bool empty() const { return images.empty(); }
+
+
+    // Read, check and copy every image into mem.
+    bool load(memory &mem);
+
+
+    uint32_t get_entry() const { return entry; }
+
+
+    // The files load() found to be ELF images, in the order added.
+    std::vector<std::string> get_elf_files() const;
+
+
+private:
+    using segment = hex_image::segment;
+
+
+    struct image
+    {
+        std::string file;
+        format fmt     = format::raw;
+        bool   sniff   = true;         // raw: check for an ELF header
+        bool   based   = false;        // @addr given
+        uint32_t base  = 0;
+        std::vector<segment> segs;
+        bool   has_entry = false;
+        uint32_t entry   = 0;
+        std::string error;             // set by read_image on failure
+    };
+
+
+    static void read_image(image &img, uint32_t mem_size);
+    static bool parse_elf(image &img, const uint8_t *p, size_t size, uint32_t mem_size);
+
+
+    std::vector<image> images;
+    uint32_t entry = 0;
+};
+
+
+#endif
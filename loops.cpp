@@ -0,0 +1,385 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'loop_profiler' class. Loops are found in on_branch, from
+    their back edges; trips are counted in on_insn, at the header, and
+    leaving a loop is noticed there too, when the next instruction lies
+    outside the body.
+********************************************************************************************/
+
+
+#include "loops.h"
+
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+
+#include "hex.h"
+#include "rv32i_decode.h"
+
+
+/***************************************************************
+Function: loop_profiler::enter
+
+
+Use:      Starts an activation of a loop.
+
+
+Arguments:
+    header - Loop header address.
+    info   - The loop.
+    entry  - Instruction count when the header was reached.
+    trips  - Header executions so far in this activation.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void loop_profiler::enter(uint32_t header, loop_info &info, uint64_t entry, uint64_t trips)
+{
+    stack.push_back({ header, &info, depth, entry, entry, trips });
+    ++info.entries;
+}
+
+
+/***************************************************************
+Function: loop_profiler::leave
+
+
+Use:      Ends the innermost activation and adds it to its loop's
+          counters. A loop that is also active further down the
+          stack (through recursion) adds its time only once, when
+          the outermost activation ends.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void loop_profiler::leave()
+{
+    activation a = stack.back();
+    stack.pop_back();
+
+
+    loop_info &info = *a.info;
+    info.trips += a.trips;
+    info.max_trip = std::max(info.max_trip, a.trips);
+    if (a.trips)
+        info.hist[std::min<uint32_t>(63 - __builtin_clzll(a.trips), hist_buckets - 1)]++;
+
+
+    bool nested = std::any_of(stack.begin(), stack.end(),
+                              [&](const activation &o) { return o.header == a.header; });
+    if (!nested)
+        info.insns += insns - a.entry;
+}
+
+
+/***************************************************************
+Function: loop_profiler::is_ancestor
+
+
+Use:      Tells whether a loop encloses another, following parent
+          links. The walk is bounded, so a cycle can't hang it.
+
+
+Arguments:
+    header - Header of the possible ancestor.
+    of     - Header of the loop to start from.
+
+
+Returns:
+    true if header is of or one of its ancestors.
+***************************************************************/
+bool loop_profiler::is_ancestor(uint32_t header, uint32_t of) const
+{
+    for (size_t n = 0; n <= loops.size(); ++n)
+    {
+        if (of == header)
+            return true;
+        auto it = loops.find(of);
+        if (it == loops.end() || !it->second.has_parent)
+            return false;
+        of = it->second.parent;
+    }
+    return false;
+}
+
+
+/***************************************************************
+Function: loop_profiler::adopt
+
+
+Use:      Makes a newly found loop the parent of the known loops
+          whose header lies in its body and whose parent, if
+          any, lies outside it. Those were found first, because
+          an inner loop's back edge is taken before its outer
+          loop's, and so were given the outer loop's parent.
+
+
+Arguments:
+    header - Header of the new loop.
+    end    - Its latch.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void loop_profiler::adopt(uint32_t header, uint32_t end)
+{
+    for (auto &e : loops)
+    {
+        loop_info &l = e.second;
+        if (e.first <= header || e.first > end)
+            continue;
+        if (l.has_parent && l.parent >= header && l.parent <= end)
+            continue;
+        if (is_ancestor(e.first, header))
+            continue;
+        l.has_parent = true;
+        l.parent     = header;
+    }
+}
+
+
+/***************************************************************
+Function: loop_profiler::nest
+
+
+Use:      Nesting depth of a loop: 1 for a loop without a parent.
+
+
+Arguments:
+    header - Loop header.
+
+
+Returns:
+    The depth.
+***************************************************************/
+uint32_t loop_profiler::nest(uint32_t header) const
+{
+    uint32_t n = 1;
+    for (auto it = loops.find(header); it != loops.end() && it->second.has_parent
+         && n <= loops.size(); it = loops.find(it->second.parent))
+        ++n;
+    return n;
+}
+
+
+/***************************************************************
+Function: loop_profiler::on_insn
+
+
+Use:      Ends the activations the instruction lies outside of,
+          counts a trip if it is the header of the innermost one
+          or starts one if it is the header of another known
+          loop, and follows calls and returns.
+
+
+Arguments:
+    pc   - Instruction address.
+    insn - Instruction word.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void loop_profiler::on_insn(uint32_t pc, uint32_t insn)
+{
+    while (!stack.empty())
+    {
+        const activation &a = stack.back();
+        if (a.call_depth > depth
+            || (a.call_depth == depth && (pc < a.header || pc > a.info->end)))
+            leave();
+        else
+            break;
+    }
+
+
+    if (!stack.empty() && stack.back().header == pc && stack.back().call_depth == depth)
+    {
+        ++stack.back().trips;
+        stack.back().iter_start = insns;
+    }
+    else
+    {
+        auto it = loops.find(pc);
+        if (it != loops.end())
+            enter(pc, it->second, insns, 1);
+    }
+
+
+    seen[(pc >> 2) & ((1u << seen_bits) - 1)] = { pc, insns };
+    ++insns;
+
+
+    uint32_t opcode = rv32i_decode::get_opcode(insn);
+    uint32_t rd     = rv32i_decode::get_rd(insn);
+    uint32_t rs1    = rv32i_decode::get_rs1(insn);
+    loop_jump = opcode == rv32i_decode::opcode_jal && rd == 0;
+    if ((opcode == rv32i_decode::opcode_jal || opcode == rv32i_decode::opcode_jalr) && rd != 0)
+        ++depth;
+    else if (opcode == rv32i_decode::opcode_jalr && (rs1 == 1 || rs1 == 5))
+        --depth;
+}
+
+
+/***************************************************************
+Function: loop_profiler::on_branch
+
+
+Use:      Finds a loop the first time its back edge is taken, and
+          starts an activation of a known loop entered through its
+          back edge. Trips are counted at the header, in on_insn.
+
+
+Arguments:
+    pc          - Branch address.
+    target      - Branch target.
+    taken       - The branch was taken.
+    conditional - A conditional branch (else a jump).
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void loop_profiler::on_branch(uint32_t pc, uint32_t target, bool taken, bool conditional)
+{
+    if (!taken || target > pc || !(conditional || loop_jump))
+        return;
+
+
+    // Inner loops the back edge jumps out of.
+    while (!stack.empty() && stack.back().call_depth == depth && stack.back().header > target)
+        leave();
+
+
+    for (auto a = stack.rbegin(); a != stack.rend() && a->call_depth == depth; ++a)
+    {
+        if (a->header == target)
+        {
+            a->info->end = std::max(a->info->end, pc);
+            return;
+        }
+    }
+
+
+    auto ins = loops.emplace(target, loop_info());
+    loop_info &info = ins.first->second;
+    info.end = std::max(info.end, pc);
+    if (!ins.second)
+    {
+        // Known loop entered mid-body; the header runs next.
+        enter(target, info, insns, 0);
+        return;
+    }
+
+
+    if (!stack.empty())
+    {
+        info.has_parent = true;
+        info.parent     = stack.back().header;
+    }
+    adopt(target, pc);
+
+
+    // Did the header already run in this activation?
+    const seen_pc &s = seen[(target >> 2) & ((1u << seen_bits) - 1)];
+    uint64_t since = stack.empty() ? 0 : stack.back().iter_start;
+    if (s.pc == target && s.time >= since)
+        enter(target, info, s.time, 1);
+    else
+        enter(target, info, insns, 0);
+}
+
+
+/***************************************************************
+Function: loop_profiler::report
+
+
+Use:      Prints the loops with the most inclusive instructions,
+          with their nesting, trip counts and trip count
+          histogram.
+
+
+Arguments:
+    os  - Output stream.
+    top - Most loops to list.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void loop_profiler::report(std::ostream &os, uint32_t top)
+{
+    while (!stack.empty())
+        leave();
+
+
+    std::vector<std::pair<uint32_t, const loop_info *>> rows;
+    for (const auto &e : loops)
+        rows.emplace_back(e.first, &e.second);
+    std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b)
+    {
+        if (a.second->insns != b.second->insns)
+            return a.second->insns > b.second->insns;
+        return a.first < b.first;
+    });
+
+
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+
+
+    os << "Loop profile: " << insns << " instructions, " << loops.size() << " loops" << std::endl;
+    if (!rows.empty())
+        os << "  " << std::left << std::setw(12) << "header" << std::setw(12) << "latch"
+           << std::setw(6) << "nest" << std::setw(12) << "parent" << std::right
+           << std::setw(14) << "insns" << std::setw(8) << "%" << std::setw(10) << "entries"
+           << std::setw(10) << "avg trip" << std::setw(10) << "max trip" << std::endl;
+
+
+    for (size_t i = 0; i < rows.size() && i < top; ++i)
+    {
+        const loop_info &l = *rows[i].second;
+        os << "  " << std::left << std::setw(12) << hex::to_hex0x32(rows[i].first)
+           << std::setw(12) << hex::to_hex0x32(l.end) << std::setw(6) << nest(rows[i].first)
+           << std::setw(12) << (l.has_parent ? hex::to_hex0x32(l.parent) : std::string("-"))
+           << std::right << std::setw(14) << l.insns
+           << std::setw(8) << (insns ? 100.0 * l.insns / insns : 0.0)
+           << std::setw(10) << l.entries
+           << std::setw(10) << (l.entries ? double(l.trips) / l.entries : 0.0)
+           << std::setw(10) << l.max_trip << std::endl;
+
+
+        os << "    trips:";
+        for (uint32_t b = 0; b < hist_buckets; ++b)
+        {
+            if (!l.hist[b])
+                continue;
+            uint64_t lo = uint64_t(1) << b;
+            os << " " << lo;
+            if (b == hist_buckets - 1)
+                os << "+";
+            else if (lo > 1)
+                os << "-" << (lo * 2 - 1);
+            os << ":" << l.hist[b];
+        }
+        os << std::endl;
+    }
+
+
+    os.flags(flags);
+    os.precision(precision);
+}
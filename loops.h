@@ -0,0 +1,130 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'loop_profiler' class, which finds a program's loops while it
+    runs and profiles them: how often each loop is entered, its trip counts,
+    the instructions executed inside it (including inner loops and calls)
+    and how loops nest. The report lists loops by inclusive instruction
+    count, so the loops worth hand-optimising or vectorising come first.
+********************************************************************************************/
+
+
+#ifndef LOOPS_H
+#define LOOPS_H
+
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+
+#include "rv32i_observer.h"
+
+
+/***************************************************************
+Class: loop_profiler
+
+
+Use:   Observer that treats every taken backward conditional
+       branch, and every backward jal that does not link, as the
+       latch of a natural loop whose header is the branch target.
+       A loop's body is taken to be header..highest latch seen.
+
+       Loops being executed are kept on a stack. An activation
+       starts when control reaches the header, or takes the back
+       edge of a loop entered in the middle (a rotated loop); the
+       first time a loop is seen it starts at the header's most
+       recent execution, if that was in the enclosing loop's
+       current iteration. It ends when control leaves the body at
+       the same call depth, so calls made from a loop count
+       towards it. Calls and returns are recognised by the usual
+       link registers (a jal or jalr that links is a call; jalr
+       x0 through ra or t0 is a return).
+
+       A loop's parent is the loop it ran inside when it was
+       found. An inner loop's back edge is taken before the
+       outer loop's, so a newly found loop adopts the known
+       loops whose header lies in its body, unless they already
+       have a parent inside it. Nesting depth follows from the
+       parent chain when the report is printed.
+
+       Trip counts are the number of times the header is reached
+       in an activation, kept in a log2 histogram.
+
+
+Data:
+       loops    - Per header: body end, parent, counters.
+       stack    - Loop activations in progress, innermost last.
+       seen     - Direct-mapped table of recent (pc, time) pairs,
+                  to find when a newly found loop was entered.
+       depth    - Current call depth.
+       insns    - Instructions seen.
+***************************************************************/
+class loop_profiler : public rv32i_observer
+{
+public:
+    void on_insn(uint32_t pc, uint32_t insn) override;
+    void on_branch(uint32_t pc, uint32_t target, bool taken, bool conditional) override;
+
+
+    // Print up to top loops by inclusive instruction count.
+    void report(std::ostream &os, uint32_t top);
+
+
+private:
+    static constexpr uint32_t hist_buckets = 24;   // trip counts 1, 2-3, ..., 2^23+
+    static constexpr uint32_t seen_bits = 12;
+
+
+    struct loop_info
+    {
+        uint32_t end = 0;               // highest latch address
+        bool     has_parent = false;
+        uint32_t parent = 0;            // enclosing loop header
+        uint64_t entries = 0;
+        uint64_t trips   = 0;
+        uint64_t max_trip = 0;
+        uint64_t insns   = 0;           // inclusive
+        uint64_t hist[hist_buckets] = {0};
+    };
+
+
+    struct activation
+    {
+        uint32_t  header;
+        loop_info *info;
+        int64_t   call_depth;
+        uint64_t  entry;                // insns when entered
+        uint64_t  iter_start;           // insns at the latest header execution
+        uint64_t  trips;
+    };
+
+
+    struct seen_pc
+    {
+        uint32_t pc;
+        uint64_t time;
+    };
+
+
+    void enter(uint32_t header, loop_info &info, uint64_t entry, uint64_t trips);
+    void leave();
+    bool is_ancestor(uint32_t header, uint32_t of) const;
+    void adopt(uint32_t header, uint32_t end);
+    uint32_t nest(uint32_t header) const;
+
+
+    std::unordered_map<uint32_t, loop_info> loops;
+    std::vector<activation> stack;
+    std::vector<seen_pc> seen = std::vector<seen_pc>(size_t(1) << seen_bits, seen_pc { ~0u, 0 });
+    int64_t  depth = 0;
+    uint64_t insns = 0;
+    bool     loop_jump = false;         // current insn is a jal that does not link
+};
+
+
+#endif
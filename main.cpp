@@ -9,26 +9,75 @@ Purpose:
 
     This program:
       - Parses the command-line for:
-            [-d] [-i] [-r] [-z] [-l exec-limit] [-m hex-mem-size] infile
+            [-d] [-i] [-r] [-z] [-l exec-limit] [-m hex-mem-size]
+            [--dump full|sparse|diff|bin:file]
+            [--reg-trace full|delta[:n]] [--trace-range start:end]
+            [--trace-pc lo:hi]... [--trace-every n]
+            [--record file | --replay file] [--rewind n]
+            [--break addr[,hits=n][,if=cond]]... [--watch addr[,len][,r|w|rw]]...
+            [--gdb port|unix:path [--reverse]] [--load file[@addr]]...
+            [--env name=value]... [--ilp-profile[=w,...]] [--defuse-profile[=n]]
+            [--value-profile[=n]] [--mem-profile file [--mem-interval n]]
+            [--loop-profile[=n]] [--memcheck] [--stack-profile[=n]]
+            [--coverage file] infile [guest-args...]
       - Constructs a 'memory' object of the requested size and loads the
-        binary file into it.
+        binary file into it at address 0, along with any --load images
+        (raw, ELF or Intel HEX), and starts execution at their entry point.
+      - Passes any arguments after infile (and --env variables) to the
+        program on its initial stack.
       - Optionally disassembles the entire memory before simulation (-d).
       - Constructs a cpu_single_hart, configures its flags, and runs it
         with an optional instruction-count limit (-l).
+      - Optionally records the run's nondeterministic inputs to a log, or
+        replays them from one (--record / --replay).
+      - Optionally stops execution at breakpoints and watchpoints.
+      - Optionally serves a GDB remote debugging session instead of running
+        the program to completion (--gdb).
+      - Optionally journals the run so that the state at an earlier
+        instruction count can be reconstructed afterwards (--rewind).
+      - Optionally reports the run's dataflow critical path and ideal ILP
+        (--ilp-profile), or dead register writes and stores, distance to
+        first use and register pressure (--defuse-profile), or invariant
+        and stride-predictable load/ALU results (--value-profile), or
+        where loads and stores go (--mem-profile), or which loops the
+        time is spent in (--loop-profile).
+      - Optionally reports uses of uninitialised registers and memory
+        (--memcheck), or the stack and heap high-water marks
+        (--stack-profile).
+      - Optionally writes instruction, branch and source line coverage as
+        an lcov tracefile, using the line tables of the ELF images
+        (--coverage).
       - Optionally dumps the final hart state and memory (-z).
 ********************************************************************************************/
 
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <cstdlib>
+#include <memory>
 #include <sstream>
 #include <unistd.h>
+#include <getopt.h>
 
 
 #include "memory.h"
 #include "hex.h"
 #include "rv32i_decode.h"
 #include "cpu_single_hart.h"
+#include "replay_log.h"
+#include "timetravel.h"
+#include "breakpoints.h"
+#include "gdbstub.h"
+#include "loader.h"
+#include "ilp.h"
+#include "defuse.h"
+#include "valprof.h"
+#include "memprof.h"
+#include "loops.h"
+#include "memcheck.h"
+#include "stackprof.h"
+#include "coverage.h"
 
 
 using namespace std;
@@ -51,13 +100,79 @@ Returns:
 static void usage(const char *progname)
 {
     cerr << "Usage: rv32i [-d] [-i] [-r] [-z] [-l exec-limit] "
-         << "[-m hex-mem-size] infile" << endl;
+         << "[-m hex-mem-size] [--dump full|sparse|diff|bin:file] [--reg-trace full|delta[:n]] "
+         << "[--trace-range start:end] [--trace-pc lo:hi]... [--trace-every n] [--record file | --replay file] [--rewind n] "
+         << "[--break addr[,hits=n][,if=cond]]... [--watch addr[,len][,r|w|rw]]... "
+         << "[--gdb port|unix:path [--reverse]] [--load file[@addr]]... "
+         << "[--env name=value]... [--ilp-profile[=w,...]] [--defuse-profile[=n]] "
+         << "[--value-profile[=n]] [--mem-profile file [--mem-interval n]] "
+         << "[--loop-profile[=n]] [--memcheck] [--stack-profile[=n]] [--coverage file] "
+         << "infile [guest-args...]" << endl;
     cerr << "  -d show disassembly before program execution" << endl;
     cerr << "  -i show instruction printing during execution" << endl;
     cerr << "  -l maximum number of instructions to exec" << endl;
     cerr << "  -m specify memory size (default = 0x100)" << endl;
     cerr << "  -r show register printing during execution" << endl;
     cerr << "  -z show a dump of the regs & memory after simulation" << endl;
+    cerr << "  --dump full          same as -z" << endl;
+    cerr << "  --dump sparse        like -z, but summarize untouched (0xa5) memory" << endl;
+    cerr << "  --dump diff          like -z, but show only memory lines that differ" << endl;
+    cerr << "                       from the loaded program" << endl;
+    cerr << "  --dump bin:file      like -z, but write memory to file as raw bytes" << endl;
+    cerr << "  --reg-trace full     same as -r" << endl;
+    cerr << "  --reg-trace delta:n  like -r, but print only changed registers, with" << endl;
+    cerr << "                       a full dump every n instructions (default 1000);" << endl;
+    cerr << "                       regtrace_expand turns it back into -r output" << endl;
+    cerr << "  --trace-range start:end  trace (-i/-r) only instructions start..end-1" << endl;
+    cerr << "                           (counted from 0; either bound may be left out)" << endl;
+    cerr << "  --trace-pc lo:hi         trace only pcs in [lo, hi) (hex, repeatable)" << endl;
+    cerr << "  --trace-every n          trace only every n-th instruction" << endl;
+    cerr << "  --record file  log nondeterministic inputs to file" << endl;
+    cerr << "  --replay file  feed back inputs logged by --record" << endl;
+    cerr << "  --rewind n     after simulation, go back to the state before insn n" << endl;
+    cerr << "  --tt-interval n   instructions between rewind snapshots (default 100000)" << endl;
+    cerr << "  --tt-snapshots n  snapshots kept before thinning (default 64)" << endl;
+    cerr << "  --tt-undo n       undo log length in instructions (default 65536)" << endl;
+    cerr << "  --break addr   stop before executing the instruction at hex addr" << endl;
+    cerr << "                 (,hits=n: from the n-th hit on; ,if=cond: only when" << endl;
+    cerr << "                 cond holds, e.g. if=a0==0x42&&mem32[sp+8]>100)" << endl;
+    cerr << "  --watch spec   stop after an access to hex addr (len bytes, default 4;" << endl;
+    cerr << "                 r = reads, w = writes (default), rw = both)" << endl;
+    cerr << "  --gdb port     debug with GDB over localhost:port (or unix:path)" << endl;
+    cerr << "  --reverse      journal execution so GDB can reverse-step/continue" << endl;
+    cerr << "  --load file[@addr]  also load a raw, ELF, Intel HEX (.hex, .ihex, .ihx)" << endl;
+    cerr << "                      or $readmemh (.mem, .memh, .vmem) image; repeatable," << endl;
+    cerr << "                      infile is then optional. A raw image loads at hex" << endl;
+    cerr << "                      addr (default 0); $readmemh word 0 goes to byte" << endl;
+    cerr << "                      addr and @ lines in the file are word offsets from" << endl;
+    cerr << "                      it. Execution starts at the first image's entry" << endl;
+    cerr << "                      point (ELF/Intel HEX) or base address" << endl;
+    cerr << "  --env name=value    add to the program's environment (repeatable)" << endl;
+    cerr << "  --ilp-profile[=w,...]  report the dataflow critical path and ideal ILP," << endl;
+    cerr << "                         unlimited and for instruction windows of w" << endl;
+    cerr << "                         (default 32,128,512)" << endl;
+    cerr << "  --defuse-profile[=n]   report dead register writes and stores, distance" << endl;
+    cerr << "                         to first use and register pressure; lists the n" << endl;
+    cerr << "                         instructions with most dead results (default 20)" << endl;
+    cerr << "  --value-profile[=n]    list up to n (default 20) load/ALU instructions" << endl;
+    cerr << "                         whose results are invariant, and n whose results" << endl;
+    cerr << "                         follow a fixed stride" << endl;
+    cerr << "  --mem-profile file     write per-page/per-line access counts, working" << endl;
+    cerr << "                         sets and per-pc address patterns to file, and" << endl;
+    cerr << "                         print a summary" << endl;
+    cerr << "  --mem-interval n       working-set interval in instructions" << endl;
+    cerr << "                         (default 100000)" << endl;
+    cerr << "  --loop-profile[=n]     list the n (default 20) loops that execute the" << endl;
+    cerr << "                         most instructions, with their trip counts" << endl;
+    cerr << "  --memcheck             report instructions that branch on, address" << endl;
+    cerr << "                         memory with or execute uninitialised data" << endl;
+    cerr << "  --stack-profile[=n]    report the stack and heap high-water marks and" << endl;
+    cerr << "                         the n (default 20) functions with the deepest stack" << endl;
+    cerr << "  --coverage file        write line and branch coverage (lcov format), using" << endl;
+    cerr << "                         the DWARF line tables of the --load ELF images" << endl;
+    cerr << "  guest-args     passed to the program as argv[1..] (argv[0] is infile)," << endl;
+    cerr << "                 with argc/argv/envp/auxv on the stack and in a0-a2;" << endl;
+    cerr << "                 put -- before them if any start with '-'" << endl;
     exit(1);
 }
 
@@ -92,6 +207,274 @@ static void disassemble(const memory &mem)
 }
 
 
+/***************************************************************
+Function: parse_break
+
+
+Use:      Parses a --break argument of the form
+          addr[,hits=n][,if=cond] where addr is hex. The condition
+          runs to the end of the argument.
+
+
+Arguments:
+    spec - The option argument.
+    bps  - Breakpoint set to add the breakpoint to.
+
+
+Returns:
+    false if spec is malformed.
+***************************************************************/
+static bool parse_break(const string &spec, breakpoints &bps)
+{
+    size_t comma = spec.find(',');
+    std::istringstream as(spec.substr(0, comma));
+    uint32_t addr;
+    uint32_t hits = 0;
+    string cond;
+
+
+    if (!(as >> std::hex >> addr))
+        return false;
+
+
+    while (comma != string::npos)
+    {
+        size_t start = comma + 1;
+        if (spec.compare(start, 3, "if=") == 0)
+        {
+            cond = spec.substr(start + 3);
+            break;
+        }
+
+
+        comma = spec.find(',', start);
+        string field = spec.substr(start, comma == string::npos ? string::npos : comma - start);
+        if (field.compare(0, 5, "hits=") != 0)
+            return false;
+
+
+        char *end;
+        hits = std::strtoul(field.c_str() + 5, &end, 0);
+        if (*end || field.size() == 5)
+            return false;
+    }
+
+
+    bps.add_breakpoint(addr);
+    bps.set_hit_count(addr, hits);
+
+
+    string err;
+    if (!cond.empty() && !bps.set_condition(addr, cond, err))
+    {
+        cerr << "Bad breakpoint condition '" << cond << "': " << err << endl;
+        return false;
+    }
+    return true;
+}
+
+
+/***************************************************************
+Function: parse_trace_range
+
+
+Use:      Parses a --trace-range (decimal instruction counts) or
+          --trace-pc (hex addresses) argument of the form lo:hi.
+          Either bound may be left out.
+
+
+Arguments:
+    spec   - The option argument.
+    pc     - true for --trace-pc.
+    window - Trace window to update.
+
+
+Returns:
+    false if spec is malformed.
+***************************************************************/
+static bool parse_trace_range(const string &spec, bool pc, trace_window &window)
+{
+    size_t colon = spec.find(':');
+    if (colon == string::npos)
+        return false;
+
+
+    string lo_s = spec.substr(0, colon);
+    string hi_s = spec.substr(colon + 1);
+    uint64_t lo = 0;
+    uint64_t hi = pc ? (uint64_t(1) << 32) : UINT64_MAX;
+    char *end;
+
+
+    if (!lo_s.empty())
+    {
+        lo = std::strtoull(lo_s.c_str(), &end, pc ? 16 : 10);
+        if (*end)
+            return false;
+    }
+    if (!hi_s.empty())
+    {
+        hi = std::strtoull(hi_s.c_str(), &end, pc ? 16 : 10);
+        if (*end)
+            return false;
+    }
+    if (lo >= hi)
+        return false;
+
+
+    if (pc)
+        window.pc_ranges.push_back({ uint32_t(lo), uint32_t(std::min<uint64_t>(hi, 0xffffffff)) });
+    else
+    {
+        window.start = lo;
+        window.end   = hi;
+    }
+    return true;
+}
+
+
+/***************************************************************
+Function: parse_watch
+
+
+Use:      Parses a --watch argument of the form addr[,len][,type]
+          where addr and len are hex and type is r, w or rw.
+
+
+Arguments:
+    spec - The option argument.
+    bps  - Breakpoint set to add the watchpoint to.
+
+
+Returns:
+    false if spec is malformed.
+***************************************************************/
+static bool parse_watch(const string &spec, breakpoints &bps)
+{
+    std::istringstream iss(spec);
+    string field;
+    uint32_t addr = 0, len = 4;
+    breakpoints::watch_type type = breakpoints::watch_write;
+
+
+    for (int i = 0; std::getline(iss, field, ','); ++i)
+    {
+        if (field == "r")
+            type = breakpoints::watch_read;
+        else if (field == "w")
+            type = breakpoints::watch_write;
+        else if (field == "rw")
+            type = breakpoints::watch_access;
+        else if (i < 2)
+        {
+            std::istringstream fs(field);
+            if (!(fs >> std::hex >> (i == 0 ? addr : len)))
+                return false;
+        }
+        else
+            return false;
+    }
+
+
+    bps.add_watchpoint(addr, len, type);
+    return true;
+}
+
+
+/***************************************************************
+Function: parse_gdb
+
+
+Use:      Parses a --gdb argument: unix:path, or a decimal TCP
+          port from 1 to 65535.
+
+
+Arguments:
+    spec - The option argument.
+    port - Set to the port, or 0 for a Unix-domain socket.
+
+
+Returns:
+    false if spec is malformed or the port is out of range.
+***************************************************************/
+static bool parse_gdb(const string &spec, uint16_t &port)
+{
+    port = 0;
+    if (spec.compare(0, 5, "unix:") == 0)
+        return spec.size() > 5;
+
+
+    if (spec.empty() || !std::isdigit(static_cast<unsigned char>(spec[0])))
+        return false;
+
+
+    std::istringstream iss(spec);
+    uint32_t p = 0;
+    if (!(iss >> p) || !iss.eof() || p == 0 || p > 65535)
+        return false;
+    port = static_cast<uint16_t>(p);
+    return true;
+}
+
+
+/***************************************************************
+Function: parse_windows
+
+
+Use:      Parses an --ilp-profile argument: a comma-separated list
+          of decimal instruction window sizes.
+
+
+Arguments:
+    spec    - The option argument.
+    windows - Replaced with the sizes.
+
+
+Returns:
+    false if spec is malformed or a size is 0.
+***************************************************************/
+static bool parse_windows(const string &spec, std::vector<uint32_t> &windows)
+{
+    std::istringstream iss(spec);
+    string field;
+
+
+    windows.clear();
+    while (std::getline(iss, field, ','))
+    {
+        std::istringstream fs(field);
+        uint32_t w = 0;
+        if (!(fs >> w) || w == 0 || !fs.eof())
+            return false;
+        windows.push_back(w);
+    }
+    return !windows.empty();
+}
+
+
+/***************************************************************
+Function: parse_count
+
+
+Use:      Parses the "=n" argument of a report option such as
+          --defuse-profile: a decimal count of entries to print.
+
+
+Arguments:
+    spec - The option argument.
+    n    - Set to the count.
+
+
+Returns:
+    false if spec is not a whole decimal number.
+***************************************************************/
+static bool parse_count(const string &spec, uint32_t &n)
+{
+    std::istringstream iss(spec);
+    return !spec.empty() && isdigit(static_cast<unsigned char>(spec[0])) && (iss >> n) && iss.eof();
+}
+
+
 /***************************************************************
 Function: main
 
@@ -118,13 +501,120 @@ int main(int argc, char **argv)
     bool iflag = false;            // -i: show instructions
     bool rflag = false;            // -r: show registers
     bool zflag = false;            // -z: dump regs & memory after
+    string dump_mode = "full";     // --dump: how -z shows memory
+    string dump_file;              // --dump bin: output file
+    uint32_t delta_sync = 0;       // --reg-trace delta: full-dump interval
+    trace_window window;           // --trace-range / --trace-pc / --trace-every
+
+
+    string record_file;            // --record: log nondeterministic inputs
+    string replay_file;            // --replay: replay a recorded log
+
+
+    bool     rewind        = false;    // --rewind: reverse after the run
+    uint64_t rewind_to     = 0;
+    uint64_t tt_interval   = 100000;   // time-travel tuning
+    uint64_t tt_snapshots  = 64;
+    uint64_t tt_undo       = 65536;
+
+
+    breakpoints bps;               // --break / --watch
+
+
+    string gdb_target;             // --gdb: port number or unix:path
+    uint16_t gdb_port = 0;         // its TCP port (0 = unix:path)
+    bool   reverse = false;        // --reverse: allow reverse execution
+
+
+    std::vector<string> load_specs;    // --load: extra images
+    std::vector<string> guest_env;     // --env: program environment
+
+
+    bool ilp_flag = false;                              // --ilp-profile
+    std::vector<uint32_t> ilp_windows { 32, 128, 512 };
+    bool defuse_flag = false;                           // --defuse-profile
+    uint32_t defuse_top = 20;
+    bool value_flag = false;                            // --value-profile
+    uint32_t value_top = 20;
+    string mem_profile_file;                            // --mem-profile
+    uint64_t mem_interval = 100000;
+    bool loop_flag = false;                             // --loop-profile
+    uint32_t loop_top = 20;
+    bool memcheck_flag = false;                         // --memcheck
+    bool stack_flag = false;                            // --stack-profile
+    uint32_t stack_top = 20;
+    string coverage_file;                               // --coverage
+
+
+    // Long-only options use values above the ASCII range.
+    enum
+    {
+        opt_record = 256,
+        opt_reg_trace,
+        opt_dump,
+        opt_trace_range,
+        opt_trace_pc,
+        opt_trace_every,
+        opt_replay,
+        opt_rewind,
+        opt_tt_interval,
+        opt_tt_snapshots,
+        opt_tt_undo,
+        opt_break,
+        opt_watch,
+        opt_gdb,
+        opt_reverse,
+        opt_load,
+        opt_env,
+        opt_ilp_profile,
+        opt_defuse_profile,
+        opt_value_profile,
+        opt_mem_profile,
+        opt_mem_interval,
+        opt_loop_profile,
+        opt_memcheck,
+        opt_stack_profile,
+        opt_coverage
+    };
+
+
+    static const struct option long_opts[] =
+    {
+        { "reg-trace", required_argument, nullptr, opt_reg_trace },
+        { "dump",      required_argument, nullptr, opt_dump },
+        { "trace-range", required_argument, nullptr, opt_trace_range },
+        { "trace-pc",    required_argument, nullptr, opt_trace_pc },
+        { "trace-every", required_argument, nullptr, opt_trace_every },
+        { "record", required_argument, nullptr, opt_record },
+        { "replay", required_argument, nullptr, opt_replay },
+        { "rewind", required_argument, nullptr, opt_rewind },
+        { "tt-interval",  required_argument, nullptr, opt_tt_interval },
+        { "tt-snapshots", required_argument, nullptr, opt_tt_snapshots },
+        { "tt-undo",      required_argument, nullptr, opt_tt_undo },
+        { "break",  required_argument, nullptr, opt_break },
+        { "watch",  required_argument, nullptr, opt_watch },
+        { "gdb",    required_argument, nullptr, opt_gdb },
+        { "reverse", no_argument,      nullptr, opt_reverse },
+        { "load",   required_argument, nullptr, opt_load },
+        { "env",    required_argument, nullptr, opt_env },
+        { "ilp-profile", optional_argument, nullptr, opt_ilp_profile },
+        { "defuse-profile", optional_argument, nullptr, opt_defuse_profile },
+        { "value-profile",  optional_argument, nullptr, opt_value_profile },
+        { "mem-profile",  required_argument, nullptr, opt_mem_profile },
+        { "mem-interval", required_argument, nullptr, opt_mem_interval },
+        { "loop-profile", optional_argument, nullptr, opt_loop_profile },
+        { "memcheck",     no_argument,       nullptr, opt_memcheck },
+        { "stack-profile", optional_argument, nullptr, opt_stack_profile },
+        { "coverage",     required_argument, nullptr, opt_coverage },
+        { nullptr,  0,                 nullptr, 0 }
+    };
 
 
     // ------------------------------------------------------------
-    // Parse command-line options using getopt.
+    // Parse command-line options using getopt_long.
     // ------------------------------------------------------------
     int opt;
-    while ((opt = getopt(argc, argv, "dirzl:m:")) != -1)
+    while ((opt = getopt_long(argc, argv, "dirzl:m:", long_opts, nullptr)) != -1)
     {
         switch (opt)
         {
@@ -148,6 +638,45 @@ int main(int argc, char **argv)
             break;
 
 
+        case opt_reg_trace:
+        {
+            // full, delta or delta:n
+            string mode = optarg;
+            rflag = true;
+            if (mode == "full")
+                delta_sync = 0;
+            else if (mode == "delta")
+                delta_sync = 1000;
+            else if (mode.compare(0, 6, "delta:") == 0)
+            {
+                std::istringstream iss(mode.substr(6));
+                if (!(iss >> delta_sync) || delta_sync == 0)
+                    usage(argv[0]);
+            }
+            else
+                usage(argv[0]);
+            break;
+        }
+
+
+        case opt_dump:
+        {
+            // full, sparse, diff or bin:file
+            string mode = optarg;
+            zflag = true;
+            if (mode.compare(0, 4, "bin:") == 0 && mode.size() > 4)
+            {
+                dump_mode = "bin";
+                dump_file = mode.substr(4);
+            }
+            else if (mode == "full" || mode == "sparse" || mode == "diff")
+                dump_mode = mode;
+            else
+                usage(argv[0]);
+            break;
+        }
+
+
         case 'l':
         {
             // execution limit is decimal
@@ -166,6 +695,158 @@ int main(int argc, char **argv)
         }
 
 
+        case opt_trace_range:
+        case opt_trace_pc:
+            if (!parse_trace_range(optarg, opt == opt_trace_pc, window))
+                usage(argv[0]);
+            break;
+
+
+        case opt_trace_every:
+        {
+            std::istringstream iss(optarg);
+            if (!(iss >> window.every) || window.every == 0)
+                usage(argv[0]);
+            break;
+        }
+
+
+        case opt_record:
+            record_file = optarg;
+            break;
+
+
+        case opt_replay:
+            replay_file = optarg;
+            break;
+
+
+        case opt_rewind:
+        {
+            std::istringstream iss(optarg);
+            iss >> rewind_to;
+            rewind = true;
+            break;
+        }
+
+
+        case opt_tt_interval:
+        {
+            std::istringstream iss(optarg);
+            iss >> tt_interval;
+            break;
+        }
+
+
+        case opt_tt_snapshots:
+        {
+            std::istringstream iss(optarg);
+            iss >> tt_snapshots;
+            break;
+        }
+
+
+        case opt_tt_undo:
+        {
+            std::istringstream iss(optarg);
+            iss >> tt_undo;
+            break;
+        }
+
+
+        case opt_break:
+            if (!parse_break(optarg, bps))
+                usage(argv[0]);
+            break;
+
+
+        case opt_watch:
+            if (!parse_watch(optarg, bps))
+                usage(argv[0]);
+            break;
+
+
+        case opt_gdb:
+            gdb_target = optarg;
+            if (!parse_gdb(gdb_target, gdb_port))
+                usage(argv[0]);
+            break;
+
+
+        case opt_reverse:
+            reverse = true;
+            break;
+
+
+        case opt_load:
+            load_specs.push_back(optarg);
+            break;
+
+
+        case opt_env:
+            guest_env.push_back(optarg);
+            break;
+
+
+        case opt_ilp_profile:
+            ilp_flag = true;
+            if (optarg && !parse_windows(optarg, ilp_windows))
+                usage(argv[0]);
+            break;
+
+
+        case opt_defuse_profile:
+            defuse_flag = true;
+            if (optarg && !parse_count(optarg, defuse_top))
+                usage(argv[0]);
+            break;
+
+
+        case opt_value_profile:
+            value_flag = true;
+            if (optarg && !parse_count(optarg, value_top))
+                usage(argv[0]);
+            break;
+
+
+        case opt_mem_profile:
+            mem_profile_file = optarg;
+            break;
+
+
+        case opt_mem_interval:
+        {
+            std::istringstream iss(optarg);
+            if (!(iss >> mem_interval) || mem_interval == 0 || !iss.eof())
+                usage(argv[0]);
+            break;
+        }
+
+
+        case opt_loop_profile:
+            loop_flag = true;
+            if (optarg && !parse_count(optarg, loop_top))
+                usage(argv[0]);
+            break;
+
+
+        case opt_memcheck:
+            memcheck_flag = true;
+            break;
+
+
+        case opt_stack_profile:
+            stack_flag = true;
+            if (optarg && !parse_count(optarg, stack_top))
+                usage(argv[0]);
+            break;
+
+
+        case opt_coverage:
+            coverage_file = optarg;
+            break;
+
+
         default:
             // invalid option (like -X)
             cerr << argv[0] << ": invalid option -- '" << (char)optopt << "'" << endl;
@@ -174,25 +855,41 @@ int main(int argc, char **argv)
     }
 
 
-    // After options, we must have exactly one infile argument.
-    if (optind >= argc)
+    // After options, we must have an infile argument (which --load
+    // makes optional); anything after it is for the program.
+    if (optind >= argc && load_specs.empty())
     {
         usage(argv[0]);
     }
 
 
-    const char *infile = argv[optind];
+    if (!record_file.empty() && !replay_file.empty())
+    {
+        cerr << argv[0] << ": --record and --replay are mutually exclusive" << endl;
+        usage(argv[0]);
+    }
 
 
     // ------------------------------------------------------------
-    // Create simulated memory and load the input file.
+    // Create simulated memory and load the input file (always raw,
+    // at 0, and first) and any --load images.
     // ------------------------------------------------------------
     memory mem(memory_limit);
 
 
-    if (!mem.load_file(infile))
+    loader images;
+    if (optind < argc)
+        images.add_raw(argv[optind], 0);
+    for (const string &spec : load_specs)
+    {
+        if (!images.add(spec))
+            usage(argv[0]);
+    }
+
+
+    if (!images.load(mem))
     {
-        // load_file already printed an error message
+        // load already printed an error message
         return 1;
     }
 
@@ -211,13 +908,185 @@ int main(int argc, char **argv)
     // ------------------------------------------------------------
     cpu_single_hart cpu(mem);
     cpu.reset();
+    cpu.set_pc(images.get_entry());
+
+
+    if (optind + 1 < argc || !guest_env.empty())
+    {
+        string name = optind < argc ? argv[optind] : load_specs[0].substr(0, load_specs[0].rfind('@'));
+        std::vector<string> guest_argv { name };
+        for (int i = optind + 1; i < argc; ++i)
+            guest_argv.push_back(argv[i]);
+
+
+        if (!cpu.set_guest_args(guest_argv, guest_env))
+        {
+            cerr << "Program arguments and environment do not fit in memory." << endl;
+            return 1;
+        }
+    }
+
+
+    // A trace window with no -i/-r traces instructions.
+    if (window.is_set() && !iflag && !rflag)
+        iflag = true;
 
 
     cpu.set_show_instructions(iflag);
     cpu.set_show_registers(rflag);
+    cpu.set_trace_window(window);
+    cpu.set_reg_trace_delta(delta_sync);
 
 
-    cpu.run(exec_limit);
+    replay_log rlog;
+    if (!record_file.empty() && !rlog.open_record(record_file))
+        return 1;
+    if (!replay_file.empty() && !rlog.open_replay(replay_file))
+        return 1;
+    if (rlog.get_mode() != replay_log::mode::off)
+        cpu.set_replay_log(&rlog);
+
+
+    if (bps.has_breakpoints() || bps.has_watchpoints())
+        cpu.set_breakpoints(&bps);
+
+
+    std::unique_ptr<ilp_profiler> ilp;
+    if (ilp_flag)
+    {
+        ilp = std::make_unique<ilp_profiler>(ilp_windows);
+        cpu.add_observer(ilp.get());
+    }
+    std::unique_ptr<defuse_profiler> defuse;
+    if (defuse_flag)
+    {
+        defuse = std::make_unique<defuse_profiler>();
+        cpu.add_observer(defuse.get());
+    }
+    std::unique_ptr<value_profiler> values;
+    if (value_flag)
+    {
+        values = std::make_unique<value_profiler>();
+        cpu.add_observer(values.get());
+    }
+    std::unique_ptr<mem_profiler> memprof;
+    if (!mem_profile_file.empty())
+    {
+        memprof = std::make_unique<mem_profiler>(mem_interval);
+        cpu.add_observer(memprof.get());
+    }
+    std::unique_ptr<loop_profiler> loops;
+    if (loop_flag)
+    {
+        loops = std::make_unique<loop_profiler>();
+        cpu.add_observer(loops.get());
+    }
+    std::unique_ptr<memcheck> checker;
+    if (memcheck_flag)
+    {
+        checker = std::make_unique<memcheck>(mem, cpu);
+        cpu.add_observer(checker.get());
+    }
+    std::unique_ptr<stack_profiler> stackprof;
+    if (stack_flag)
+    {
+        stackprof = std::make_unique<stack_profiler>(mem, cpu);
+        cpu.add_observer(stackprof.get());
+    }
+    std::unique_ptr<coverage> cov;
+    if (!coverage_file.empty())
+    {
+        cov = std::make_unique<coverage>(mem, images.get_entry());
+        for (const string &elf : images.get_elf_files())
+        {
+            if (!cov->add_line_info(elf))
+                return 1;
+        }
+        cpu.add_observer(cov.get());
+    }
+
+
+    timetravel tt(cpu, mem, tt_interval, tt_snapshots, tt_undo);
+    if (rewind || reverse)
+        tt.attach();
+
+
+    if (!gdb_target.empty())
+    {
+        // Debug session: GDB drives execution instead of run().
+        gdbstub stub(cpu, mem, bps, reverse ? &tt : nullptr);
+        bool ok = gdb_port ? stub.listen_tcp(gdb_port)
+                           : stub.listen_unix(gdb_target.substr(5));
+        if (!ok)
+            return 1;
+
+
+        cpu.start();
+        stub.serve();
+    }
+    else
+    {
+        cpu.run(exec_limit);
+    }
+    rlog.close();
+
+
+    if (ilp)
+    {
+        cpu.remove_observer(ilp.get());
+        ilp->report(cout);
+    }
+    if (defuse)
+    {
+        cpu.remove_observer(defuse.get());
+        defuse->report(cout, mem, defuse_top);
+    }
+    if (values)
+    {
+        cpu.remove_observer(values.get());
+        values->report(cout, mem, value_top);
+    }
+    if (memprof)
+    {
+        cpu.remove_observer(memprof.get());
+        if (!memprof->write(mem_profile_file))
+            return 1;
+        memprof->report(cout, mem);
+    }
+    if (loops)
+    {
+        cpu.remove_observer(loops.get());
+        loops->report(cout, loop_top);
+    }
+    if (checker)
+    {
+        cpu.remove_observer(checker.get());
+        checker->report(cout, mem);
+    }
+    if (stackprof)
+    {
+        cpu.remove_observer(stackprof.get());
+        stackprof->report(cout, stack_top);
+    }
+    if (cov)
+    {
+        cpu.remove_observer(cov.get());
+        if (!cov->write_lcov(coverage_file, mem))
+            return 1;
+        cov->report(cout, mem);
+    }
+
+
+    if (rewind)
+    {
+        size_t history = tt.get_memory_usage();
+        if (tt.reverse_to(rewind_to))
+            cout << "Rewound to instruction " << rewind_to << " (history held "
+                 << (history + 1023) / 1024 << " KiB)" << endl;
+        else
+            cerr << "Can't rewind to instruction " << rewind_to
+                 << " (history starts at " << tt.get_earliest() << ")" << endl;
+    }
 
 
     // ------------------------------------------------------------
@@ -226,7 +1095,20 @@ int main(int argc, char **argv)
     if (zflag)
     {
         cpu.dump();   // dump registers + pc
-        mem.dump();   // dump memory
+
+
+        // dump memory
+        if (dump_mode == "sparse")
+            mem.dump_sparse();
+        else if (dump_mode == "diff")
+            mem.dump_diff();
+        else if (dump_mode == "bin")
+        {
+            if (!mem.dump_binary(dump_file))
+                return 1;
+        }
+        else
+            mem.dump();
     }
 
 
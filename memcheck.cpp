@@ -0,0 +1,545 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'memcheck' class. Uses of undefined data are found in
+    on_insn, before the instruction executes, from the shadow state of its
+    source registers; the definedness of its result is worked out there
+    too (or, for a load, in on_load) and given to the destination register
+    in on_reg_write.
+********************************************************************************************/
+
+
+#include "memcheck.h"
+
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+
+#include "hex.h"
+#include "memscan.h"
+#include "rv32i_decode.h"
+
+
+/***************************************************************
+Function: expand / collapse
+
+
+Use:      Convert a 4-bit undefined-byte mask to a 32-bit
+          undefined-bit mask and back (a byte is undefined if any
+          of its bits is).
+
+
+Arguments:
+    u    - Byte mask.
+    bits - Bit mask.
+
+
+Returns:
+    The other mask.
+***************************************************************/
+static uint32_t expand(uint32_t u)
+{
+    uint32_t bits = 0;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        if (u & (1u << i))
+            bits |= 0xffu << (8 * i);
+    }
+    return bits;
+}
+
+
+static uint32_t collapse(uint32_t bits)
+{
+    uint32_t u = 0;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        if ((bits >> (8 * i)) & 0xff)
+            u |= 1u << i;
+    }
+    return u;
+}
+
+
+/***************************************************************
+Function: carry_up
+
+
+Use:      Definedness of a sum: a carry out of an undefined byte
+          makes every byte above it undefined too.
+
+
+Arguments:
+    u - Undefined bytes of the operands.
+
+
+Returns:
+    Undefined bytes of the result.
+***************************************************************/
+static uint32_t carry_up(uint32_t u)
+{
+    return u ? 0xf & ~((u & (0u - u)) - 1) : 0;
+}
+
+
+/***************************************************************
+Function: memcheck::memcheck
+
+
+Use:      Attaches the checker to a hart. The shadow state is set
+          up when the first instruction runs, so that the stack
+          pointer and guest stack the hart sets up at start are
+          seen as defined.
+
+
+Arguments:
+    mem  - The hart's memory.
+    hart - The hart.
+***************************************************************/
+memcheck::memcheck(const memory &mem, const rv32i_hart &hart)
+    : mem(mem), hart(hart),
+      pages((uint64_t(mem.get_size()) + memory::page_size - 1) >> memory::page_bits)
+{
+}
+
+
+/***************************************************************
+Function: memcheck::snapshot
+
+
+Use:      Sets up the shadow state from the current registers and
+          memory: loaded images and bytes already written are
+          defined, as are registers that no longer hold their
+          reset value.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void memcheck::snapshot()
+{
+    for (uint32_t r = 1; r < 32; ++r)
+        reg_undef[r] = static_cast<uint32_t>(hart.get_reg(r)) == 0xf0f0f0f0 ? 0xf : 0;
+
+
+    for (const auto &img : mem.get_images())
+        define(img.first, img.second);
+
+
+    // Bytes written before the run (e.g. the guest's stack).
+    uint8_t buf[memory::page_size];
+    for (uint64_t a = 0; a < mem.get_size(); a += memory::page_size)
+    {
+        if (!mem.is_resident(static_cast<uint32_t>(a)))
+            continue;
+        uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(memory::page_size, mem.get_size() - a));
+        mem.read_block(static_cast<uint32_t>(a), buf, n);
+        for (uint32_t i = static_cast<uint32_t>(memscan::find_not(buf, n, memory::fill_byte)); i < n; )
+        {
+            const void *f = std::memchr(buf + i, memory::fill_byte, n - i);
+            uint32_t end = f ? static_cast<uint32_t>(static_cast<const uint8_t *>(f) - buf) : n;
+            define(a + i, end - i);
+            i = end + static_cast<uint32_t>(memscan::find_not(buf + end, n - end, memory::fill_byte));
+        }
+    }
+}
+
+
+/***************************************************************
+Function: memcheck::define
+
+
+Use:      Marks a range of memory defined, a shadow word (32
+          bytes) at a time where it can.
+
+
+Arguments:
+    addr - First byte.
+    len  - Number of bytes.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void memcheck::define(uint64_t addr, uint64_t len)
+{
+    uint64_t end = std::min<uint64_t>(addr + len, uint64_t(pages.size()) << memory::page_bits);
+    while (addr < end)
+    {
+        uint32_t p   = static_cast<uint32_t>(addr >> memory::page_bits);
+        uint32_t off = static_cast<uint32_t>(addr & (memory::page_size - 1));
+        if (!pages[p])
+            pages[p].reset(new uint32_t[words_per_page]());
+
+
+        if ((off & 31) == 0 && end - addr >= 32)
+        {
+            pages[p][off >> 5] = ~0u;
+            addr += 32;
+        }
+        else
+        {
+            pages[p][off >> 5] |= 1u << (off & 31);
+            ++addr;
+        }
+    }
+}
+
+
+/***************************************************************
+Function: memcheck::mem_undef
+
+
+Use:      Reads the definedness of up to 4 bytes of memory.
+          Addresses outside memory count as defined (the hart
+          reports those accesses itself).
+
+
+Arguments:
+    addr - First byte.
+    len  - Number of bytes (1..4).
+
+
+Returns:
+    Mask of the undefined bytes (bit i = addr + i).
+***************************************************************/
+uint32_t memcheck::mem_undef(uint32_t addr, uint32_t len) const
+{
+    uint32_t u = 0;
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        uint32_t a = addr + i;
+        uint32_t p = a >> memory::page_bits;
+        if (p >= pages.size())
+            continue;
+        uint32_t off = a & (memory::page_size - 1);
+        if (!pages[p] || !((pages[p][off >> 5] >> (off & 31)) & 1))
+            u |= 1u << i;
+    }
+    return u;
+}
+
+
+/***************************************************************
+Function: memcheck::mark
+
+
+Use:      Sets the definedness of up to 4 bytes of memory.
+
+
+Arguments:
+    addr  - First byte.
+    len   - Number of bytes (1..4).
+    undef - Mask of the bytes to mark undefined; the rest are
+            marked defined.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void memcheck::mark(uint32_t addr, uint32_t len, uint32_t undef)
+{
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        uint32_t a = addr + i;
+        uint32_t p = a >> memory::page_bits;
+        if (p >= pages.size())
+            continue;
+
+
+        uint32_t off = a & (memory::page_size - 1);
+        uint32_t bit = 1u << (off & 31);
+        if (undef & (1u << i))
+        {
+            if (pages[p])
+                pages[p][off >> 5] &= ~bit;
+        }
+        else
+        {
+            if (!pages[p])
+                pages[p].reset(new uint32_t[words_per_page]());
+            pages[p][off >> 5] |= bit;
+        }
+    }
+}
+
+
+/***************************************************************
+Function: memcheck::use
+
+
+Use:      Records a use of undefined data by the current
+          instruction.
+
+
+Arguments:
+    kind - What the data was used for.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void memcheck::use(use_kind kind)
+{
+    auto ins = errors.emplace(cur_pc, error { kind, insns, 0 });
+    ++ins.first->second.count;
+}
+
+
+/***************************************************************
+Function: memcheck::on_insn
+
+
+Use:      Checks the instruction's uses of its operands and works
+          out the definedness of its result.
+
+
+Arguments:
+    pc   - Instruction address.
+    insn - Instruction word.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void memcheck::on_insn(uint32_t pc, uint32_t insn)
+{
+    if (insns == 0)
+        snapshot();
+    cur_pc = pc;
+    if (mem_undef(pc, 4))
+        use(use_fetch);
+
+
+    uint32_t opcode = rv32i_decode::get_opcode(insn);
+    uint32_t f3     = rv32i_decode::get_funct3(insn);
+    uint32_t rs1    = rv32i_decode::get_rs1(insn);
+    uint32_t rs2    = rv32i_decode::get_rs2(insn);
+    uint32_t u1     = reg_undef[rs1];
+    uint32_t u2     = reg_undef[rs2];
+    result = 0;
+
+
+    switch (opcode)
+    {
+    case rv32i_decode::opcode_btype:
+        if (u1 | u2)
+            use(use_branch);
+        break;
+
+
+    case rv32i_decode::opcode_load:
+        if (u1)
+            use(use_address);
+        load_f3 = f3;
+        break;
+
+
+    case rv32i_decode::opcode_store:
+        if (u1)
+            use(use_address);
+        stored = static_cast<uint8_t>(u2);
+        break;
+
+
+    case rv32i_decode::opcode_jalr:
+        if (u1)
+            use(use_jump);
+        break;
+
+
+    case rv32i_decode::opcode_alu_imm:
+    {
+        uint32_t shamt = rs2;           // imm[4:0]
+        switch (f3)
+        {
+        case 0b000: result = carry_up(u1); break;                           // addi
+        case 0b111:                                                         // andi
+        {
+            uint32_t imm = static_cast<uint32_t>(rv32i_decode::get_imm_i(insn));
+            result = collapse(expand(u1) & imm);
+            break;
+        }
+        case 0b100:                                                         // xori
+        case 0b110: result = u1; break;                                     // ori
+        case 0b001: result = collapse(expand(u1) << shamt); break;          // slli
+        case 0b101:                                                         // srli/srai
+            if (insn & 0x40000000)
+                result = collapse(static_cast<uint32_t>(static_cast<int32_t>(expand(u1)) >> shamt));
+            else
+                result = collapse(expand(u1) >> shamt);
+            break;
+        default:    result = u1 ? 0xf : 0; break;                           // slti/sltiu
+        }
+        break;
+    }
+
+
+    case rv32i_decode::opcode_alu_reg:
+        if (rs1 == rs2 && (f3 == 0b100 || (f3 == 0b000 && (insn & 0x40000000))))
+            result = 0;                                                     // xor/sub r,r
+        else if (f3 == 0b000)
+            result = carry_up(u1 | u2);                                     // add/sub
+        else if (f3 == 0b100 || f3 == 0b110 || f3 == 0b111)
+            result = u1 | u2;                                               // xor/or/and
+        else if (f3 == 0b001 || f3 == 0b101)
+            result = u1 || (u2 & 1) ? 0xf : 0;                              // shifts
+        else
+            result = (u1 | u2) ? 0xf : 0;                                   // slt/sltu
+        break;
+
+
+    case rv32i_decode::opcode_system:
+        if (f3 >= 1 && f3 <= 3 && u1)
+            use(use_csr);
+        break;
+
+
+    default:
+        break;
+    }
+
+
+    ++insns;
+}
+
+
+/***************************************************************
+Function: memcheck::on_reg_write
+
+
+Use:      Gives the destination register the result's
+          definedness.
+
+
+Arguments:
+    r   - Register written.
+    val - Unused.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void memcheck::on_reg_write(uint32_t r, uint32_t val)
+{
+    (void)val;
+    reg_undef[r] = result;
+}
+
+
+/***************************************************************
+Function: memcheck::on_load
+
+
+Use:      Takes the loaded value's definedness from memory,
+          extended like the value itself.
+
+
+Arguments:
+    pc, val - Unused.
+    addr    - Load address.
+    len     - Load size in bytes.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void memcheck::on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)pc; (void)val;
+    uint32_t u = mem_undef(addr, len);
+    switch (load_f3)
+    {
+    case 0b000: result = (u & 1) ? 0xf : 0; break;             // lb
+    case 0b001: result = (u & 2) ? 0xf : (u & 1); break;       // lh
+    default:    result = static_cast<uint8_t>(u); break;       // lw, lbu, lhu
+    }
+}
+
+
+/***************************************************************
+Function: memcheck::on_store
+
+
+Use:      Copies the stored register bytes' definedness to memory.
+
+
+Arguments:
+    pc, val - Unused.
+    addr    - Store address.
+    len     - Store size in bytes.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void memcheck::on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)pc; (void)val;
+    mark(addr, len, stored);
+}
+
+
+/***************************************************************
+Function: memcheck::report
+
+
+Use:      Prints each instruction that used undefined data, with
+          what it was used for, when that first happened and how
+          often.
+
+
+Arguments:
+    os  - Output stream.
+    mem - Memory, to disassemble the instructions listed.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void memcheck::report(std::ostream &os, const memory &mem)
+{
+    static const char *const names[] =
+    {
+        "instruction fetch", "branch condition", "load/store address", "jump target", "CSR write"
+    };
+
+
+    std::vector<std::pair<uint32_t, const error *>> rows;
+    for (const auto &e : errors)
+        rows.emplace_back(e.first, &e.second);
+    std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b)
+    {
+        return a.second->first < b.second->first;
+    });
+
+
+    if (rows.empty())
+    {
+        os << "Memcheck: no uses of uninitialised values" << std::endl;
+        return;
+    }
+
+
+    std::ios_base::fmtflags flags = os.flags();
+    os << "Memcheck: " << rows.size() << " instructions used uninitialised values" << std::endl;
+    os << "  " << std::left << std::setw(12) << "pc" << std::right << std::setw(12) << "first"
+       << std::setw(10) << "count" << "  " << std::left << std::setw(20) << "use" << "insn" << std::endl;
+    for (const auto &r : rows)
+    {
+        os << "  " << std::left << std::setw(12) << hex::to_hex0x32(r.first) << std::right
+           << std::setw(12) << r.second->first << std::setw(10) << r.second->count
+           << "  " << std::left << std::setw(20) << names[r.second->kind]
+           << rv32i_decode::decode(r.first, mem.get32(r.first)) << std::endl;
+    }
+    os.flags(flags);
+}
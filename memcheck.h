@@ -0,0 +1,123 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'memcheck' class, which finds uses of uninitialised values,
+    in the style of Valgrind's memcheck. Memory starts out filled with 0xa5
+    and registers with 0xf0f0f0f0 so that such values stand out in dumps;
+    this checker tracks which bytes actually hold defined data and reports
+    each instruction whose behaviour depends on data that was never written.
+********************************************************************************************/
+
+
+#ifndef MEMCHECK_H
+#define MEMCHECK_H
+
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+
+#include "memory.h"
+#include "rv32i_hart.h"
+#include "rv32i_observer.h"
+
+
+/***************************************************************
+Class: memcheck
+
+
+Use:   Observer that keeps a definedness bit per memory byte and
+       an undefined-byte mask per register.
+
+       Memory bytes become defined when they are stored from
+       defined register bytes; bytes loaded from an image, or
+       already written (not 0xa5) when the first instruction
+       runs, start out defined. Registers start defined unless they
+       still hold the reset value 0xf0f0f0f0.
+
+       Definedness flows through instructions byte by byte:
+       loads copy it from memory (sign extension copies the sign
+       byte's), logical ops combine their operands', add/sub
+       make every byte from the lowest undefined one up
+       undefined (carries), immediate shifts move it with the
+       data, and everything else is undefined if any input is.
+       Results of lui, auipc, links and CSR reads, and
+       "xor/sub r,r" zeroing idioms, are defined.
+
+       Copying undefined data is not an error. A use is: an
+       instruction fetched from undefined bytes, a branch on an
+       undefined operand, a load/store or jump address, or a CSR
+       write with undefined bytes. The first such use at each
+       instruction is recorded, and later ones only counted.
+
+       The memory shadow is allocated a page at a time, packed
+       32 bytes to a word; a page never made defined costs
+       nothing.
+
+
+Data:
+       pages     - Per page, its definedness bits (1 = defined),
+                   or null if the whole page is undefined.
+       reg_undef - Per register, a mask of its undefined bytes.
+       errors    - Per instruction address, its uses of
+                   undefined data.
+***************************************************************/
+class memcheck : public rv32i_observer
+{
+public:
+    memcheck(const memory &mem, const rv32i_hart &hart);
+
+
+    void on_insn(uint32_t pc, uint32_t insn) override;
+    void on_reg_write(uint32_t r, uint32_t val) override;
+    void on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+    void on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+
+
+    // Print the instructions that used undefined data, in the
+    // order the first uses happened.
+    void report(std::ostream &os, const memory &mem);
+
+
+private:
+    enum use_kind : uint8_t { use_fetch, use_branch, use_address, use_jump, use_csr };
+
+
+    struct error
+    {
+        use_kind kind;          // of the first use
+        uint64_t first;         // instruction count of the first use
+        uint64_t count = 0;
+    };
+
+
+    static constexpr uint32_t words_per_page = memory::page_size / 32;
+
+
+    void     snapshot();
+    uint32_t mem_undef(uint32_t addr, uint32_t len) const;
+    void     mark(uint32_t addr, uint32_t len, uint32_t undef);
+    void     define(uint64_t addr, uint64_t len);
+    void     use(use_kind kind);
+
+
+    const memory      &mem;
+    const rv32i_hart  &hart;
+    std::vector<std::unique_ptr<uint32_t[]>> pages;
+    uint8_t  reg_undef[32] = {0};
+    std::unordered_map<uint32_t, error> errors;
+    uint64_t insns   = 0;
+    uint32_t cur_pc  = 0;
+    uint32_t load_f3 = 0;       // funct3 of the current load
+    uint8_t  result  = 0;       // undefined bytes of the current result
+    uint8_t  stored  = 0;       // undefined bytes of the current store data
+};
+
+
+#endif
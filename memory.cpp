@@ -6,31 +6,66 @@ Programmer:  Aasim Ghani
 Purpose:
     Implements the 'memory' class, which simulates a byte-addressable memory array
     for the RV32I disassembler. It provides methods to:
-      - Allocate and track the simulated memory size.
+      - Allocate and track the simulated memory size, materializing
+        each 4 KiB page on its first write.
       - Read and write 8-, 16-, and 32-bit values (little-endian).
       - Read sign-extended values (8-, 16-, and 32-bit forms).
       - Load a binary file into memory.
-      - Dump the entire memory contents in both hex and ASCII formats.
+      - Dump the entire memory contents in both hex and ASCII formats, in
+        full, sparsely, as a diff against the loaded image, or as binary.
     This class is used by main() and rv32i_decode to fetch instructions and
     report warnings for out-of-range memory accesses.
 ********************************************************************************************/
 
 
 #include "memory.h"
+#include "memscan.h"
 #include "hex.h"
 #include <iostream>
 #include <vector>
 #include <iomanip>
 #include <fstream>
 #include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <array>
+
+
+/***************************************************************
+Function: make_pristine
+
+
+Use:      Builds, at compile time, the page every untouched page
+          reads as.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    A page filled with memory::fill_byte.
+***************************************************************/
+static constexpr std::array<uint8_t, memory::page_size> make_pristine()
+{
+    std::array<uint8_t, memory::page_size> p {};
+    for (auto &b : p)
+        b = memory::fill_byte;
+    return p;
+}
+
+
+// Shared by every untouched page of every memory; read-only.
+static constexpr std::array<uint8_t, memory::page_size> pristine = make_pristine();
 
 
 /***************************************************************
 Function: memory::memory
 
 
-Use:      Constructor that allocates the simulated memory and
-          initializes all bytes to 0xa5.
+Use:      Constructor that sets up the page table. Every page
+          starts as the pristine page, which reads as 0xa5; no
+          storage is allocated until a page is written.
 
 
 Arguments:
@@ -44,7 +79,13 @@ Returns:
 memory::memory(uint32_t s)
 {
     s = (s + 15) & 0xfffffff0;          // round size up to multiple of 16
-    mem = std::vector<uint8_t>(s, 0xa5);
+    size = s;
+
+
+    size_t npages = (uint64_t(s) + page_size - 1) / page_size;
+    rd.assign(npages, pristine.data());
+    owned.resize(npages);
+    initial.resize(npages);
 }
 
 
@@ -52,8 +93,8 @@ memory::memory(uint32_t s)
 Function: memory::~memory
 
 
-Use:      Destructor for the memory object. The std::vector
-          automatically releases its storage.
+Use:      Destructor for the memory object. The page vectors
+          release their storage.
 
 
 Arguments:
@@ -68,13 +109,37 @@ memory::~memory()
 }
 
 
+/***************************************************************
+Function: memory::materialize
+
+
+Use:      Gives page p storage of its own, holding a copy of what
+          it read as until now: the pristine page or its initial
+          contents, which are kept for dump_diff().
+
+
+Arguments:
+    p - Page number.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void memory::materialize(uint32_t p)
+{
+    owned[p].reset(new uint8_t[page_size]);
+    std::memcpy(owned[p].get(), rd[p], page_size);
+    rd[p] = owned[p].get();
+}
+
+
 /***************************************************************
 Function: memory::check_illegal
 
 
 Use:      Checks whether the given address is outside the valid
           range of the simulated memory. If it is out of range, a
-          warning is printed to std::cerr.
+          warning is printed to std::cerr, unless set_quiet().
 
 
 Arguments:
@@ -87,9 +152,10 @@ Returns:
 ***************************************************************/
 bool memory::check_illegal(uint32_t addr) const
 {
-    if(addr >= mem.size())
+    if(addr >= size)
     {
-        std::cerr << "WARNING: Address out of range: " << hex::to_hex0x32(addr) << std::endl;
+        if (!quiet)
+            std::cerr << "WARNING: Address out of range: " << hex::to_hex0x32(addr) << std::endl;
         return true;
     }
     return false;
@@ -115,7 +181,7 @@ Returns:
 ***************************************************************/
 uint32_t memory::get_size() const
 {
-    return static_cast<uint32_t>(mem.size());
+    return size;
 }
 
 
@@ -138,7 +204,7 @@ uint8_t memory::get8(uint32_t addr) const
 {
     if (!check_illegal(addr))
     {  
-        return mem[addr];
+        return rd[addr >> page_bits][addr & (page_size - 1)];
     }
     else
     {
@@ -288,7 +354,7 @@ void memory::set8(uint32_t addr, uint8_t val)
 {
     if(!check_illegal(addr))
     {
-        mem[addr] = val;
+        writable(addr >> page_bits)[addr & (page_size - 1)] = val;
     }
 }
 
@@ -344,6 +410,123 @@ void memory::set32(uint32_t addr, uint32_t val)
 }
 
 
+/***************************************************************
+Function: memory::read_block
+
+
+Use:      Copies a contiguous range of simulated memory into a
+          caller-supplied buffer in one operation.
+
+
+Arguments:
+    addr - Address of the first byte to read.
+    buf  - Destination buffer of at least len bytes.
+    len  - Number of bytes to copy.
+
+
+Returns:
+    true on success. false if any byte of the range lies outside
+    memory; a warning is printed and nothing is copied.
+***************************************************************/
+bool memory::read_block(uint32_t addr, uint8_t *buf, uint32_t len) const
+{
+    if (len == 0)
+        return true;
+    if (check_illegal(addr) || check_illegal(addr + (len - 1)) || addr + (len - 1) < addr)
+        return false;
+
+
+    while (len)
+    {
+        uint32_t off = addr & (page_size - 1);
+        uint32_t n   = std::min(len, page_size - off);
+        std::memcpy(buf, rd[addr >> page_bits] + off, n);
+        addr += n;
+        buf  += n;
+        len  -= n;
+    }
+    return true;
+}
+
+
+/***************************************************************
+Function: memory::write_block
+
+
+Use:      Copies a caller-supplied buffer into a contiguous range
+          of simulated memory in one operation. Writing 0xa5 bytes
+          to a page that reads as the pristine page leaves it so.
+
+
+Arguments:
+    addr - Address of the first byte to write.
+    buf  - Source buffer of at least len bytes.
+    len  - Number of bytes to copy.
+
+
+Returns:
+    true on success. false if any byte of the range lies outside
+    memory; a warning is printed and nothing is written.
+***************************************************************/
+bool memory::write_block(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    if (len == 0)
+        return true;
+    if (check_illegal(addr) || check_illegal(addr + (len - 1)) || addr + (len - 1) < addr)
+        return false;
+
+
+    while (len)
+    {
+        uint32_t p   = addr >> page_bits;
+        uint32_t off = addr & (page_size - 1);
+        uint32_t n   = std::min(len, page_size - off);
+        if (rd[p] != pristine.data() || !memscan::all_equal(buf, n, fill_byte))
+            std::memcpy(writable(p) + off, buf, n);
+        addr += n;
+        buf  += n;
+        len  -= n;
+    }
+    return true;
+}
+
+
+/***************************************************************
+Function: memory::same_block
+
+
+Use:      Compares a range of simulated memory with a buffer.
+
+
+Arguments:
+    addr - Address of the first byte.
+    buf  - Buffer of at least len bytes.
+    len  - Number of bytes to compare.
+
+
+Returns:
+    true if the range is legal and holds exactly buf.
+***************************************************************/
+bool memory::same_block(uint32_t addr, const uint8_t *buf, uint32_t len) const
+{
+    if (uint64_t(addr) + len > size)
+        return false;
+
+
+    while (len)
+    {
+        uint32_t off = addr & (page_size - 1);
+        uint32_t n   = std::min(len, page_size - off);
+        if (!memscan::same(rd[addr >> page_bits] + off, buf, n))
+            return false;
+        addr += n;
+        buf  += n;
+        len  -= n;
+    }
+    return true;
+}
+
+
 /***************************************************************
 Function: memory::dump
 
@@ -365,85 +548,342 @@ Returns:
 ***************************************************************/
 void memory::dump() const
 {
-    for(uint32_t i = 0; i < mem.size(); i+=16)
+    for(uint32_t i = 0; i < size; i+=16)
+        dump_line(i, rd[i >> page_bits] + (i & (page_size - 1)), "");
+}
+
+
+/***************************************************************
+Function: memory::dump_sparse
+
+
+Use:      Prints the memory like dump(), except that each run of
+          lines holding nothing but fill_byte is replaced by one
+          line giving the range.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing. Output goes to std::cout.
+***************************************************************/
+void memory::dump_sparse() const
+{
+    uint32_t size = get_size();
+    uint32_t i = 0;
+
+
+    while (i < size)
     {
-        std::cout << to_hex32(i) << ": ";
+        // Skip to the line holding the next non-pristine byte.
+        uint32_t next = find_not_fill(i) & ~uint32_t(15);
 
 
-        // Print 16 bytes of hex data.
-        for(uint32_t j = 0; j < 16; j++)
+        if (next > i)
         {
-            std::cout << to_hex8(get8(i + j)) << " ";
-            if (j == 7)
-                std::cout << " ";
+            std::cout << to_hex32(i) << "-" << to_hex32(next - 1)
+                      << ": all " << to_hex8(fill_byte) << std::endl;
+            i = next;
+            continue;
         }
 
 
-        // Print ASCII representation between asterisks.        
-        std::cout << "*";
-        for(uint32_t j = 0; j < 16; j++)
+        dump_line(i, rd[i >> page_bits] + (i & (page_size - 1)), "");
+        i += 16;
+    }
+}
+
+
+/***************************************************************
+Function: memory::dump_diff
+
+
+Use:      Prints the ranges of 16-byte lines that differ from the
+          initial image. Each line of a range is shown as it was
+          ('-') and as it is now ('+').
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing. Output goes to std::cout.
+***************************************************************/
+void memory::dump_diff() const
+{
+    uint32_t size = get_size();
+    uint32_t addr = 0;
+    uint32_t changed_lines = 0;
+
+
+    while (true)
+    {
+        uint32_t d = find_change(addr, size);
+        if (d >= size)
+            break;
+
+
+        uint32_t start = d & ~uint32_t(15);
+        uint32_t end   = start + 16;
+        while (end < size && find_change(end, end + 16) < end + 16)
+            end += 16;
+
+
+        std::cout << to_hex32(start) << "-" << to_hex32(end - 1) << ":" << std::endl;
+        for (uint32_t line = start; line < end; line += 16)
         {
-            uint8_t ch = get8(i + j);
-            ch = isprint(ch) ? ch : '.';
-            std::cout << ch;
+            uint8_t old[16];
+            for (uint32_t j = 0; j < 16; ++j)
+                old[j] = initial_at(line + j);
+
+
+            dump_line(line, old, "- ");
+            dump_line(line, rd[line >> page_bits] + (line & (page_size - 1)), "+ ");
         }
-        std::cout << "*" << std::endl;
+
+
+        changed_lines += (end - start) / 16;
+        addr = end;
     }
+
+
+    std::cout << changed_lines << " lines differ from the loaded image" << std::endl;
 }
 
 
 /***************************************************************
-Function: memory::load_file
+Function: memory::dump_binary
 
 
-Use:      Loads a binary file into the simulated memory starting
-          at address 0. Reads bytes until EOF or until the memory
-          is full.
+Use:      Writes the whole memory, as raw bytes, to a file.
 
 
 Arguments:
-    fname - Name of the binary file to open and read.
+    fname - Output file name.
 
 
 Returns:
-    true  if the file was opened successfully and all bytes that
-          fit into memory were loaded.
-    false if the file could not be opened or if the program did
-          not fit (in which case a message "Program too big." is
-          printed and loading stops).
+    false if the file could not be written.
 ***************************************************************/
-bool memory::load_file(const std::string &fname)
+bool memory::dump_binary(const std::string &fname) const
 {
-   
-    std::ifstream infile(fname, std::ios::in|std::ios::binary);
+    std::ofstream out(fname, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Can't open file '" << fname << "' for writing." << std::endl;
+        return false;
+    }
 
 
-    if(!infile.is_open())
+    for (uint32_t p = 0; p < rd.size(); ++p)
+    {
+        uint32_t n = std::min(page_size, size - p * page_size);
+        out.write(reinterpret_cast<const char *>(rd[p]), n);
+    }
+    if (!out)
     {
-        std::cerr << "Can't open file '" << fname
-                  << "' for reading." << std::endl;
+        std::cerr << "Error writing '" << fname << "'." << std::endl;
         return false;
     }
+    return true;
+}
+
+
+/***************************************************************
+Function: memory::dump_line
+
+
+Use:      Prints one 16-byte line in the format of dump(): the
+          address, the bytes in hex, and the bytes as ASCII.
+
+
+Arguments:
+    addr   - Address of the first byte.
+    p      - The 16 bytes to show.
+    prefix - Text printed before the address.
+
+
+Returns:
+    Nothing. Output goes to std::cout.
+***************************************************************/
+void memory::dump_line(uint32_t addr, const uint8_t *p, const char *prefix) const
+{
+    std::cout << prefix << to_hex32(addr) << ": ";
+
+
+    // Print 16 bytes of hex data.
+    for(uint32_t j = 0; j < 16; j++)
+    {
+        std::cout << to_hex8(p[j]) << " ";
+        if (j == 7)
+            std::cout << " ";
+    }
+
+
+    // Print ASCII representation between asterisks.
+    std::cout << "*";
+    for(uint32_t j = 0; j < 16; j++)
+    {
+        uint8_t ch = p[j];
+        ch = isprint(ch) ? ch : '.';
+        std::cout << ch;
+    }
+    std::cout << "*" << std::endl;
+}
+
+
+/***************************************************************
+Function: memory::initial_at
+
+
+Use:      Returns the byte the initial image holds at addr.
+
+
+Arguments:
+    addr - Byte address.
 
 
-    uint8_t i;
-    infile >> std::noskipws;
-   
-    for (uint32_t addr = 0; infile >> i; ++addr)
+Returns:
+    The loaded byte, or fill_byte if nothing was loaded there.
+***************************************************************/
+uint8_t memory::initial_at(uint32_t addr) const
+{
+    const uint8_t *p = initial[addr >> page_bits].get();
+    return p ? p[addr & (page_size - 1)] : fill_byte;
+}
+
+
+/***************************************************************
+Function: memory::find_not_fill
+
+
+Use:      Finds the first address at or after from whose byte is
+          not fill_byte. Untouched pages are skipped without being
+          read.
+
+
+Arguments:
+    from - First address to check.
+
+
+Returns:
+    The address found, or the memory size if there is none.
+***************************************************************/
+uint32_t memory::find_not_fill(uint32_t from) const
+{
+    while (from < size)
     {
-        if(check_illegal(addr))
+        uint32_t p   = from >> page_bits;
+        uint32_t off = from & (page_size - 1);
+        uint32_t n   = std::min(page_size - off, size - from);
+
+
+        if (rd[p] != pristine.data())
         {
-            std::cerr << "Program too big." << std::endl;
-            infile.close();
-            return false;
+            size_t i = memscan::find_not(rd[p] + off, n, fill_byte);
+            if (i < n)
+                return from + static_cast<uint32_t>(i);
         }
+        from += n;
+    }
+    return size;
+}
 
 
-        set8(addr, i);
+/***************************************************************
+Function: memory::find_change
+
+
+Use:      Finds the first address in [from, to) whose byte differs
+          from the initial image. Only written pages can differ;
+          each is compared with its initial contents, or with the
+          pristine page, by memscan::find_diff.
+
+
+Arguments:
+    from - First address to check.
+    to   - End of the range (at most the memory size).
+
+
+Returns:
+    The first changed address, or to if there is none.
+***************************************************************/
+uint32_t memory::find_change(uint32_t from, uint32_t to) const
+{
+    to = std::min(to, get_size());
+
+
+    while (from < to)
+    {
+        uint32_t p   = from >> page_bits;
+        uint32_t off = from & (page_size - 1);
+        uint32_t n   = std::min(page_size - off, to - from);
+
+
+        if (owned[p])
+        {
+            const uint8_t *was = initial[p] ? initial[p].get() : pristine.data();
+            size_t i = memscan::find_diff(rd[p] + off, was + off, n);
+            if (i < n)
+                return from + static_cast<uint32_t>(i);
+        }
+        from += n;
     }
+    return to;
+}
+
+
+/***************************************************************
+Function: memory::load_image
+
+
+Use:      Copies an image into memory and makes it part of the
+          initial image. The bytes go into the pages' initial
+          contents, which unwritten pages read as, so they are
+          not stored twice.
 
 
-    infile.close();
+Arguments:
+    addr - Load address.
+    data - Image bytes.
+
+
+Returns:
+    false if the image does not fit in memory (nothing is
+    written).
+***************************************************************/
+bool memory::load_image(uint32_t addr, const std::vector<uint8_t> &data)
+{
+    uint32_t len = static_cast<uint32_t>(data.size());
+    if (len == 0)
+        return true;
+    if (check_illegal(addr) || check_illegal(addr + (len - 1)) || addr + (len - 1) < addr)
+        return false;
+
+
+    images.push_back({ addr, len });
+    const uint8_t *src = data.data();
+    while (len)
+    {
+        uint32_t p   = addr >> page_bits;
+        uint32_t off = addr & (page_size - 1);
+        uint32_t n   = std::min(len, page_size - off);
+        if (!initial[p])
+        {
+            initial[p].reset(new uint8_t[page_size]);
+            std::memcpy(initial[p].get(), pristine.data(), page_size);
+            if (!owned[p])
+                rd[p] = initial[p].get();
+        }
+        std::memcpy(initial[p].get() + off, src, n);
+        if (owned[p])
+            std::memcpy(owned[p].get() + off, src, n);
+        addr += n;
+        src  += n;
+        len  -= n;
+    }
     return true;
 }
-
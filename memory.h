@@ -8,6 +8,13 @@ Purpose:
     memory for RV32I programs. It supports reading and writing 8-, 16-, and
     32-bit values, reading sign-extended values, loading binary files, and
     dumping the entire memory contents for debugging and disassembly.
+
+    Memory is kept in 4 KiB pages that are allocated on their first write.
+    Until then a page reads as the shared, read-only pristine page (all
+    0xa5), so a large memory costs nothing until the program touches it.
+    A page an image is loaded into reads as its loaded contents in the
+    same way, so the loaded bytes are kept once, and a second time only
+    for the pages the program writes (for the diff dump).
 ********************************************************************************************/
 
 
@@ -16,7 +23,9 @@ Purpose:
 
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 #include "hex.h"
 
@@ -30,29 +39,65 @@ Use:   Models a simple byte-addressable memory system used by the
          - Check for illegal addresses.
          - Load, store, and sign-extend values of various sizes.
          - Load a binary program into memory.
-         - Dump the entire memory in a human-readable format.
+         - Dump the entire memory in a human-readable format, only
+           its non-pristine parts, only what changed since the
+           program was loaded, or as raw binary.
 
 
 Data:
-       mem - std::vector<uint8_t> holding the raw memory bytes.
+       size    - Memory size in bytes.
+       rd      - Per page, where to read it: its own storage, its
+                 initial contents or the pristine page.
+       owned   - Per page, its storage once it has been written.
+       initial - Per page, its contents as loaded, if an image was
+                 loaded into it; with the pristine page for the
+                 rest, the initial image.
+       images  - The (address, length) of each image loaded.
 ***************************************************************/
 class memory : public hex
 {
 public:
+    // Value of every byte that has not been loaded or stored.
+    static constexpr uint8_t fill_byte = 0xa5;
+
+
+    static constexpr uint32_t page_bits = 12;
+    static constexpr uint32_t page_size = 1u << page_bits;
 
 
     // Construct memory with size rounded up to a multiple of 16 bytes.
     explicit memory(uint32_t s);
 
 
-    // Destructor (vector automatically frees resources).
+    // Destructor (the page vectors free their storage).
     ~memory();
 
 
+    // Pages are owned; memory is not copied.
+    memory(const memory &) = delete;
+    memory &operator=(const memory &) = delete;
+
+
+    // Does the page holding addr have storage (has it been written)?
+    bool is_resident(uint32_t addr) const  { return owned[addr >> page_bits] != nullptr; }
+
+
+    // The images loaded so far, as (address, length) pairs.
+    const std::vector<std::pair<uint32_t, uint32_t>> &get_images() const
+    {
+        return images;
+    }
+
+
     // Check if an address is out of range, printing a warning if so.
     bool check_illegal(uint32_t addr) const;
 
 
+    // Stop (or resume) printing the out-of-range warnings. The
+    // accesses still fail the same way.
+    void set_quiet(bool b)  { quiet = b; }
+
+
     // Return total size of the simulated memory in bytes.
     uint32_t get_size() const;
 
@@ -93,17 +138,64 @@ public:
     void set32(uint32_t addr, uint32_t val);
 
 
+    // Copy len bytes starting at addr out of / into memory. Returns
+    // false (and copies nothing) if any part of the range is illegal.
+    bool read_block(uint32_t addr, uint8_t *buf, uint32_t len) const;
+    bool write_block(uint32_t addr, const uint8_t *buf, uint32_t len);
+
+
+    // Does the range starting at addr hold exactly buf?
+    bool same_block(uint32_t addr, const uint8_t *buf, uint32_t len) const;
+
+
     // Dump the entire contents of memory in hex and ASCII.
     void dump() const;
 
 
-    // Load a binary file into memory starting at address 0.
-    bool load_file(const std::string &fname);
+    // Like dump(), but runs of lines holding only fill_byte are
+    // shown as one summary line.
+    void dump_sparse() const;
+
+
+    // Dump only the lines that differ from the initial image, each
+    // as the old ('-') and new ('+') contents.
+    void dump_diff() const;
+
+
+    // Write the raw memory contents to a file.
+    bool dump_binary(const std::string &fname) const;
+
+
+    // Copy an image into memory at addr and make it part of the
+    // initial image dump_diff() compares against.
+    bool load_image(uint32_t addr, const std::vector<uint8_t> &data);
 
 
 private:
+    // Storage of page p, allocated (as a copy of what the page read
+    // as until then) on the first call.
+    uint8_t *writable(uint32_t p)
+    {
+        if (!owned[p])
+            materialize(p);
+        return owned[p].get();
+    }
+
+
+    void materialize(uint32_t p);
+    uint32_t find_not_fill(uint32_t from) const;
+    void dump_line(uint32_t addr, const uint8_t *p, const char *prefix) const;
+    uint8_t initial_at(uint32_t addr) const;
+    uint32_t find_change(uint32_t from, uint32_t to) const;
+
+
     // Underlying storage for the simulated memory.
-    std::vector<uint8_t> mem;
+    uint32_t size = 0;
+    bool quiet = false;
+    std::vector<const uint8_t *> rd;
+    std::vector<std::unique_ptr<uint8_t[]>> owned;
+    std::vector<std::unique_ptr<uint8_t[]>> initial;
+    std::vector<std::pair<uint32_t, uint32_t>> images;
 };
 
 
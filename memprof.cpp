@@ -0,0 +1,543 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'mem_profiler' class. A profile file consists of the
+    8-byte magic "RV32IMPF", a one-byte format version, and then:
+
+        varint  page_bits, line_bits, interval (instructions)
+        varint  number of pages, then per page, by address:
+            varint  page number delta (against the previous page + 1)
+            varint  reads, writes
+            varint  number of lines touched, then per line:
+                byte    line index within the page
+                varint  reads, writes
+        varint  number of intervals, then per interval:
+            varint  distinct lines, distinct pages touched
+        varint  number of load/store pcs, then per pc, by address:
+            varint  pc delta (against the previous pc)
+            byte    0 = load, 1 = store
+            byte    pattern (0 few, 1 constant, 2 strided, 3 irregular)
+            varint  executions
+            varint  stride, zigzag-encoded
+
+    Varints are little-endian base-128, as in replay logs.
+********************************************************************************************/
+
+
+#include "memprof.h"
+
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+
+#include "hex.h"
+#include "rv32i_decode.h"
+
+
+static const char memprof_magic[8] = { 'R','V','3','2','I','M','P','F' };
+static const uint8_t memprof_version = 1;
+
+
+/***************************************************************
+Function: put_varint
+
+
+Use:      Writes v as a little-endian base-128 varint.
+
+
+Arguments:
+    os - Output stream.
+    v  - Value to encode.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+static void put_varint(std::ostream &os, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        os.put(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    os.put(static_cast<char>(v));
+}
+
+
+/***************************************************************
+Function: mem_profiler::classify
+
+
+Use:      Names the pattern of a load/store pc's address stream.
+
+
+Arguments:
+    s - The stream state.
+
+
+Returns:
+    The pattern.
+***************************************************************/
+mem_profiler::pattern mem_profiler::classify(const pc_stream &s)
+{
+    if (s.execs < min_execs)
+        return pat_few;
+    if (s.hits < (s.execs - 2) * 9 / 10)
+        return pat_irregular;
+    return s.stride ? pat_strided : pat_constant;
+}
+
+
+/***************************************************************
+Function: mem_profiler::end_interval
+
+
+Use:      Closes the current working-set interval.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void mem_profiler::end_interval()
+{
+    intervals.push_back(cur_set);
+    cur_set = { 0, 0 };
+    in_interval = 0;
+    ++epoch;
+}
+
+
+/***************************************************************
+Function: mem_profiler::on_insn
+
+
+Use:      Counts the instruction towards the current interval and
+          the highest address used.
+
+
+Arguments:
+    pc   - Instruction address.
+    insn - Unused.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void mem_profiler::on_insn(uint32_t pc, uint32_t insn)
+{
+    (void)insn;
+    if (in_interval == interval)
+        end_interval();
+    ++in_interval;
+    top_addr = std::max<uint64_t>(top_addr, uint64_t(pc) + 4);
+}
+
+
+/***************************************************************
+Function: mem_profiler::touch_line
+
+
+Use:      Counts an access in a cache line and its page, and adds
+          them to the working set if this interval had not
+          touched them yet.
+
+
+Arguments:
+    line  - Line number (address >> line_bits).
+    store - The access is a store.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void mem_profiler::touch_line(uint32_t line, bool store)
+{
+    uint32_t page_no = line >> (page_bits - line_bits);
+    if (page_no != last_page_no)
+    {
+        last_page_no = page_no;
+        last_page    = &pages[page_no];
+    }
+
+
+    page_counts &p = *last_page;
+    uint32_t i = line & (lines_per_page - 1);
+    if (store)
+    {
+        ++p.writes;
+        ++p.line_writes[i];
+    }
+    else
+    {
+        ++p.reads;
+        ++p.line_reads[i];
+    }
+
+
+    if (p.epoch != epoch)
+    {
+        p.epoch = epoch;
+        ++cur_set.pages;
+    }
+    if (p.line_epoch[i] != epoch)
+    {
+        p.line_epoch[i] = epoch;
+        ++cur_set.lines;
+    }
+}
+
+
+/***************************************************************
+Function: mem_profiler::access
+
+
+Use:      Counts one load or store and updates its pc's stride
+          predictor.
+
+
+Arguments:
+    pc    - Instruction address.
+    addr  - Access address.
+    len   - Access size in bytes.
+    store - The access is a store.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void mem_profiler::access(uint32_t pc, uint32_t addr, uint32_t len, bool store)
+{
+    uint64_t end = uint64_t(addr) + len;
+    top_addr = std::max(top_addr, end);
+
+
+    uint32_t first = addr >> line_bits;
+    uint32_t last  = static_cast<uint32_t>((end - 1) >> line_bits);
+    touch_line(first, store);
+    if (last != first)
+        touch_line(last, store);
+
+
+    pc_stream &s = pcs[pc];
+    s.store = store;
+    if (s.execs >= 2 && addr == s.last + static_cast<uint32_t>(s.stride))
+        ++s.hits;
+    if (s.execs >= 1)
+        s.stride = static_cast<int32_t>(addr - s.last);
+    s.last = addr;
+    ++s.execs;
+}
+
+
+/***************************************************************
+Function: mem_profiler::on_load
+
+
+Use:      Profiles a load.
+
+
+Arguments:
+    pc   - Instruction address.
+    addr - Load address.
+    len  - Load size in bytes.
+    val  - Unused.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void mem_profiler::on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)val;
+    ++loads;
+    access(pc, addr, len, false);
+}
+
+
+/***************************************************************
+Function: mem_profiler::on_store
+
+
+Use:      Profiles a store.
+
+
+Arguments:
+    pc   - Instruction address.
+    addr - Store address.
+    len  - Store size in bytes.
+    val  - Unused.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void mem_profiler::on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)val;
+    ++stores;
+    access(pc, addr, len, true);
+}
+
+
+/***************************************************************
+Function: mem_profiler::write
+
+
+Use:      Writes the whole profile to a binary file.
+
+
+Arguments:
+    fname - Output file.
+
+
+Returns:
+    false (after printing why) if the file can't be written.
+***************************************************************/
+bool mem_profiler::write(const std::string &fname)
+{
+    if (!finished && in_interval)
+        end_interval();
+    finished = true;
+
+
+    std::ofstream out(fname, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cerr << "Can't open file '" << fname << "' for writing." << std::endl;
+        return false;
+    }
+
+
+    out.write(memprof_magic, sizeof(memprof_magic));
+    out.put(static_cast<char>(memprof_version));
+    put_varint(out, page_bits);
+    put_varint(out, line_bits);
+    put_varint(out, interval);
+
+
+    std::vector<uint32_t> order;
+    for (const auto &e : pages)
+        order.push_back(e.first);
+    std::sort(order.begin(), order.end());
+    put_varint(out, order.size());
+    uint32_t next = 0;
+    for (uint32_t page_no : order)
+    {
+        const page_counts &p = pages[page_no];
+        put_varint(out, page_no - next);
+        put_varint(out, p.reads);
+        put_varint(out, p.writes);
+        next = page_no + 1;
+
+
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < lines_per_page; ++i)
+            n += p.line_reads[i] || p.line_writes[i];
+        put_varint(out, n);
+        for (uint32_t i = 0; i < lines_per_page; ++i)
+        {
+            if (!p.line_reads[i] && !p.line_writes[i])
+                continue;
+            out.put(static_cast<char>(i));
+            put_varint(out, p.line_reads[i]);
+            put_varint(out, p.line_writes[i]);
+        }
+    }
+
+
+    put_varint(out, intervals.size());
+    for (const working_set &ws : intervals)
+    {
+        put_varint(out, ws.lines);
+        put_varint(out, ws.pages);
+    }
+
+
+    order.clear();
+    for (const auto &e : pcs)
+        order.push_back(e.first);
+    std::sort(order.begin(), order.end());
+    put_varint(out, order.size());
+    uint32_t prev = 0;
+    for (uint32_t pc : order)
+    {
+        const pc_stream &s = pcs[pc];
+        int64_t stride = s.stride;
+        put_varint(out, pc - prev);
+        out.put(static_cast<char>(s.store));
+        out.put(static_cast<char>(classify(s)));
+        put_varint(out, s.execs);
+        put_varint(out, static_cast<uint64_t>((stride << 1) ^ (stride >> 63)));
+        prev = pc;
+    }
+
+
+    out.close();
+    if (!out)
+    {
+        std::cerr << "Error writing file '" << fname << "'." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+/***************************************************************
+Function: mem_profiler::report
+
+
+Use:      Prints access totals, the memory size the run needed,
+          the hottest pages and lines, the working set over time
+          and the address patterns of the busiest load/store
+          instructions.
+
+
+Arguments:
+    os  - Output stream.
+    mem - Memory, to disassemble the instructions listed.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void mem_profiler::report(std::ostream &os, const memory &mem)
+{
+    const size_t top = 10;
+
+
+    if (!finished && in_interval)
+        end_interval();
+    finished = true;
+
+
+    uint64_t lines = 0;
+    std::vector<std::pair<uint64_t, uint32_t>> hot_pages, hot_lines;   // (accesses, number)
+    for (const auto &e : pages)
+    {
+        const page_counts &p = e.second;
+        hot_pages.emplace_back(p.reads + p.writes, e.first);
+        for (uint32_t i = 0; i < lines_per_page; ++i)
+        {
+            if (p.line_reads[i] || p.line_writes[i])
+            {
+                ++lines;
+                hot_lines.emplace_back(p.line_reads[i] + p.line_writes[i],
+                                       (e.first << (page_bits - line_bits)) | i);
+            }
+        }
+    }
+    auto hottest = [](const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b)
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    };
+    std::sort(hot_pages.begin(), hot_pages.end(), hottest);
+    std::sort(hot_lines.begin(), hot_lines.end(), hottest);
+
+
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+
+
+    os << "Memory profile: " << loads << " loads, " << stores << " stores, "
+       << pages.size() << " pages and " << lines << " lines touched" << std::endl;
+
+
+    uint64_t need = (top_addr + (1u << page_bits) - 1) & ~uint64_t((1u << page_bits) - 1);
+    os << "  highest address used " << hex::to_hex0x32(static_cast<uint32_t>(top_addr ? top_addr - 1 : 0))
+       << " (-m " << std::hex << need << std::dec << " would do)" << std::endl;
+
+
+    if (!hot_pages.empty())
+    {
+        os << "  " << std::left << std::setw(12) << "page" << std::right
+           << std::setw(12) << "reads" << std::setw(12) << "writes" << std::setw(8) << "lines" << std::endl;
+        for (size_t i = 0; i < hot_pages.size() && i < top; ++i)
+        {
+            const page_counts &p = pages[hot_pages[i].second];
+            uint32_t n = 0;
+            for (uint32_t l = 0; l < lines_per_page; ++l)
+                n += p.line_reads[l] || p.line_writes[l];
+            os << "  " << std::left << std::setw(12) << hex::to_hex0x32(hot_pages[i].second << page_bits)
+               << std::right << std::setw(12) << p.reads << std::setw(12) << p.writes
+               << std::setw(8) << n << std::endl;
+        }
+
+
+        os << "  " << std::left << std::setw(12) << "line" << std::right
+           << std::setw(12) << "reads" << std::setw(12) << "writes" << std::endl;
+        for (size_t i = 0; i < hot_lines.size() && i < top; ++i)
+        {
+            uint32_t line = hot_lines[i].second;
+            const page_counts &p = pages[line >> (page_bits - line_bits)];
+            uint32_t l = line & (lines_per_page - 1);
+            os << "  " << std::left << std::setw(12) << hex::to_hex0x32(line << line_bits)
+               << std::right << std::setw(12) << p.line_reads[l] << std::setw(12) << p.line_writes[l] << std::endl;
+        }
+    }
+
+
+    if (!intervals.empty())
+    {
+        working_set peak { 0, 0 };
+        uint64_t sum = 0;
+        for (const working_set &ws : intervals)
+        {
+            peak.lines = std::max(peak.lines, ws.lines);
+            peak.pages = std::max(peak.pages, ws.pages);
+            sum += ws.lines;
+        }
+        os << "  working set per " << interval << " instructions: peak " << peak.lines << " lines ("
+           << (uint64_t(peak.lines) << line_bits) << " bytes), " << peak.pages << " pages; average "
+           << double(sum) / intervals.size() << " lines over " << intervals.size() << " intervals" << std::endl;
+    }
+
+
+    static const char *const names[] = { "few", "constant", "strided", "irregular" };
+    uint64_t by_pattern[4] = {0};
+    std::vector<std::pair<uint64_t, uint32_t>> busy;
+    for (const auto &e : pcs)
+    {
+        ++by_pattern[classify(e.second)];
+        busy.emplace_back(e.second.execs, e.first);
+    }
+    std::sort(busy.begin(), busy.end(), hottest);
+
+
+    os << "  load/store pcs: " << by_pattern[pat_constant] << " constant, " << by_pattern[pat_strided]
+       << " strided, " << by_pattern[pat_irregular] << " irregular, " << by_pattern[pat_few]
+       << " too few to tell" << std::endl;
+    if (!busy.empty())
+    {
+        os << "  " << std::left << std::setw(12) << "pc" << std::right << std::setw(12) << "accesses"
+           << "  " << std::left << std::setw(10) << "pattern" << std::right << std::setw(8) << "stride"
+           << "  insn" << std::endl;
+        for (size_t i = 0; i < busy.size() && i < top; ++i)
+        {
+            const pc_stream &s = pcs[busy[i].second];
+            pattern pat = classify(s);
+            os << "  " << std::left << std::setw(12) << hex::to_hex0x32(busy[i].second) << std::right
+               << std::setw(12) << s.execs << "  " << std::left << std::setw(10) << names[pat]
+               << std::right << std::setw(8);
+            if (pat == pat_strided)
+                os << s.stride;
+            else
+                os << "-";
+            os << "  " << rv32i_decode::decode(busy[i].second, mem.get32(busy[i].second)) << std::endl;
+        }
+    }
+
+
+    os.flags(flags);
+    os.precision(precision);
+}
@@ -0,0 +1,142 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'mem_profiler' class, which records where a program's loads
+    and stores go: access counts per 4 KiB page and per 64-byte cache line,
+    split into reads and writes; the working set (distinct lines and pages
+    touched) in each interval of instructions; and, per load or store
+    instruction, whether its addresses are constant, strided or irregular.
+    The full data is written to a compact binary file and summarized as
+    text, to show which data structures are worth restructuring and how
+    much memory (-m) a program really needs.
+********************************************************************************************/
+
+
+#ifndef MEMPROF_H
+#define MEMPROF_H
+
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+#include "memory.h"
+#include "rv32i_observer.h"
+
+
+/***************************************************************
+Class: mem_profiler
+
+
+Use:   Observer that counts every load and store by page and
+       cache line, tracks the working set per interval, and
+       classifies each load/store instruction's address stream
+       with a last address + stride predictor:
+
+           constant   - the same address 90% of the time
+           strided    - last address + a fixed non-zero stride
+                        90% of the time
+           irregular  - anything else
+           few        - executed fewer than 16 times
+
+       An access that straddles a line boundary counts once in
+       each line it touches.
+
+
+Data:
+       pages     - Counters per page touched.
+       pcs       - Address stream state per load/store pc.
+       intervals - Working set (lines, pages) per interval.
+       interval  - Interval length in instructions.
+       epoch     - Number of the current interval, plus 1.
+       top_addr  - One past the highest byte fetched, loaded or
+                   stored.
+***************************************************************/
+class mem_profiler : public rv32i_observer
+{
+public:
+    static constexpr uint32_t page_bits = 12;
+    static constexpr uint32_t line_bits = 6;
+    static constexpr uint32_t lines_per_page = 1u << (page_bits - line_bits);
+
+
+    enum pattern : uint8_t { pat_few, pat_constant, pat_strided, pat_irregular };
+
+
+    explicit mem_profiler(uint64_t interval) : interval(interval) {}
+
+
+    void on_insn(uint32_t pc, uint32_t insn) override;
+    void on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+    void on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+
+
+    // Write everything to fname in the binary format described
+    // in memprof.cpp.
+    bool write(const std::string &fname);
+
+
+    // Print the summary, disassembling instructions from mem.
+    void report(std::ostream &os, const memory &mem);
+
+
+private:
+    static constexpr uint64_t min_execs = 16;
+
+
+    struct page_counts
+    {
+        uint64_t reads  = 0;
+        uint64_t writes = 0;
+        uint64_t line_reads[lines_per_page]  = {0};
+        uint64_t line_writes[lines_per_page] = {0};
+        uint32_t epoch = 0;                         // last interval touched
+        uint32_t line_epoch[lines_per_page] = {0};
+    };
+
+
+    struct pc_stream
+    {
+        bool     store = false;
+        uint64_t execs = 0;
+        uint32_t last  = 0;
+        int32_t  stride = 0;
+        uint64_t hits  = 0;                         // last + stride predicted it
+    };
+
+
+    struct working_set
+    {
+        uint32_t lines;
+        uint32_t pages;
+    };
+
+
+    void access(uint32_t pc, uint32_t addr, uint32_t len, bool store);
+    void touch_line(uint32_t line, bool store);
+    void end_interval();
+    static pattern classify(const pc_stream &s);
+
+
+    std::unordered_map<uint32_t, page_counts> pages;
+    std::unordered_map<uint32_t, pc_stream> pcs;
+    std::vector<working_set> intervals;
+    uint64_t interval;
+    uint64_t in_interval = 0;
+    uint32_t epoch = 1;
+    working_set cur_set { 0, 0 };
+    uint32_t last_page_no = ~0u;                   // one-entry page lookup cache
+    page_counts *last_page = nullptr;
+    uint64_t top_addr = 0;
+    uint64_t loads = 0, stores = 0;
+    bool finished = false;
+};
+
+
+#endif
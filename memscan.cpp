@@ -0,0 +1,362 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'memscan' kernels. The vector versions compare a block
+    of 4 vectors per step and only look for the exact byte once a block
+    fails, so a long matching run costs a load and a compare per vector.
+    The AVX2 and SSE2 versions are compiled with per-function target
+    attributes, so the rest of the program does not need -mavx2 and still
+    runs on CPUs without it. Fills are left to memset, which the C library
+    already vectorizes.
+********************************************************************************************/
+
+
+#include "memscan.h"
+
+
+#include <cstring>
+
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MEMSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+
+/***************************************************************
+Function: find_not_scalar
+
+
+Use:      Portable find_not, eight bytes at a time.
+
+
+Arguments:
+    p - Bytes to scan.
+    n - Number of bytes.
+    b - Byte value to skip.
+
+
+Returns:
+    Index of the first other byte, or n.
+***************************************************************/
+static size_t find_not_scalar(const uint8_t *p, size_t n, uint8_t b)
+{
+    const uint64_t pat = 0x0101010101010101ull * b;
+    size_t i = 0;
+
+
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        if (w != pat)
+            break;
+    }
+    while (i < n && p[i] == b)
+        ++i;
+    return i;
+}
+
+
+/***************************************************************
+Function: find_diff_scalar
+
+
+Use:      Portable find_diff, eight bytes at a time.
+
+
+Arguments:
+    a, b - Byte ranges to compare.
+    n    - Number of bytes.
+
+
+Returns:
+    Index of the first difference, or n.
+***************************************************************/
+static size_t find_diff_scalar(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+
+
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t wa, wb;
+        std::memcpy(&wa, a + i, 8);
+        std::memcpy(&wb, b + i, 8);
+        if (wa != wb)
+            break;
+    }
+    while (i < n && a[i] == b[i])
+        ++i;
+    return i;
+}
+
+
+#ifdef MEMSCAN_X86
+
+
+/***************************************************************
+Function: find_not_sse2
+
+
+Use:      find_not with 16-byte vectors.
+
+
+Arguments:
+    p - Bytes to scan.
+    n - Number of bytes.
+    b - Byte value to skip.
+
+
+Returns:
+    Index of the first other byte, or n.
+***************************************************************/
+__attribute__((target("sse2")))
+static size_t find_not_sse2(const uint8_t *p, size_t n, uint8_t b)
+{
+    const __m128i pat = _mm_set1_epi8(static_cast<char>(b));
+    size_t i = 0;
+
+
+    for (; i + 64 <= n; i += 64)
+    {
+        __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)), pat);
+        __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + 16)), pat);
+        __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + 32)), pat);
+        __m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + 48)), pat);
+        __m128i all = _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+        if (_mm_movemask_epi8(all) != 0xffff)
+            break;
+    }
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        uint32_t m = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, pat)));
+        if (m != 0xffff)
+            return i + __builtin_ctz(~m);
+    }
+    return i + find_not_scalar(p + i, n - i, b);
+}
+
+
+/***************************************************************
+Function: find_diff_sse2
+
+
+Use:      find_diff with 16-byte vectors.
+
+
+Arguments:
+    a, b - Byte ranges to compare.
+    n    - Number of bytes.
+
+
+Returns:
+    Index of the first difference, or n.
+***************************************************************/
+__attribute__((target("sse2")))
+static size_t find_diff_sse2(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+
+
+    for (; i + 64 <= n; i += 64)
+    {
+        __m128i all = _mm_set1_epi8(-1);
+        for (size_t k = 0; k < 64; k += 16)
+        {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + k));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + k));
+            all = _mm_and_si128(all, _mm_cmpeq_epi8(va, vb));
+        }
+        if (_mm_movemask_epi8(all) != 0xffff)
+            break;
+    }
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        uint32_t m = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)));
+        if (m != 0xffff)
+            return i + __builtin_ctz(~m);
+    }
+    return i + find_diff_scalar(a + i, b + i, n - i);
+}
+
+
+/***************************************************************
+Function: find_not_avx2
+
+
+Use:      find_not with 32-byte vectors.
+
+
+Arguments:
+    p - Bytes to scan.
+    n - Number of bytes.
+    b - Byte value to skip.
+
+
+Returns:
+    Index of the first other byte, or n.
+***************************************************************/
+__attribute__((target("avx2")))
+static size_t find_not_avx2(const uint8_t *p, size_t n, uint8_t b)
+{
+    const __m256i pat = _mm256_set1_epi8(static_cast<char>(b));
+    size_t i = 0;
+
+
+    for (; i + 128 <= n; i += 128)
+    {
+        __m256i e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i)), pat);
+        __m256i e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i + 32)), pat);
+        __m256i e2 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i + 64)), pat);
+        __m256i e3 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i + 96)), pat);
+        __m256i all = _mm256_and_si256(_mm256_and_si256(e0, e1), _mm256_and_si256(e2, e3));
+        if (static_cast<uint32_t>(_mm256_movemask_epi8(all)) != 0xffffffffu)
+            break;
+    }
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pat)));
+        if (m != 0xffffffffu)
+            return i + __builtin_ctz(~m);
+    }
+    return i + find_not_scalar(p + i, n - i, b);
+}
+
+
+/***************************************************************
+Function: find_diff_avx2
+
+
+Use:      find_diff with 32-byte vectors.
+
+
+Arguments:
+    a, b - Byte ranges to compare.
+    n    - Number of bytes.
+
+
+Returns:
+    Index of the first difference, or n.
+***************************************************************/
+__attribute__((target("avx2")))
+static size_t find_diff_avx2(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+
+
+    for (; i + 128 <= n; i += 128)
+    {
+        __m256i all = _mm256_set1_epi8(-1);
+        for (size_t k = 0; k < 128; k += 32)
+        {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i + k));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i + k));
+            all = _mm256_and_si256(all, _mm256_cmpeq_epi8(va, vb));
+        }
+        if (static_cast<uint32_t>(_mm256_movemask_epi8(all)) != 0xffffffffu)
+            break;
+    }
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        uint32_t m = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+        if (m != 0xffffffffu)
+            return i + __builtin_ctz(~m);
+    }
+    return i + find_diff_scalar(a + i, b + i, n - i);
+}
+
+
+#endif
+
+
+// The kernel set chosen for this CPU.
+struct kernel_set
+{
+    size_t (*find_not)(const uint8_t *, size_t, uint8_t);
+    size_t (*find_diff)(const uint8_t *, const uint8_t *, size_t);
+};
+
+
+/***************************************************************
+Function: kernels
+
+
+Use:      Picks, on the first call, the fastest kernel set the
+          host CPU supports.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    The kernel set.
+***************************************************************/
+static const kernel_set &kernels()
+{
+    static const kernel_set k = []
+    {
+#ifdef MEMSCAN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return kernel_set { find_not_avx2, find_diff_avx2 };
+        if (__builtin_cpu_supports("sse2"))
+            return kernel_set { find_not_sse2, find_diff_sse2 };
+#endif
+        return kernel_set { find_not_scalar, find_diff_scalar };
+    }();
+    return k;
+}
+
+
+/***************************************************************
+Function: memscan::find_not
+
+
+Use:      Finds the first byte that is not b.
+
+
+Arguments:
+    p - Bytes to scan.
+    n - Number of bytes.
+    b - Byte value to skip.
+
+
+Returns:
+    Index of the first other byte, or n.
+***************************************************************/
+size_t memscan::find_not(const uint8_t *p, size_t n, uint8_t b)
+{
+    return kernels().find_not(p, n, b);
+}
+
+
+/***************************************************************
+Function: memscan::find_diff
+
+
+Use:      Finds the first difference between two byte ranges.
+
+
+Arguments:
+    a, b - Byte ranges to compare.
+    n    - Number of bytes.
+
+
+Returns:
+    Index of the first difference, or n.
+***************************************************************/
+size_t memscan::find_diff(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    return kernels().find_diff(a, b, n);
+}
@@ -0,0 +1,50 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'memscan' class: the bulk scan and compare kernels used on
+    large stretches of guest memory (sparse and diff dumps, pristine-page
+    checks, snapshot page comparison). Each kernel has AVX2, SSE2 and
+    portable versions; the best one the host CPU supports is chosen once, at
+    the first call.
+********************************************************************************************/
+
+
+#ifndef MEMSCAN_H
+#define MEMSCAN_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+/***************************************************************
+Class: memscan
+
+
+Use:   Static scan and compare kernels, with no state beyond the
+       kernel set picked for this CPU.
+***************************************************************/
+class memscan
+{
+public:
+    // Index of the first byte of p[0..n) that is not b, or n.
+    static size_t find_not(const uint8_t *p, size_t n, uint8_t b);
+
+
+    // Index of the first byte at which a and b differ, or n.
+    static size_t find_diff(const uint8_t *a, const uint8_t *b, size_t n);
+
+
+    // Does every byte of p[0..n) equal b?
+    static bool all_equal(const uint8_t *p, size_t n, uint8_t b) { return find_not(p, n, b) == n; }
+
+
+    // Are a[0..n) and b[0..n) the same?
+    static bool same(const uint8_t *a, const uint8_t *b, size_t n) { return find_diff(a, b, n) == n; }
+};
+
+
+#endif
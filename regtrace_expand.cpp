@@ -0,0 +1,224 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    regtrace_expand: rebuilds full register dumps from the output of
+    'rv32i --reg-trace delta[:n]'. Full dumps in the input set the register
+    state; each delta line ("~ pc=XXXXXXXX xN=XXXXXXXX ...") updates it and
+    is replaced by the full dump -r would have printed there. Every other
+    line is copied unchanged, so the result matches the output of -r.
+
+    Usage: regtrace_expand [infile]      (reads standard input by default)
+********************************************************************************************/
+
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+
+#include "hex.h"
+
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+
+static uint32_t regs[32];
+static uint32_t pc;
+
+
+/***************************************************************
+Function: print_dump
+
+
+Use:      Prints the register state in the format of
+          rv32i_hart::dump().
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+static void print_dump()
+{
+    static const char *const labels[4] = { " x0 ", " x8 ", "x16 ", "x24 " };
+
+
+    for (int row = 0; row < 4; ++row)
+    {
+        cout << labels[row];
+        for (int i = 0; i < 8; ++i)
+        {
+            cout << hex::to_hex32(regs[row * 8 + i]);
+            if (i < 7)
+                cout << (i == 3 ? "  " : " ");
+        }
+        cout << '\n';
+    }
+    cout << " pc " << hex::to_hex32(pc) << '\n';
+}
+
+
+/***************************************************************
+Function: parse_row
+
+
+Use:      Reads the registers of one full-dump row into the state.
+
+
+Arguments:
+    line  - The row text after its 4-character label.
+    first - Number of the first register on the row.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+static void parse_row(const string &line, int first)
+{
+    std::istringstream iss(line);
+    for (int i = 0; i < 8; ++i)
+    {
+        uint32_t v;
+        if (iss >> std::hex >> v)
+            regs[first + i] = v;
+    }
+}
+
+
+/***************************************************************
+Function: apply_delta
+
+
+Use:      Applies one delta line to the state.
+
+
+Arguments:
+    line - Text after the leading "~ ".
+
+
+Returns:
+    false if the line is malformed.
+***************************************************************/
+static bool apply_delta(const string &line)
+{
+    std::istringstream iss(line);
+    string field;
+
+
+    while (iss >> field)
+    {
+        size_t eq = field.find('=');
+        if (eq == string::npos)
+            return false;
+
+
+        char *end;
+        uint32_t v = std::strtoul(field.c_str() + eq + 1, &end, 16);
+        if (*end)
+            return false;
+
+
+        if (field.compare(0, eq, "pc") == 0)
+            pc = v;
+        else if (field[0] == 'x')
+        {
+            int r = std::atoi(field.c_str() + 1);
+            if (r <= 0 || r > 31)
+                return false;
+            regs[r] = v;
+        }
+        else
+            return false;
+    }
+    return true;
+}
+
+
+/***************************************************************
+Function: main
+
+
+Use:      Copies the trace, expanding delta lines.
+
+
+Arguments:
+    argc - Number of command-line arguments.
+    argv - Argument vector (optional input file).
+
+
+Returns:
+    0 on success, 1 on an error.
+***************************************************************/
+int main(int argc, char **argv)
+{
+    std::ifstream file;
+    std::istream *in = &std::cin;
+
+
+    if (argc > 2)
+    {
+        cerr << "Usage: regtrace_expand [infile]" << endl;
+        return 1;
+    }
+    if (argc == 2)
+    {
+        file.open(argv[1]);
+        if (!file)
+        {
+            cerr << "Can't open file '" << argv[1] << "' for input." << endl;
+            return 1;
+        }
+        in = &file;
+    }
+
+
+    std::ios::sync_with_stdio(false);
+
+
+    string line;
+    uint64_t lineno = 0;
+    while (std::getline(*in, line))
+    {
+        ++lineno;
+
+
+        if (line.compare(0, 2, "~ ") == 0)
+        {
+            if (!apply_delta(line.substr(2)))
+            {
+                cerr << "Malformed delta line " << lineno << ": " << line << endl;
+                return 1;
+            }
+            print_dump();
+            continue;
+        }
+
+
+        if (line.compare(0, 4, " x0 ") == 0)
+            parse_row(line.substr(4), 0);
+        else if (line.compare(0, 4, " x8 ") == 0)
+            parse_row(line.substr(4), 8);
+        else if (line.compare(0, 4, "x16 ") == 0)
+            parse_row(line.substr(4), 16);
+        else if (line.compare(0, 4, "x24 ") == 0)
+            parse_row(line.substr(4), 24);
+        else if (line.compare(0, 4, " pc ") == 0)
+            pc = std::strtoul(line.c_str() + 4, nullptr, 16);
+
+
+        cout << line << '\n';
+    }
+    return 0;
+}
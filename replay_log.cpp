@@ -0,0 +1,383 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'replay_log' class. A log file consists of the 8-byte magic
+    "RV32IRPL", a one-byte format version, and then one record per event:
+
+        varint  instret delta (against the previous event)
+        byte    event kind
+        varint  32-bit value
+
+    Varints are little-endian base-128 (7 data bits per byte, high bit set on
+    all but the last byte). Typical records are 3-7 bytes long.
+********************************************************************************************/
+
+
+#include "replay_log.h"
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+
+
+static const char replay_magic[8] = { 'R','V','3','2','I','R','P','L' };
+static const uint8_t replay_version = 1;
+
+
+/***************************************************************
+Function: replay_log::replay_log
+
+
+Use:      Constructor. The log starts in mode::off, in which
+          input() passes every live value through unchanged.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+replay_log::replay_log()
+{
+}
+
+
+/***************************************************************
+Function: replay_log::~replay_log
+
+
+Use:      Destructor. Makes sure a record file is flushed.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+replay_log::~replay_log()
+{
+    close();
+}
+
+
+/***************************************************************
+Function: replay_log::open_record
+
+
+Use:      Creates fname, writes the file header, and switches
+          the log into record mode.
+
+
+Arguments:
+    fname - Name of the log file to create.
+
+
+Returns:
+    true on success, false (with a message on std::cerr) if the
+    file could not be created.
+***************************************************************/
+bool replay_log::open_record(const std::string &fname)
+{
+    out.open(fname, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        std::cerr << "Can't open file '" << fname
+                  << "' for writing." << std::endl;
+        return false;
+    }
+
+
+    out.write(replay_magic, sizeof(replay_magic));
+    out.put(static_cast<char>(replay_version));
+
+
+    start_record();
+    return true;
+}
+
+
+/***************************************************************
+Function: replay_log::start_record
+
+
+Use:      Switches the log into record mode. Events are kept in
+          memory and, if open_record() created one, written to
+          the record file.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void replay_log::start_record()
+{
+    events.clear();
+    cursor = 0;
+    m = live = mode::record;
+    last_instret = 0;
+    event_count  = 0;
+}
+
+
+/***************************************************************
+Function: replay_log::open_replay
+
+
+Use:      Reads and decodes the whole of fname into memory and
+          switches the log into replay mode.
+
+
+Arguments:
+    fname - Name of a log file written by open_record().
+
+
+Returns:
+    true on success, false (with a message on std::cerr) if the
+    file can't be read or is not a valid log.
+***************************************************************/
+bool replay_log::open_replay(const std::string &fname)
+{
+    std::ifstream infile(fname, std::ios::in | std::ios::binary);
+    if (!infile.is_open())
+    {
+        std::cerr << "Can't open file '" << fname
+                  << "' for reading." << std::endl;
+        return false;
+    }
+
+
+    std::vector<uint8_t> buf((std::istreambuf_iterator<char>(infile)),
+                             std::istreambuf_iterator<char>());
+
+
+    if (buf.size() < sizeof(replay_magic) + 1
+        || !std::equal(replay_magic, replay_magic + sizeof(replay_magic), buf.begin())
+        || buf[sizeof(replay_magic)] != replay_version)
+    {
+        std::cerr << "'" << fname << "' is not a replay log." << std::endl;
+        return false;
+    }
+
+
+    events.clear();
+    uint64_t instret = 0;
+    size_t pos = sizeof(replay_magic) + 1;
+    while (pos < buf.size())
+    {
+        uint64_t delta, value;
+        if (!get_varint(buf, pos, delta) || pos >= buf.size())
+            break;
+        uint8_t kind = buf[pos++];
+        if (!get_varint(buf, pos, value))
+            break;
+
+
+        instret += delta;
+        events.push_back({ instret, static_cast<uint32_t>(value), kind });
+    }
+
+
+    if (pos != buf.size())
+    {
+        std::cerr << "Replay log '" << fname << "' is truncated." << std::endl;
+        return false;
+    }
+
+
+    m = mode::replay;
+    live = mode::off;
+    cursor = 0;
+    event_count = 0;
+    return true;
+}
+
+
+/***************************************************************
+Function: replay_log::close
+
+
+Use:      Flushes and closes the record file, if any. The log
+          returns to mode::off but keeps its events in memory.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void replay_log::close()
+{
+    if (out.is_open())
+        out.close();
+    m = live = mode::off;
+}
+
+
+/***************************************************************
+Function: replay_log::rewind
+
+
+Use:      Moves the replay position back to pos. Events from pos
+          onward are replayed again; once they are used up the
+          log returns to its live mode (recording resumes where
+          it left off).
+
+
+Arguments:
+    pos - A value previously returned by position().
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void replay_log::rewind(size_t pos)
+{
+    cursor = pos < events.size() ? pos : events.size();
+    m = cursor < events.size() ? mode::replay : live;
+}
+
+
+/***************************************************************
+Function: replay_log::input
+
+
+Use:      Called by the hart each time it consumes an input whose
+          value can differ from run to run.
+            - off:    val is left as the live value.
+            - record: the live value is appended to the log.
+            - replay: val is replaced by the next logged value.
+          When replay runs out of events the log drops back to
+          its live mode: record if it is recording, otherwise off
+          (live values are used from then on).
+
+
+Arguments:
+    k       - Kind of input being consumed.
+    instret - Hart instruction counter at the point of use.
+    val     - In: the live value. Out: the value to use.
+
+
+Returns:
+    false if the next logged event was recorded at a different
+    instruction count or with a different kind (the run has
+    diverged from the recording), true otherwise.
+***************************************************************/
+bool replay_log::input(event_kind k, uint64_t instret, uint32_t &val)
+{
+    switch (m)
+    {
+    case mode::off:
+        return true;
+
+
+    case mode::record:
+        events.push_back({ instret, val, k });
+        cursor = events.size();
+        if (out.is_open())
+        {
+            put_varint(out, instret - last_instret);
+            out.put(static_cast<char>(k));
+            put_varint(out, val);
+            last_instret = instret;
+        }
+        ++event_count;
+        return true;
+
+
+    case mode::replay:
+        if (cursor >= events.size())
+        {
+            m = live;
+            if (m == mode::off)
+                std::cerr << "WARNING: replay log exhausted at instruction "
+                          << instret << "; continuing with live inputs" << std::endl;
+            return input(k, instret, val);
+        }
+
+
+        if (events[cursor].instret != instret || events[cursor].kind != k)
+        {
+            std::cerr << "ERROR: replay diverged at instruction " << instret
+                      << " (log expects kind " << int(events[cursor].kind)
+                      << " at instruction " << events[cursor].instret << ")"
+                      << std::endl;
+            return false;
+        }
+
+
+        val = events[cursor++].value;
+        ++event_count;
+        return true;
+    }
+
+
+    return true;
+}
+
+
+/***************************************************************
+Function: replay_log::put_varint
+
+
+Use:      Writes v as a little-endian base-128 varint.
+
+
+Arguments:
+    os - Output stream.
+    v  - Value to encode.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void replay_log::put_varint(std::ostream &os, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        os.put(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    os.put(static_cast<char>(v));
+}
+
+
+/***************************************************************
+Function: replay_log::get_varint
+
+
+Use:      Decodes one varint from buf starting at pos.
+
+
+Arguments:
+    buf - Encoded bytes.
+    pos - In: offset of the first byte. Out: offset just past
+          the varint.
+    v   - Decoded value.
+
+
+Returns:
+    false if the buffer ends inside the varint.
+***************************************************************/
+bool replay_log::get_varint(const std::vector<uint8_t> &buf, size_t &pos, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; pos < buf.size() && shift < 64; shift += 7)
+    {
+        uint8_t b = buf[pos++];
+        v |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,133 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'replay_log' class, which records every nondeterministic input
+    seen by a hart (device MMIO reads, host syscall results, interrupt delivery
+    points, host-clock CSR reads) and can feed them back on a later run so the
+    execution reproduces bit-for-bit.
+
+    Events are keyed by the hart's instruction counter. The on-disk form is a
+    short magic header followed by one variable-length record per event, so the
+    cost of logging grows with the number of events, never with the number of
+    instructions executed.
+********************************************************************************************/
+
+
+#ifndef REPLAY_LOG_H
+#define REPLAY_LOG_H
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+
+
+/***************************************************************
+Class: replay_log
+
+
+Use:   Source of nondeterministic inputs for a hart. In record
+       mode the live value is passed through and appended to the
+       log; in replay mode the logged value is returned instead
+       and checked against the instruction count and event kind
+       at which it was recorded.
+
+       All events are also kept in memory, so the log can be
+       rewound to an earlier position and replayed again (used
+       by the time-travel debugger when it re-executes).
+
+
+Data:
+       m        - Current mode (off, record, replay).
+       live     - Mode to fall back to once replay runs out of
+                  events (record if this log is recording).
+       events   - Every event recorded or read so far.
+       cursor   - Index of the next event to replay.
+       out      - Output stream while recording to a file.
+       last_instret - Instruction count of the previous event
+                  written to the file (records store deltas).
+***************************************************************/
+class replay_log
+{
+public:
+    enum class mode { off, record, replay };
+
+
+    // Kinds of nondeterministic input. The numeric values are part of
+    // the file format and must not be renumbered.
+    enum event_kind : uint8_t
+    {
+        ev_mmio_read = 0,       // value returned by a device register read
+        ev_syscall   = 1,       // result of an emulated host syscall
+        ev_interrupt = 2,       // interrupt delivered before this instret
+        ev_csr_read  = 3        // host-derived CSR value (e.g. time)
+    };
+
+
+    replay_log();
+    ~replay_log();
+
+
+    // Start recording to fname. Returns false if it can't be created.
+    bool open_record(const std::string &fname);
+
+
+    // Start recording into memory only (no file).
+    void start_record();
+
+
+    // Load fname and start replaying. Returns false on a bad file.
+    bool open_replay(const std::string &fname);
+
+
+    // Flush and close any record file.
+    void close();
+
+
+    mode get_mode() const { return m; }
+
+
+    // Obtain the value of one nondeterministic input. 'val' holds the
+    // live value on entry and the value to use on return. Returns false
+    // if the replayed log does not match this event (divergence).
+    bool input(event_kind k, uint64_t instret, uint32_t &val);
+
+
+    // Number of events recorded or replayed so far.
+    uint64_t get_event_count() const { return event_count; }
+
+
+    // Position of the next event. rewind() moves back to an earlier
+    // position so the events after it are replayed again.
+    size_t position() const { return cursor; }
+    void rewind(size_t pos);
+
+
+private:
+    struct event
+    {
+        uint64_t instret;
+        uint32_t value;
+        uint8_t  kind;
+    };
+
+
+    static void put_varint(std::ostream &os, uint64_t v);
+    static bool get_varint(const std::vector<uint8_t> &buf, size_t &pos, uint64_t &v);
+
+
+    mode m = mode::off;
+    mode live = mode::off;
+    std::vector<event> events;
+    size_t cursor = 0;
+    std::ofstream out;
+    uint64_t last_instret = 0;
+    uint64_t event_count  = 0;
+};
+
+
+#endif
@@ -152,16 +152,24 @@ std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
                 return render_illegal_insn();
                
             case 0b001:
-                return render_rtype(insn, "sll");  
+                if (get_funct7(insn) == 0b0000000)
+                    return render_rtype(insn, "sll");
+                return render_illegal_insn();
  
             case 0b010:
-                return render_rtype(insn, "slt");
+                if (get_funct7(insn) == 0b0000000)
+                    return render_rtype(insn, "slt");
+                return render_illegal_insn();
            
             case 0b011:
-                return render_rtype(insn, "sltu");
+                if (get_funct7(insn) == 0b0000000)
+                    return render_rtype(insn, "sltu");
+                return render_illegal_insn();
            
             case 0b100:
-                return render_rtype(insn, "xor");
+                if (get_funct7(insn) == 0b0000000)
+                    return render_rtype(insn, "xor");
+                return render_illegal_insn();
 
 
             case 0b101:
@@ -173,10 +181,14 @@ std::string rv32i_decode::decode(uint32_t addr, uint32_t insn)
 
 
             case 0b110:
-                return render_rtype(insn, "or");
+                if (get_funct7(insn) == 0b0000000)
+                    return render_rtype(insn, "or");
+                return render_illegal_insn();
            
             case 0b111:
-                return render_rtype(insn, "and");
+                if (get_funct7(insn) == 0b0000000)
+                    return render_rtype(insn, "and");
+                return render_illegal_insn();
 
 
             default:
@@ -506,6 +518,215 @@ int32_t rv32i_decode::get_imm_j(uint32_t insn)
 }
 
 
+/***************************************************************
+Function: rv32i_decode::reads_rs1
+
+
+Use:      Tells whether the instruction reads register rs1. Every
+          format but U and J does, except ecall/ebreak and the
+          immediate CSR forms, whose rs1 field is not a register.
+
+
+Arguments:
+    insn - 32-bit instruction word.
+
+
+Returns:
+    true if rs1 is a source operand.
+***************************************************************/
+bool rv32i_decode::reads_rs1(uint32_t insn)
+{
+    uint32_t opcode = get_opcode(insn);
+    if (opcode == opcode_system)
+    {
+        uint32_t f3 = get_funct3(insn);
+        return f3 >= 1 && f3 <= 3;
+    }
+    return opcode != opcode_lui && opcode != opcode_auipc && opcode != opcode_jal;
+}
+
+
+/***************************************************************
+Function: rv32i_decode::reads_rs2
+
+
+Use:      Tells whether the instruction reads register rs2 (R, S
+          and B formats).
+
+
+Arguments:
+    insn - 32-bit instruction word.
+
+
+Returns:
+    true if rs2 is a source operand.
+***************************************************************/
+bool rv32i_decode::reads_rs2(uint32_t insn)
+{
+    uint32_t opcode = get_opcode(insn);
+    return opcode == opcode_alu_reg || opcode == opcode_store || opcode == opcode_btype;
+}
+
+
+/***************************************************************
+Function: rv32i_decode::encode_r
+
+
+Use:      Builds an R-type instruction word.
+
+
+Arguments:
+    opcode, rd, funct3, rs1, rs2, funct7 - Instruction fields.
+
+
+Returns:
+    32-bit instruction word.
+***************************************************************/
+uint32_t rv32i_decode::encode_r(uint32_t opcode, uint32_t rd, uint32_t funct3,
+                                uint32_t rs1, uint32_t rs2, uint32_t funct7)
+{
+    return ((funct7 & 0x7f) << 25) | ((rs2 & 0x1f) << 20) | ((rs1 & 0x1f) << 15)
+         | ((funct3 & 0x7) << 12) | ((rd & 0x1f) << 7) | (opcode & 0x7f);
+}
+
+
+/***************************************************************
+Function: rv32i_decode::encode_i
+
+
+Use:      Builds an I-type instruction word. For the immediate
+          shifts, imm holds the shift amount in bits [4:0] and
+          funct7 in bits [11:5].
+
+
+Arguments:
+    opcode, rd, funct3, rs1 - Instruction fields.
+    imm                     - Signed 12-bit immediate.
+
+
+Returns:
+    32-bit instruction word.
+***************************************************************/
+uint32_t rv32i_decode::encode_i(uint32_t opcode, uint32_t rd, uint32_t funct3, uint32_t rs1, int32_t imm)
+{
+    return ((static_cast<uint32_t>(imm) & 0xfff) << 20) | ((rs1 & 0x1f) << 15)
+         | ((funct3 & 0x7) << 12) | ((rd & 0x1f) << 7) | (opcode & 0x7f);
+}
+
+
+/***************************************************************
+Function: rv32i_decode::encode_s
+
+
+Use:      Builds a store (S-type) instruction word.
+
+
+Arguments:
+    funct3, rs1, rs2 - Instruction fields.
+    imm              - Signed 12-bit offset.
+
+
+Returns:
+    32-bit instruction word.
+***************************************************************/
+uint32_t rv32i_decode::encode_s(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm)
+{
+    uint32_t u = static_cast<uint32_t>(imm);
+    return (((u >> 5) & 0x7f) << 25) | ((rs2 & 0x1f) << 20) | ((rs1 & 0x1f) << 15)
+         | ((funct3 & 0x7) << 12) | ((u & 0x1f) << 7) | opcode_store;
+}
+
+
+/***************************************************************
+Function: rv32i_decode::encode_b
+
+
+Use:      Builds a branch (B-type) instruction word.
+
+
+Arguments:
+    funct3, rs1, rs2 - Instruction fields.
+    imm              - Signed, even 13-bit offset.
+
+
+Returns:
+    32-bit instruction word.
+***************************************************************/
+uint32_t rv32i_decode::encode_b(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm)
+{
+    uint32_t u = static_cast<uint32_t>(imm);
+    return (((u >> 12) & 0x1) << 31) | (((u >> 5) & 0x3f) << 25) | ((rs2 & 0x1f) << 20)
+         | ((rs1 & 0x1f) << 15) | ((funct3 & 0x7) << 12) | (((u >> 1) & 0xf) << 8)
+         | (((u >> 11) & 0x1) << 7) | opcode_btype;
+}
+
+
+/***************************************************************
+Function: rv32i_decode::encode_u
+
+
+Use:      Builds a lui or auipc (U-type) instruction word.
+
+
+Arguments:
+    opcode, rd - Instruction fields.
+    imm        - Immediate with bits [11:0] clear, as get_imm_u
+                 returns it.
+
+
+Returns:
+    32-bit instruction word.
+***************************************************************/
+uint32_t rv32i_decode::encode_u(uint32_t opcode, uint32_t rd, int32_t imm)
+{
+    return (static_cast<uint32_t>(imm) & 0xfffff000) | ((rd & 0x1f) << 7) | (opcode & 0x7f);
+}
+
+
+/***************************************************************
+Function: rv32i_decode::encode_j
+
+
+Use:      Builds a jal (J-type) instruction word.
+
+
+Arguments:
+    rd  - Link register.
+    imm - Signed, even 21-bit offset.
+
+
+Returns:
+    32-bit instruction word.
+***************************************************************/
+uint32_t rv32i_decode::encode_j(uint32_t rd, int32_t imm)
+{
+    uint32_t u = static_cast<uint32_t>(imm);
+    return (((u >> 20) & 0x1) << 31) | (((u >> 1) & 0x3ff) << 21) | (((u >> 11) & 0x1) << 20)
+         | (((u >> 12) & 0xff) << 12) | ((rd & 0x1f) << 7) | opcode_jal;
+}
+
+
+/***************************************************************
+Function: rv32i_decode::is_legal
+
+
+Use:      Tells whether an instruction word is one this decoder
+          (and so the simulator) implements.
+
+
+Arguments:
+    insn - 32-bit instruction word.
+
+
+Returns:
+    false if decode() would render it as illegal.
+***************************************************************/
+bool rv32i_decode::is_legal(uint32_t insn)
+{
+    return decode(0, insn) != render_illegal_insn();
+}
+
+
 /***************************************************************
 Function: rv32i_decode::render_illegal_insn
 
@@ -63,6 +63,27 @@ public:
     static int32_t  get_imm_j(uint32_t insn);
 
 
+    // Source operands: does insn read rs1 / rs2?
+    static bool reads_rs1(uint32_t insn);
+    static bool reads_rs2(uint32_t insn);
+
+
+    // Encoders, the inverse of the field extractors. Immediates
+    // are given as the extractors return them; bits that don't
+    // fit the format are dropped.
+    static uint32_t encode_r(uint32_t opcode, uint32_t rd, uint32_t funct3,
+                             uint32_t rs1, uint32_t rs2, uint32_t funct7);
+    static uint32_t encode_i(uint32_t opcode, uint32_t rd, uint32_t funct3, uint32_t rs1, int32_t imm);
+    static uint32_t encode_s(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm);
+    static uint32_t encode_b(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t imm);
+    static uint32_t encode_u(uint32_t opcode, uint32_t rd, int32_t imm);
+    static uint32_t encode_j(uint32_t rd, int32_t imm);
+
+
+    // Does insn decode to an implemented instruction?
+    static bool is_legal(uint32_t insn);
+
+
 protected:
     // Render an illegal/unimplemented instruction.
     static std::string render_illegal_insn();
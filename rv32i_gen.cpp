@@ -0,0 +1,879 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    rv32i_gen: writes a random, valid RV32I program for stress-testing the
+    simulator. The program is built from a seed, so a failing or slow case
+    can be reproduced exactly, with a configurable instruction mix, memory
+    footprint and loop structure. Every instruction is built with the
+    encoders in rv32i_decode and checked by decoding it back, so the
+    program always means what the generator intended.
+
+    The program always terminates: branches and jumps only skip forward,
+    within the straight-line code they are part of; loops are counted
+    down in registers nothing else writes; it ends with ecall. Loads and
+    stores stay inside a data region placed after the code.
+
+    Usage: rv32i_gen [-s seed] [-n insns] [-f bin|hex] [--mix cat=weight,...]
+                     [--mem bytes] [--loops n] [--trips n] [--depth n] outfile
+********************************************************************************************/
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+
+
+#include "hex.h"
+#include "rv32i_decode.h"
+
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+
+// Registers with fixed roles; x0-x26 are the random operands.
+static constexpr uint32_t reg_data    = 31;     // data region base
+static constexpr uint32_t reg_scratch = 30;     // computed addresses, jalr bases
+static constexpr uint32_t reg_counter = 27;     // loop counters, x27-x29 by depth
+static constexpr uint32_t max_depth   = 3;
+static constexpr uint32_t random_regs = 27;
+
+
+enum category { cat_alu, cat_imm, cat_load, cat_store, cat_branch, cat_jump, categories };
+static const char *const category_names[categories] = { "alu", "imm", "load", "store", "branch", "jump" };
+
+
+struct options
+{
+    uint64_t seed    = 1;
+    uint32_t insns   = 1000;
+    uint32_t weights[categories] = { 30, 30, 15, 10, 10, 5 };
+    uint32_t mem     = 1024;
+    uint32_t loops   = 4;
+    uint32_t trips   = 10;
+    uint32_t depth   = 1;
+    bool     hex     = false;
+    string   outfile;
+};
+
+
+/***************************************************************
+Class: program
+
+
+Use:   Generates the program into a vector of instruction
+       words.
+
+       Random instructions are generated in groups: one
+       instruction, or a few for a memory access whose address
+       has to be computed first, or for an auipc/jalr pair. A
+       forward branch or jump skips a random number of whole
+       groups, so it never lands in the middle of one; its
+       offset is filled in once the group it lands on is
+       reached, or at the end of the straight-line run.
+
+
+Data:
+       opt     - Generator options.
+       rng     - Random numbers (mt19937_64, whose output is the
+                 same everywhere for a given seed).
+       code    - The program so far.
+       pending - Forward branches and jumps still to be patched.
+***************************************************************/
+class program
+{
+public:
+    explicit program(const options &opt) : opt(opt), rng(opt.seed) {}
+
+
+    void generate();
+
+
+    const std::vector<uint32_t> &get_code() const { return code; }
+    uint32_t get_data() const { return data; }
+
+
+private:
+    enum fixup_kind { fix_branch, fix_jal, fix_jalr };
+
+
+    struct fixup
+    {
+        size_t     at;                  // index of the branch or jump
+        uint32_t   groups;              // groups still to skip
+        fixup_kind kind;
+        uint32_t   funct3, rs1, rs2, rd;
+    };
+
+
+    uint32_t pick(uint32_t n)   { return static_cast<uint32_t>(rng() % n); }
+    uint32_t rs()               { return pick(random_regs); }
+    uint32_t rd()               { return 1 + pick(random_regs - 1); }
+    int32_t  imm12()            { return static_cast<int32_t>(pick(4096)) - 2048; }
+
+
+    uint32_t make_r(uint32_t opcode, uint32_t rd, uint32_t f3, uint32_t rs1, uint32_t rs2, uint32_t f7);
+    uint32_t make_i(uint32_t opcode, uint32_t rd, uint32_t f3, uint32_t rs1, int32_t imm);
+    uint32_t make_s(uint32_t f3, uint32_t rs1, uint32_t rs2, int32_t imm);
+    uint32_t make_b(uint32_t f3, uint32_t rs1, uint32_t rs2, int32_t imm);
+    uint32_t make_u(uint32_t opcode, uint32_t rd, int32_t imm);
+    uint32_t make_j(uint32_t rd, int32_t imm);
+
+
+    void group();
+    void end_group();
+    void patch(const fixup &f, size_t target);
+    void address(uint32_t size, uint32_t &base, int32_t &off);
+    void straight(uint32_t n);
+    void loop(uint32_t level, uint32_t n);
+
+
+    const options &opt;
+    std::mt19937_64 rng;
+    std::vector<uint32_t> code;
+    std::vector<fixup> pending;
+    uint32_t data = 0;
+};
+
+
+/***************************************************************
+Function: check
+
+
+Use:      Stops the generator if an instruction it built does not
+          decode to what was intended.
+
+
+Arguments:
+    ok   - The instruction decodes as intended.
+    insn - The instruction.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+static void check(bool ok, uint32_t insn)
+{
+    if (ok && rv32i_decode::is_legal(insn))
+        return;
+    cerr << "rv32i_gen: internal error: " << hex::to_hex0x32(insn) << " ("
+         << rv32i_decode::decode(0, insn) << ") does not decode as intended" << endl;
+    std::exit(2);
+}
+
+
+/***************************************************************
+Function: program::make_r / make_i / make_s / make_b / make_u /
+          make_j
+
+
+Use:      Encode an instruction of each format and check that
+          its fields decode back unchanged.
+
+
+Arguments:
+    The instruction's fields.
+
+
+Returns:
+    32-bit instruction word.
+***************************************************************/
+uint32_t program::make_r(uint32_t opcode, uint32_t rd, uint32_t f3, uint32_t rs1, uint32_t rs2, uint32_t f7)
+{
+    uint32_t insn = rv32i_decode::encode_r(opcode, rd, f3, rs1, rs2, f7);
+    check(rv32i_decode::get_opcode(insn) == opcode && rv32i_decode::get_rd(insn) == rd
+          && rv32i_decode::get_funct3(insn) == f3 && rv32i_decode::get_rs1(insn) == rs1
+          && rv32i_decode::get_rs2(insn) == rs2 && rv32i_decode::get_funct7(insn) == f7, insn);
+    return insn;
+}
+
+
+uint32_t program::make_i(uint32_t opcode, uint32_t rd, uint32_t f3, uint32_t rs1, int32_t imm)
+{
+    uint32_t insn = rv32i_decode::encode_i(opcode, rd, f3, rs1, imm);
+    check(rv32i_decode::get_opcode(insn) == opcode && rv32i_decode::get_rd(insn) == rd
+          && rv32i_decode::get_funct3(insn) == f3 && rv32i_decode::get_rs1(insn) == rs1
+          && rv32i_decode::get_imm_i(insn) == imm, insn);
+    return insn;
+}
+
+
+uint32_t program::make_s(uint32_t f3, uint32_t rs1, uint32_t rs2, int32_t imm)
+{
+    uint32_t insn = rv32i_decode::encode_s(f3, rs1, rs2, imm);
+    check(rv32i_decode::get_funct3(insn) == f3 && rv32i_decode::get_rs1(insn) == rs1
+          && rv32i_decode::get_rs2(insn) == rs2 && rv32i_decode::get_imm_s(insn) == imm, insn);
+    return insn;
+}
+
+
+uint32_t program::make_b(uint32_t f3, uint32_t rs1, uint32_t rs2, int32_t imm)
+{
+    uint32_t insn = rv32i_decode::encode_b(f3, rs1, rs2, imm);
+    check(rv32i_decode::get_funct3(insn) == f3 && rv32i_decode::get_rs1(insn) == rs1
+          && rv32i_decode::get_rs2(insn) == rs2 && rv32i_decode::get_imm_b(insn) == imm, insn);
+    return insn;
+}
+
+
+uint32_t program::make_u(uint32_t opcode, uint32_t rd, int32_t imm)
+{
+    uint32_t insn = rv32i_decode::encode_u(opcode, rd, imm);
+    check(rv32i_decode::get_opcode(insn) == opcode && rv32i_decode::get_rd(insn) == rd
+          && rv32i_decode::get_imm_u(insn) == imm, insn);
+    return insn;
+}
+
+
+uint32_t program::make_j(uint32_t rd, int32_t imm)
+{
+    uint32_t insn = rv32i_decode::encode_j(rd, imm);
+    check(rv32i_decode::get_rd(insn) == rd && rv32i_decode::get_imm_j(insn) == imm, insn);
+    return insn;
+}
+
+
+/***************************************************************
+Function: program::patch
+
+
+Use:      Fills in a forward branch or jump's offset.
+
+
+Arguments:
+    f      - The branch or jump.
+    target - Index of the instruction it goes to.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void program::patch(const fixup &f, size_t target)
+{
+    int32_t off = static_cast<int32_t>(target - f.at) * 4;
+    switch (f.kind)
+    {
+    case fix_branch:
+        code[f.at] = make_b(f.funct3, f.rs1, f.rs2, off);
+        break;
+
+
+    case fix_jal:
+        code[f.at] = make_j(f.rd, off);
+        break;
+
+
+    case fix_jalr:                      // relative to the auipc before it
+        code[f.at] = make_i(rv32i_decode::opcode_jalr, f.rd, 0, reg_scratch, off + 4);
+        break;
+    }
+}
+
+
+/***************************************************************
+Function: program::end_group
+
+
+Use:      Ends a group: patches the branches and jumps that skip
+          to the next one.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void program::end_group()
+{
+    for (size_t i = 0; i < pending.size(); )
+    {
+        if (--pending[i].groups == 0)
+        {
+            patch(pending[i], code.size());
+            pending[i] = pending.back();
+            pending.pop_back();
+        }
+        else
+            ++i;
+    }
+}
+
+
+/***************************************************************
+Function: program::address
+
+
+Use:      Picks an aligned address in the data region for an
+          access. A region of up to 2 KiB is reached directly
+          from its base register; a bigger one through an
+          address computed from a random register's top bits.
+
+
+Arguments:
+    size - Access size in bytes.
+    base - Set to the base register.
+    off  - Set to the offset.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void program::address(uint32_t size, uint32_t &base, int32_t &off)
+{
+    if (opt.mem <= 2048)
+    {
+        base = reg_data;
+        off  = static_cast<int32_t>(pick((opt.mem - size) / size + 1) * size);
+        return;
+    }
+
+
+    uint32_t bits = 31 - __builtin_clz(opt.mem);
+    uint32_t src  = rs();
+    code.push_back(make_i(rv32i_decode::opcode_alu_imm, reg_scratch, 5, src, static_cast<int32_t>(32 - bits)));    // srli
+    code.push_back(make_i(rv32i_decode::opcode_alu_imm, reg_scratch, 7, reg_scratch, -static_cast<int32_t>(size)));  // andi
+    code.push_back(make_r(rv32i_decode::opcode_alu_reg, reg_scratch, 0, reg_scratch, reg_data, 0));                  // add
+    base = reg_scratch;
+    off  = 0;
+}
+
+
+/***************************************************************
+Function: program::group
+
+
+Use:      Generates one group, of a category picked by weight.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void program::group()
+{
+    static const uint32_t alu_ops[][2] =        // funct3, funct7
+        { {0, 0}, {0, 0x20}, {1, 0}, {2, 0}, {3, 0}, {4, 0}, {5, 0}, {5, 0x20}, {6, 0}, {7, 0} };
+    static const uint32_t imm_ops[] = { 0, 2, 3, 4, 6, 7 };
+    static const uint32_t load_ops[] = { 0, 1, 2, 4, 5 };
+    static const uint32_t branch_ops[] = { 0, 1, 4, 5, 6, 7 };
+
+
+    uint32_t total = 0;
+    for (uint32_t w : opt.weights)
+        total += w;
+    uint32_t r = pick(total);
+    uint32_t cat = 0;
+    while (r >= opt.weights[cat])
+        r -= opt.weights[cat++];
+
+
+    // Random choices are made one statement at a time: the order
+    // function arguments are evaluated in is unspecified, and a seed
+    // must give the same program whatever compiled the generator.
+    fixup f {};
+    bool skip = false;
+    switch (cat)
+    {
+    case cat_alu:
+    {
+        const uint32_t *op = alu_ops[pick(10)];
+        uint32_t d  = rd();
+        uint32_t s1 = rs();
+        uint32_t s2 = rs();
+        code.push_back(make_r(rv32i_decode::opcode_alu_reg, d, op[0], s1, s2, op[1]));
+        break;
+    }
+
+
+    case cat_imm:
+    {
+        uint32_t k = pick(10);
+        uint32_t d = rd();
+        if (k < 6)
+        {
+            uint32_t s1  = rs();
+            int32_t  imm = imm12();
+            code.push_back(make_i(rv32i_decode::opcode_alu_imm, d, imm_ops[k], s1, imm));
+        }
+        else if (k < 8)                         // slli, srli/srai
+        {
+            uint32_t f3 = k == 6 ? 1 : 5;
+            uint32_t s1 = rs();
+            int32_t shamt = static_cast<int32_t>(pick(32));
+            if (f3 == 5 && pick(2))
+                shamt |= 0x400;
+            code.push_back(make_i(rv32i_decode::opcode_alu_imm, d, f3, s1, shamt));
+        }
+        else
+            code.push_back(make_u(k == 8 ? rv32i_decode::opcode_lui : rv32i_decode::opcode_auipc,
+                                  d, static_cast<int32_t>(pick(1u << 20) << 12)));
+        break;
+    }
+
+
+    case cat_load:
+    {
+        uint32_t f3 = load_ops[pick(5)];
+        uint32_t base;
+        int32_t  off;
+        address(1u << (f3 & 3), base, off);
+        uint32_t d = rd();
+        code.push_back(make_i(rv32i_decode::opcode_load, d, f3, base, off));
+        break;
+    }
+
+
+    case cat_store:
+    {
+        uint32_t f3 = pick(3);
+        uint32_t base;
+        int32_t  off;
+        address(1u << f3, base, off);
+        uint32_t s2 = rs();
+        code.push_back(make_s(f3, base, s2, off));
+        break;
+    }
+
+
+    case cat_branch:
+        f = { code.size(), 1 + pick(8), fix_branch, branch_ops[pick(6)], rs(), rs(), 0 };
+        code.push_back(make_b(f.funct3, f.rs1, f.rs2, 4));
+        skip = true;
+        break;
+
+
+    case cat_jump:
+        if (pick(3))
+        {
+            f = { code.size(), 1 + pick(8), fix_jal, 0, 0, 0, pick(2) };
+            code.push_back(make_j(f.rd, 4));
+        }
+        else
+        {
+            code.push_back(make_u(rv32i_decode::opcode_auipc, reg_scratch, 0));
+            f = { code.size(), 1 + pick(8), fix_jalr, 0, reg_scratch, 0, pick(2) };
+            code.push_back(make_i(rv32i_decode::opcode_jalr, f.rd, 0, reg_scratch, 8));
+        }
+        skip = true;
+        break;
+    }
+
+
+    end_group();
+    if (skip)
+        pending.push_back(f);
+}
+
+
+/***************************************************************
+Function: program::straight
+
+
+Use:      Generates a run of random groups, then sends any
+          branches still pending to the end of the run.
+
+
+Arguments:
+    n - Number of groups.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void program::straight(uint32_t n)
+{
+    for (uint32_t i = 0; i < n; ++i)
+        group();
+    for (const fixup &f : pending)
+        patch(f, code.size());
+    pending.clear();
+}
+
+
+/***************************************************************
+Function: program::loop
+
+
+Use:      Generates a counted loop around n groups, with loops
+          nested inside it down to the requested depth.
+
+
+Arguments:
+    level - Nesting level, 0 for the outermost.
+    n     - Number of groups in the loop, inner loops included.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void program::loop(uint32_t level, uint32_t n)
+{
+    uint32_t counter = reg_counter + level;
+    code.push_back(make_i(rv32i_decode::opcode_alu_imm, counter, 0, 0, static_cast<int32_t>(opt.trips)));
+    size_t head = code.size();
+
+
+    if (level + 1 < opt.depth)
+    {
+        straight(n / 3);
+        loop(level + 1, n / 3);
+        straight(n - 2 * (n / 3));
+    }
+    else
+        straight(n);
+
+
+    code.push_back(make_i(rv32i_decode::opcode_alu_imm, counter, 0, counter, -1));
+    int32_t back = static_cast<int32_t>(head - code.size()) * 4;
+    if (back >= -4096)
+        code.push_back(make_b(1, counter, 0, back));                // bne
+    else
+    {
+        code.push_back(make_b(0, counter, 0, 8));                   // beq over the jal
+        code.push_back(make_j(0, back - 4));
+    }
+}
+
+
+/***************************************************************
+Function: program::generate
+
+
+Use:      Generates the whole program: set up the data base and
+          random register values, the loops (or one straight run
+          if there are none), then ecall. The data region starts
+          at the first 4 KiB boundary after the code.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void program::generate()
+{
+    code.assign(2, 0);                          // lui/addi of the data base, below
+
+
+    for (uint32_t r = 1; r < random_regs; ++r)
+    {
+        code.push_back(make_u(rv32i_decode::opcode_lui, r, static_cast<int32_t>(pick(1u << 20) << 12)));
+        int32_t lo = imm12();
+        code.push_back(make_i(rv32i_decode::opcode_alu_imm, r, 0, r, lo));
+    }
+
+
+    if (opt.loops == 0)
+        straight(opt.insns);
+    for (uint32_t i = 0; i < opt.loops; ++i)
+        loop(0, opt.insns / opt.loops + (i < opt.insns % opt.loops ? 1 : 0));
+    code.push_back(0x00000073);                 // ecall
+
+
+    data = static_cast<uint32_t>((code.size() * 4 + 0xfff) & ~size_t(0xfff));
+    uint32_t hi = (data + 0x800) & 0xfffff000;
+    code[0] = make_u(rv32i_decode::opcode_lui, reg_data, static_cast<int32_t>(hi));
+    code[1] = make_i(rv32i_decode::opcode_alu_imm, reg_data, 0, reg_data, static_cast<int32_t>(data - hi));
+}
+
+
+/***************************************************************
+Function: write_hex
+
+
+Use:      Writes the program as an Intel HEX file, loaded at
+          address 0 with its entry point at 0.
+
+
+Arguments:
+    out  - Output stream.
+    code - Instruction words.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+static void write_hex(std::ostream &out, const std::vector<uint32_t> &code)
+{
+    auto record = [&](uint32_t addr, uint32_t type, const std::vector<uint8_t> &bytes)
+    {
+        uint32_t sum = static_cast<uint32_t>(bytes.size()) + (addr >> 8) + (addr & 0xff) + type;
+        out << ':' << hex::to_hex8(static_cast<uint8_t>(bytes.size()))
+            << hex::to_hex8(static_cast<uint8_t>(addr >> 8)) << hex::to_hex8(static_cast<uint8_t>(addr))
+            << hex::to_hex8(static_cast<uint8_t>(type));
+        for (uint8_t b : bytes)
+        {
+            out << hex::to_hex8(b);
+            sum += b;
+        }
+        out << hex::to_hex8(static_cast<uint8_t>(0x100 - (sum & 0xff))) << '\n';
+    };
+
+
+    std::vector<uint8_t> bytes;
+    for (uint32_t w : code)
+        for (int i = 0; i < 4; ++i)
+            bytes.push_back(static_cast<uint8_t>(w >> (8 * i)));
+
+
+    for (size_t a = 0; a < bytes.size(); a += 16)
+    {
+        if (a && (a & 0xffff) == 0)             // extended linear address
+            record(0, 4, { static_cast<uint8_t>(a >> 24), static_cast<uint8_t>(a >> 16) });
+        size_t n = std::min<size_t>(16, bytes.size() - a);
+        record(static_cast<uint32_t>(a & 0xffff), 0,
+               std::vector<uint8_t>(bytes.begin() + a, bytes.begin() + a + n));
+    }
+    record(0, 5, { 0, 0, 0, 0 });               // start linear address
+    record(0, 1, {});
+}
+
+
+/***************************************************************
+Function: usage
+
+
+Use:      Prints the usage message and exits.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Does not return.
+***************************************************************/
+static void usage()
+{
+    cerr << "Usage: rv32i_gen [-s seed] [-n insns] [-f bin|hex] [--mix cat=weight,...] "
+         << "[--mem bytes] [--loops n] [--trips n] [--depth n] outfile" << endl;
+    cerr << "  -s seed          random seed (default 1)" << endl;
+    cerr << "  -n insns         random instructions to generate (default 1000)" << endl;
+    cerr << "  -f bin|hex       raw binary (default) or Intel HEX output" << endl;
+    cerr << "  --mix ...        relative weights of alu, imm, load, store, branch and" << endl;
+    cerr << "                   jump instructions (default alu=30,imm=30,load=15," << endl;
+    cerr << "                   store=10,branch=10,jump=5)" << endl;
+    cerr << "  --mem bytes      size of the data region loads and stores use, a power" << endl;
+    cerr << "                   of two from 4 to 16M (default 1024)" << endl;
+    cerr << "  --loops n        split the code into n loops (default 4; 0 = none)" << endl;
+    cerr << "  --trips n        iterations of each loop, 1 to 2047 (default 10)" << endl;
+    cerr << "  --depth n        loop nesting depth, 1 to 3 (default 1)" << endl;
+    std::exit(1);
+}
+
+
+/***************************************************************
+Function: parse_u32
+
+
+Use:      Parses a decimal option value within limits.
+
+
+Arguments:
+    s        - Text.
+    lo, hi   - Allowed range.
+
+
+Returns:
+    The value; prints the usage message and exits if invalid.
+***************************************************************/
+static uint32_t parse_u32(const string &s, uint64_t lo, uint64_t hi)
+{
+    std::istringstream iss(s);
+    uint64_t v;
+    if (!(iss >> v) || !iss.eof() || v < lo || v > hi)
+        usage();
+    return static_cast<uint32_t>(v);
+}
+
+
+/***************************************************************
+Function: parse_mix
+
+
+Use:      Parses --mix: comma-separated category=weight pairs.
+          Categories not named keep their weight.
+
+
+Arguments:
+    s   - Option text.
+    opt - Options to update.
+
+
+Returns:
+    Nothing; prints the usage message and exits if invalid.
+***************************************************************/
+static void parse_mix(const string &s, options &opt)
+{
+    std::istringstream iss(s);
+    string item;
+    while (std::getline(iss, item, ','))
+    {
+        size_t eq = item.find('=');
+        if (eq == string::npos)
+            usage();
+        uint32_t c = 0;
+        while (c < categories && item.compare(0, eq, category_names[c]) != 0)
+            ++c;
+        if (c == categories)
+            usage();
+        opt.weights[c] = parse_u32(item.substr(eq + 1), 0, 1000000);
+    }
+
+
+    uint64_t total = 0;
+    for (uint32_t w : opt.weights)
+        total += w;
+    if (total == 0)
+        usage();
+}
+
+
+/***************************************************************
+Function: main
+
+
+Use:      Generates a program and writes it out.
+
+
+Arguments:
+    argc - Number of command-line arguments.
+    argv - Argument vector.
+
+
+Returns:
+    0 on success, 1 on an error.
+***************************************************************/
+int main(int argc, char **argv)
+{
+    options opt;
+
+
+    enum { opt_mix = 256, opt_mem, opt_loops, opt_trips, opt_depth };
+    static const struct option long_opts[] =
+    {
+        { "mix",    required_argument, nullptr, opt_mix },
+        { "mem",    required_argument, nullptr, opt_mem },
+        { "loops",  required_argument, nullptr, opt_loops },
+        { "trips",  required_argument, nullptr, opt_trips },
+        { "depth",  required_argument, nullptr, opt_depth },
+        { nullptr,  0,                 nullptr, 0 }
+    };
+
+
+    int o;
+    while ((o = getopt_long(argc, argv, "s:n:f:", long_opts, nullptr)) != -1)
+    {
+        switch (o)
+        {
+        case 's':
+        {
+            std::istringstream iss(optarg);
+            if (!(iss >> opt.seed) || !iss.eof())
+                usage();
+            break;
+        }
+
+
+        case 'n':
+            opt.insns = parse_u32(optarg, 1, 100000000);
+            break;
+
+
+        case 'f':
+            if (string(optarg) == "hex")
+                opt.hex = true;
+            else if (string(optarg) != "bin")
+                usage();
+            break;
+
+
+        case opt_mix:
+            parse_mix(optarg, opt);
+            break;
+
+
+        case opt_mem:
+            opt.mem = parse_u32(optarg, 4, 1u << 24);
+            if (opt.mem & (opt.mem - 1))
+                usage();
+            break;
+
+
+        case opt_loops:
+            opt.loops = parse_u32(optarg, 0, 1000000);
+            break;
+
+
+        case opt_trips:
+            opt.trips = parse_u32(optarg, 1, 2047);
+            break;
+
+
+        case opt_depth:
+            opt.depth = parse_u32(optarg, 1, max_depth);
+            break;
+
+
+        default:
+            usage();
+        }
+    }
+    if (optind + 1 != argc)
+        usage();
+    opt.outfile = argv[optind];
+
+
+    program prog(opt);
+    prog.generate();
+    const std::vector<uint32_t> &code = prog.get_code();
+
+
+    std::ofstream out(opt.outfile, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        cerr << "Can't open file '" << opt.outfile << "' for writing." << endl;
+        return 1;
+    }
+    if (opt.hex)
+        write_hex(out, code);
+    else
+    {
+        for (uint32_t w : code)
+        {
+            char b[4] = { char(w), char(w >> 8), char(w >> 16), char(w >> 24) };
+            out.write(b, 4);
+        }
+    }
+    out.close();
+    if (!out)
+    {
+        cerr << "Error writing file '" << opt.outfile << "'." << endl;
+        return 1;
+    }
+
+
+    cout << code.size() << " instructions written to '" << opt.outfile << "'; data at "
+         << hex::to_hex0x32(prog.get_data()) << ", run with -m "
+         << std::hex << (uint64_t(prog.get_data()) + opt.mem) << std::dec << " or more" << endl;
+    return 0;
+}
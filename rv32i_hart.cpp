@@ -21,11 +21,13 @@ Purpose:
 
 
 #include "rv32i_hart.h"
+#include "timetravel.h"
 #include "hex.h"
 
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
 
 using std::cout;
@@ -47,11 +49,16 @@ void rv32i_hart::reset()
 
 
     regs.reset();
+    delta_valid  = false;
 
 
-    // Clear CSRs
-    for (auto &c : csr)
-        c = 0;
+    // The time CSR counts microseconds from reset.
+    time_base = std::chrono::steady_clock::now();
+
+
+    csrs.reset();
+    hpm.set_history(0);
+    hpm_changed();
 }
 
 
@@ -96,6 +103,58 @@ void rv32i_hart::dump(const std::string &hdr) const
 
     std::cout << " pc " << hex::to_hex32(pc) << '\n';
 }
+/***************************************************************
+Function: rv32i_hart::dump_delta
+
+
+Use:   Register trace line for the delta mode of -r: "~ pc=..."
+       followed by "xN=..." for each register that changed since
+       the last line. A full dump() is printed instead at each
+       sync point and whenever there is nothing to compare with,
+       so regtrace_expand can rebuild the full trace.
+***************************************************************/
+void rv32i_hart::dump_delta(const std::string &hdr)
+{
+    if (!delta_valid || insn_counter % delta_sync == 0)
+    {
+        dump(hdr);
+        for (uint32_t r = 0; r < 32; ++r)
+            delta_regs[r] = regs.get(r);
+        delta_valid = true;
+        return;
+    }
+
+
+    std::cout << "~ pc=" << hex::to_hex32(pc);
+    for (uint32_t r = 1; r < 32; ++r)
+    {
+        int32_t v = regs.get(r);
+        if (v != delta_regs[r])
+        {
+            std::cout << " x" << r << '=' << hex::to_hex32(static_cast<uint32_t>(v));
+            delta_regs[r] = v;
+        }
+    }
+    std::cout << '\n';
+}
+
+
+/***************************************************************
+Function: rv32i_hart::resume
+
+
+Use:   Clear a halt so execution can continue. The next tick()
+       executes the instruction at pc even if it has a breakpoint,
+       so resuming never stops again where it just stopped.
+***************************************************************/
+void rv32i_hart::resume()
+{
+    bp_skip = true;
+    halt = false;
+    halt_reason = "none";
+}
+
+
 /***************************************************************
 Function: rv32i_hart::tick
 ***************************************************************/
@@ -106,7 +165,12 @@ void rv32i_hart::tick(const std::string &hdr)
 
 
     if (show_registers)
-        dump(hdr);
+    {
+        if (delta_sync)
+            dump_delta(hdr);
+        else
+            dump(hdr);
+    }
 
 
     // PC alignment check
@@ -118,14 +182,37 @@ void rv32i_hart::tick(const std::string &hdr)
     }
 
 
-    // Count this instruction
-    insn_counter++;
+    // Stop before executing an instruction that has a breakpoint
+    if (bps)
+    {
+        bool skip = bp_skip;
+        bp_skip = false;
+        if (!skip && bps->is_breakpoint(pc) && bps->should_stop(pc, *this, mem))
+        {
+            halt = true;
+            halt_reason = "Breakpoint";
+            return;
+        }
+    }
 
 
     // Fetch instruction from memory
     uint32_t insn = mem.get32(pc);
 
 
+    // Record what this instruction overwrites (reverse execution)
+    if (tt)
+        tt->journal(insn);
+
+
+    // Count this instruction
+    insn_counter++;
+
+
+    for (rv32i_observer *o : observers)
+        o->on_insn(pc, insn);
+
+
     if (show_instructions)
     {
         cout << hdr
@@ -140,6 +227,10 @@ void rv32i_hart::tick(const std::string &hdr)
     {
         exec(insn, nullptr);
     }
+
+
+    if (!observers.empty())
+        notify_reg_write(insn);
 }
 
 
@@ -377,6 +468,10 @@ void rv32i_hart::exec_jal(uint32_t insn, std::ostream *pos)
 
     regs.set(rd, retaddr);
     pc = target;
+
+
+    for (rv32i_observer *o : observers)
+        o->on_branch(pc_before, target, true, false);
 }
 
 
@@ -412,6 +507,10 @@ void rv32i_hart::exec_jalr(uint32_t insn, std::ostream *pos)
 
     regs.set(rd, retaddr);
     pc = target;
+
+
+    for (rv32i_observer *o : observers)
+        o->on_branch(pc_before, target, true, false);
 }
 
 
@@ -762,6 +861,14 @@ void rv32i_hart::exec_load(uint32_t insn, std::ostream *pos)
 
     regs.set(rd, loaded);
     pc += 4;
+
+
+    for (rv32i_observer *o : observers)
+        o->on_load(pc - 4, addr, 1u << (f3 & 3), static_cast<uint32_t>(loaded));
+
+
+    if (bps)
+        check_watch(addr, 1u << (f3 & 3), breakpoints::watch_read);
 }
 
 
@@ -824,6 +931,14 @@ void rv32i_hart::exec_store(uint32_t insn, std::ostream *pos)
 
 
     pc += 4;
+
+
+    for (rv32i_observer *o : observers)
+        o->on_store(pc - 4, addr, 1u << f3, rs2_u);
+
+
+    if (bps)
+        check_watch(addr, 1u << f3, breakpoints::watch_write);
 }
 
 
@@ -929,6 +1044,10 @@ void rv32i_hart::exec_branch(uint32_t insn, std::ostream *pos)
         pc = target;
     else
         pc = pc_before + 4;
+
+
+    for (rv32i_observer *o : observers)
+        o->on_branch(pc_before, target, take, true);
 }
 
 
@@ -971,14 +1090,19 @@ void rv32i_hart::exec_csrrx(uint32_t insn, std::ostream *pos,
     uint32_t csr_addr = insn >> 20;
 
 
-    if (csr_addr >= 4096)
+    // csrrs/csrrc with x0 (or zimm 0) only read the CSR.
+    const csr_file::desc *d = csr_file::lookup(csr_addr);
+    bool writes = mnemonic == "csrrw" || rs1 != 0;
+
+
+    if (!d || !csr_file::can_read(d, priv) || (writes && !csr_file::can_write(d, priv)))
     {
         exec_illegal_insn(insn, pos);
         return;
     }
 
 
-    uint32_t old_val = csr[csr_addr];
+    uint32_t old_val = csr_read(d);
     uint32_t rs1_val = static_cast<uint32_t>(regs.get(rs1));
     uint32_t new_val = old_val;
 
@@ -1004,7 +1128,12 @@ void rv32i_hart::exec_csrrx(uint32_t insn, std::ostream *pos,
     }
 
 
-    csr[csr_addr] = new_val;
+    if (writes)
+    {
+        csr_write(d, new_val);
+        if (d->h == csr_file::hook_none)
+            new_val = csrs.get(d);
+    }
 
 
     if (pos)
@@ -1050,14 +1179,19 @@ void rv32i_hart::exec_csrrxi(uint32_t insn, std::ostream *pos,
     uint32_t csr_addr = insn >> 20;
 
 
-    if (csr_addr >= 4096)
+    // csrrs/csrrc with x0 (or zimm 0) only read the CSR.
+    const csr_file::desc *d = csr_file::lookup(csr_addr);
+    bool writes = mnemonic == "csrrwi" || zimm != 0;
+
+
+    if (!d || !csr_file::can_read(d, priv) || (writes && !csr_file::can_write(d, priv)))
     {
         exec_illegal_insn(insn, pos);
         return;
     }
 
 
-    uint32_t old_val = csr[csr_addr];
+    uint32_t old_val = csr_read(d);
     uint32_t new_val = old_val;
 
 
@@ -1082,7 +1216,12 @@ void rv32i_hart::exec_csrrxi(uint32_t insn, std::ostream *pos,
     }
 
 
-    csr[csr_addr] = new_val;
+    if (writes)
+    {
+        csr_write(d, new_val);
+        if (d->h == csr_file::hook_none)
+            new_val = csrs.get(d);
+    }
 
 
     if (pos)
@@ -1113,6 +1252,249 @@ void rv32i_hart::exec_csrrxi(uint32_t insn, std::ostream *pos,
 }
 
 
+/***************************************************************
+Function: rv32i_hart::check_watch
+
+
+Use:   Halt with reason "Watchpoint" if a completed load or store
+       touched a watched range. The access has already happened
+       and pc points at the next instruction, as with hardware
+       watchpoints.
+***************************************************************/
+void rv32i_hart::check_watch(uint32_t addr, uint32_t len, breakpoints::watch_type t)
+{
+    if (bps->is_watched(addr, len, t))
+    {
+        halt = true;
+        halt_reason = "Watchpoint";
+        watch_addr = addr;
+    }
+}
+
+
+/***************************************************************
+Function: rv32i_hart::csr_read
+
+
+Use:   Read a CSR for a CSR instruction, resolving its hook. The
+       counters count the instructions retired before this one;
+       time/timeh come from the host clock and are routed through
+       nondet_input() so that a recorded run can be replayed
+       exactly.
+***************************************************************/
+uint32_t rv32i_hart::csr_read(const csr_file::desc *d)
+{
+    switch (d->h)
+    {
+    case csr_file::hook_cycle:
+    case csr_file::hook_instret:
+        return uint32_t(csrs.get_counter(d->h, insn_counter - 1));
+
+
+    case csr_file::hook_cycleh:
+    case csr_file::hook_instreth:
+        return uint32_t(csrs.get_counter(d->h, insn_counter - 1) >> 32);
+
+
+    case csr_file::hook_time:
+    case csr_file::hook_timeh:
+    {
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - time_base).count();
+
+
+        return nondet_input(replay_log::ev_csr_read,
+                            d->h == csr_file::hook_time ? uint32_t(us) : uint32_t(us >> 32));
+    }
+
+
+    case csr_file::hook_mhartid:
+        return mhartid;
+
+
+    case csr_file::hook_hpm:
+        return uint32_t(csrs.get_hpm(d->addr & 0x1f));
+
+
+    case csr_file::hook_hpmh:
+        return uint32_t(csrs.get_hpm(d->addr & 0x1f) >> 32);
+
+
+    case csr_file::hook_hpmevent:
+        return csrs.get_hpm_event(d->addr & 0x1f);
+
+
+    case csr_file::hook_hpmeventh:
+        return csrs.get_hpm_of(d->addr & 0x1f) ? 0x80000000u : 0;
+
+
+    case csr_file::hook_inhibit:
+        return csrs.get_inhibit();
+
+
+    default:
+        return csrs.get(d);
+    }
+}
+
+
+/***************************************************************
+Function: rv32i_hart::csr_write
+
+
+Use:   Write a CSR for a CSR instruction. Only the writable bits
+       of the CSR change.
+***************************************************************/
+void rv32i_hart::csr_write(const csr_file::desc *d, uint32_t val)
+{
+    switch (d->h)
+    {
+    case csr_file::hook_cycle:
+    case csr_file::hook_cycleh:
+    case csr_file::hook_instret:
+    case csr_file::hook_instreth:
+        csrs.set_counter(d->h, insn_counter - 1, val);
+        break;
+
+
+    case csr_file::hook_hpm:
+    case csr_file::hook_hpmh:
+        csrs.set_hpm(d->addr & 0x1f, d->h == csr_file::hook_hpmh, val);
+        break;
+
+
+    case csr_file::hook_hpmevent:
+        // WARL: unknown events read back as 0 (no event)
+        csrs.set_hpm_event(d->addr & 0x1f, val < hpm_unit::num_events ? val : 0);
+        hpm_changed();
+        break;
+
+
+    case csr_file::hook_hpmeventh:
+        csrs.set_hpm_of(d->addr & 0x1f, val & d->write_mask);
+        break;
+
+
+    case csr_file::hook_inhibit:
+        csrs.set_inhibit(val & d->write_mask, insn_counter - 1);
+        hpm_changed();
+        break;
+
+
+    default:
+        csrs.set(d, val);
+        break;
+    }
+}
+
+
+/***************************************************************
+Function: rv32i_hart::hpm_changed
+
+
+Use:   Rebuild the performance monitor's event masks after an
+       mhpmevent or mcountinhibit write, and attach it as an
+       observer only while some counter is counting.
+***************************************************************/
+void rv32i_hart::hpm_changed()
+{
+    hpm.rebuild();
+    remove_observer(&hpm);
+    if (hpm.is_active())
+        add_observer(&hpm);
+}
+
+
+/***************************************************************
+Function: rv32i_hart::add_observer
+
+
+Use:   Attach an observer; it is told about every instruction
+       executed from now on.
+***************************************************************/
+void rv32i_hart::add_observer(rv32i_observer *o)
+{
+    observers.push_back(o);
+}
+
+
+/***************************************************************
+Function: rv32i_hart::remove_observer
+
+
+Use:   Detach an observer previously attached.
+***************************************************************/
+void rv32i_hart::remove_observer(rv32i_observer *o)
+{
+    observers.erase(std::remove(observers.begin(), observers.end(), o),
+                    observers.end());
+}
+
+
+/***************************************************************
+Function: rv32i_hart::notify_reg_write
+
+
+Use:   Tell the observers which register, if any, the instruction
+       just executed wrote. Stores, branches, ecall/ebreak and
+       illegal instructions write none.
+***************************************************************/
+void rv32i_hart::notify_reg_write(uint32_t insn)
+{
+    uint32_t rd = get_rd(insn);
+    if (rd == 0 || (halt && halt_reason == "Illegal instruction"))
+        return;
+
+
+    switch (get_opcode(insn))
+    {
+    case opcode_lui:
+    case opcode_auipc:
+    case opcode_jal:
+    case opcode_jalr:
+    case opcode_alu_imm:
+    case opcode_alu_reg:
+    case opcode_load:
+        break;
+
+
+    case opcode_system:
+        if (get_funct3(insn) == 0)
+            return;
+        break;
+
+
+    default:
+        return;
+    }
+
+
+    uint32_t val = static_cast<uint32_t>(regs.get(rd));
+    for (rv32i_observer *o : observers)
+        o->on_reg_write(rd, val);
+}
+
+
+/***************************************************************
+Function: rv32i_hart::nondet_input
+
+
+Use:   Pass a value that is not determined by the program (host
+       clock, device reads, syscall results) through the replay
+       log, if one is attached. A mismatch against a replayed log
+       halts the hart.
+***************************************************************/
+uint32_t rv32i_hart::nondet_input(replay_log::event_kind k, uint32_t live)
+{
+    if (replay && !replay->input(k, insn_counter, live))
+    {
+        halt = true;
+        halt_reason = "Replay divergence";
+    }
+    return live;
+}
+
+
 /***************************************************************
 Function: rv32i_hart::exec_ebreak
 
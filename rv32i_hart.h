@@ -24,15 +24,29 @@ Purpose:
 #include <cstdint>
 #include <string>
 #include <ostream>
+#include <chrono>
+#include <vector>
 
 
 #include "rv32i_decode.h"
 #include "registerfile.h"
 #include "memory.h"
+#include "replay_log.h"
+#include "breakpoints.h"
+#include "csr.h"
+#include "hpm.h"
+#include "rv32i_observer.h"
+
+
+class timetravel;
 
 
 class rv32i_hart : public rv32i_decode
 {
+    // The time-travel journal reads and restores private hart state.
+    friend class timetravel;
+
+
 public:
     rv32i_hart(memory &m) : mem(m) {}
 
@@ -40,6 +54,14 @@ public:
     // Control flags
     void set_show_instructions(bool b) { show_instructions = b; }
     void set_show_registers(bool b)    { show_registers    = b; }
+    bool get_show_instructions() const { return show_instructions; }
+    bool get_show_registers() const    { return show_registers; }
+
+
+    // With show_registers, print only the registers that changed
+    // since the previous instruction, plus a full dump whenever
+    // insn_counter is a multiple of sync_interval (0 = full dumps).
+    void set_reg_trace_delta(uint32_t sync_interval) { delta_sync = sync_interval; delta_valid = false; }
 
 
     // Status
@@ -52,9 +74,34 @@ public:
     void set_mhartid(int i)                { mhartid = i; }
 
 
+    // Record/replay of nondeterministic inputs (nullptr = live inputs)
+    void set_replay_log(replay_log *r)     { replay = r; }
+
+
+    // Breakpoints and watchpoints (nullptr = none). A hart stopped by
+    // one has halt reason "Breakpoint" or "Watchpoint"; resume() lets
+    // it continue past the breakpoint it stopped on.
+    void set_breakpoints(breakpoints *b)   { bps = b; }
+    void resume();
+    uint32_t get_watch_addr() const        { return watch_addr; }
+
+
+    // Execution observers (profilers). Not owned by the hart.
+    void add_observer(rv32i_observer *o);
+    void remove_observer(rv32i_observer *o);
+
+
+    // Architectural state access for debuggers
+    uint32_t get_pc() const                { return pc; }
+    void set_pc(uint32_t addr)             { pc = addr; }
+    int32_t get_reg(uint32_t r) const      { return regs.get(r); }
+    void set_reg(uint32_t r, int32_t val)  { regs.set(r, val); }
+
+
     // Execution interface
     void tick(const std::string &hdr = "");
     void dump(const std::string &hdr = "") const;
+    void dump_delta(const std::string &hdr = "");
     void reset();
 
 
@@ -86,6 +133,14 @@ private:
     void exec_csrrxi(uint32_t insn, std::ostream *pos, const std::string &mnemonic);
     void exec_ecall(uint32_t insn, std::ostream *pos);
     void exec_ebreak(uint32_t insn, std::ostream *pos);
+    void check_watch(uint32_t addr, uint32_t len, breakpoints::watch_type t);
+
+
+    uint32_t csr_read(const csr_file::desc *d);
+    void csr_write(const csr_file::desc *d, uint32_t val);
+    void hpm_changed();
+    void notify_reg_write(uint32_t insn);
+    uint32_t nondet_input(replay_log::event_kind k, uint32_t live);
 
 
     // Hart state
@@ -98,10 +153,26 @@ private:
     uint64_t insn_counter   = 0;
     uint32_t pc             = 0;
     uint32_t mhartid        = 0;
+    uint32_t priv           = csr_file::priv_machine;
+
+
+    replay_log *replay      = nullptr;
+    timetravel *tt          = nullptr;
+    breakpoints *bps        = nullptr;
+    bool bp_skip            = false;    // resuming from a breakpoint
+    uint32_t watch_addr     = 0;        // address that hit a watchpoint
+    std::chrono::steady_clock::time_point time_base = std::chrono::steady_clock::now();
+
+
+    // Delta register trace: registers as last printed
+    uint32_t delta_sync     = 0;
+    bool delta_valid        = false;
+    int32_t delta_regs[32]  = {0};
 
 
-    // Simple CSR storage (4K CSRs is plenty for this assignment)
-    uint32_t csr[4096] = {0};
+    csr_file csrs;
+    hpm_unit hpm { csrs };
+    std::vector<rv32i_observer*> observers;
 };
 
 
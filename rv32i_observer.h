@@ -0,0 +1,68 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'rv32i_observer' interface. An observer attached to a hart
+    with rv32i_hart::add_observer() is told about each instruction as it
+    executes: the instruction itself, the register it writes, the memory it
+    reads or writes, and the control transfer it makes. Profilers and the
+    hardware performance counters are built on these hooks. A hart with no
+    observers attached pays one empty-vector test per instruction.
+********************************************************************************************/
+
+
+#ifndef RV32I_OBSERVER_H
+#define RV32I_OBSERVER_H
+
+
+#include <cstdint>
+
+
+/***************************************************************
+Class: rv32i_observer
+
+
+Use:   Base class for anything that watches execution. Every
+       hook has an empty default, so an observer overrides only
+       the events it needs.
+***************************************************************/
+class rv32i_observer
+{
+public:
+    virtual ~rv32i_observer() = default;
+
+
+    // Before insn at pc executes.
+    virtual void on_insn(uint32_t pc, uint32_t insn)                      { (void)pc; (void)insn; }
+
+
+    // After an instruction wrote val to register r (r != 0).
+    virtual void on_reg_write(uint32_t r, uint32_t val)                   { (void)r; (void)val; }
+
+
+    // After a load of len bytes from addr returned val.
+    virtual void on_load(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+    {
+        (void)pc; (void)addr; (void)len; (void)val;
+    }
+
+
+    // After a store of len bytes of val to addr.
+    virtual void on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+    {
+        (void)pc; (void)addr; (void)len; (void)val;
+    }
+
+
+    // After a conditional branch (conditional = true) or a jump
+    // (jal/jalr, always taken) at pc with the given target.
+    virtual void on_branch(uint32_t pc, uint32_t target, bool taken, bool conditional)
+    {
+        (void)pc; (void)target; (void)taken; (void)conditional;
+    }
+};
+
+
+#endif
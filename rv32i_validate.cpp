@@ -0,0 +1,494 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    rv32i_validate: checks that the decoder (rv32i_decode, which the
+    disassembler and every profiler use) and the executor (rv32i_hart,
+    which dispatches on its own) agree on which instruction words are
+    legal, by trying all 2^32 of them. The sweep is split into chunks that
+    the threads, one per core by default, take in turn.
+
+    The executor's answer comes from running the word: each thread has its
+    own memory and hart, puts the word at address 0, points every register
+    at the middle of memory and ticks once (with the out-of-range warnings
+    of loads and stores off x0 turned off). The word is illegal to the
+    executor if the hart halts with "Illegal instruction". The decoder
+    can't know which CSRs exist, so a CSR instruction it accepts but the
+    hart traps, because the CSR is not implemented or is read-only, is
+    counted apart and is not a mismatch.
+
+    Before the sweep, the throughput of each decoder (words per second
+    per core) is measured on a sample spread over the whole word space.
+
+    Usage: rv32i_validate [-j threads] [--first word] [--count n]
+                          [--bench n] [--examples n]
+********************************************************************************************/
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <getopt.h>
+
+
+#include "csr.h"
+#include "hex.h"
+#include "memory.h"
+#include "rv32i_decode.h"
+#include "rv32i_hart.h"
+
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+
+// The probe's memory: the word runs at address 0 and every register
+// but x0 holds reg_value, so a load or store off them stays in range.
+static constexpr uint32_t mem_size   = 0x2000;
+static constexpr uint32_t reg_value  = 0x1000;
+
+static constexpr uint32_t chunk_bits = 20;          // words per chunk = 2^20
+static constexpr uint32_t bench_step = 2654435761u; // odd, so i * step visits every word
+
+
+struct options
+{
+    uint32_t threads  = 0;                  // 0 = one per core
+    uint32_t first    = 0;
+    uint64_t count    = uint64_t(1) << 32;
+    uint32_t bench    = 1u << 20;
+    uint32_t examples = 20;
+};
+
+
+// How the two sides classified a word.
+enum verdict { both_legal, both_illegal, csr_trap, decoder_only, executor_only, verdicts };
+
+
+struct mismatch
+{
+    uint32_t insn;
+    verdict  v;
+};
+
+
+/***************************************************************
+Class: probe
+
+
+Use:   A memory and a hart for running single instruction
+       words. One per thread.
+***************************************************************/
+class probe
+{
+public:
+    probe() : mem(mem_size), hart(mem)
+    {
+        mem.set_quiet(true);
+        hart.reset();
+    }
+
+
+    bool illegal(uint32_t insn);
+
+
+private:
+    memory     mem;
+    rv32i_hart hart;
+};
+
+
+/***************************************************************
+Function: probe::illegal
+
+
+Use:      Runs one instruction word from a fresh pc and register
+          file. State the word changes elsewhere (memory, CSRs)
+          is left; no word's legality depends on it.
+
+
+Arguments:
+    insn - Instruction word.
+
+
+Returns:
+    true if the hart halted on it as illegal.
+***************************************************************/
+bool probe::illegal(uint32_t insn)
+{
+    mem.set32(0, insn);
+    for (uint32_t r = 1; r < 32; ++r)
+        hart.set_reg(r, reg_value);
+    hart.set_pc(0);
+    hart.resume();
+    hart.tick();
+    return hart.is_halted() && hart.get_halt_reason() == "Illegal instruction";
+}
+
+
+/***************************************************************
+Function: traps_on_csr
+
+
+Use:      Tells whether a CSR instruction names a CSR that the
+          hart, in machine mode, would refuse: one that is not
+          implemented, or a read-only one it would write.
+
+
+Arguments:
+    insn - Instruction word the decoder accepts.
+
+
+Returns:
+    true for such a CSR instruction; false for anything else.
+***************************************************************/
+static bool traps_on_csr(uint32_t insn)
+{
+    uint32_t f3 = rv32i_decode::get_funct3(insn);
+    if (rv32i_decode::get_opcode(insn) != rv32i_decode::opcode_system || (f3 & 3) == 0)
+        return false;
+
+
+    // csrrw/csrrwi always write; the others only with a nonzero rs1/zimm.
+    const csr_file::desc *d = csr_file::lookup(insn >> 20);
+    bool writes = (f3 & 3) == 1 || rv32i_decode::get_rs1(insn) != 0;
+    return !d || !csr_file::can_read(d, csr_file::priv_machine)
+           || (writes && !csr_file::can_write(d, csr_file::priv_machine));
+}
+
+
+/***************************************************************
+Function: classify
+
+
+Use:      Classifies one word by the decoder and the executor.
+
+
+Arguments:
+    p    - The thread's probe.
+    insn - Instruction word.
+
+
+Returns:
+    The verdict.
+***************************************************************/
+static verdict classify(probe &p, uint32_t insn)
+{
+    bool decoder  = rv32i_decode::is_legal(insn);
+    bool executor = !p.illegal(insn);
+
+
+    if (decoder == executor)
+        return decoder ? both_legal : both_illegal;
+    if (decoder)
+        return traps_on_csr(insn) ? csr_trap : decoder_only;
+    return executor_only;
+}
+
+
+/***************************************************************
+Function: run_threads
+
+
+Use:      Runs a function on n threads and waits for them.
+
+
+Arguments:
+    n - Number of threads.
+    f - Function, called with the thread number.
+
+
+Returns:
+    Seconds from start to the last thread finishing.
+***************************************************************/
+template <typename F>
+static double run_threads(uint32_t n, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (uint32_t t = 0; t < n; ++t)
+        pool.emplace_back(f, t);
+    for (std::thread &th : pool)
+        th.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+/***************************************************************
+Function: bench
+
+
+Use:      Measures the decoder and the executor, all threads at
+          once, each on its own n words spread over the word
+          space. Prints words per second per core.
+
+
+Arguments:
+    opt - Options.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+static void bench(const options &opt)
+{
+    cout << "Decode throughput (" << opt.bench << " words per thread, "
+         << opt.threads << " threads):" << endl;
+    cout << std::fixed << std::setprecision(2);
+
+
+    static const char *const names[] = { "rv32i_decode", "rv32i_hart" };
+    for (int impl = 0; impl < 2; ++impl)
+    {
+        std::atomic<uint32_t> sink { 0 };
+        double secs = run_threads(opt.threads, [&](uint32_t t)
+        {
+            probe p;
+            uint32_t acc = 0;
+            uint32_t word = t * (opt.bench * bench_step);
+            for (uint32_t i = 0; i < opt.bench; ++i, word += bench_step)
+                acc += impl == 0 ? rv32i_decode::is_legal(word) : !p.illegal(word);
+            sink += acc;
+        });
+        cout << "  " << std::left << std::setw(14) << names[impl] << std::right
+             << std::setw(10) << opt.bench / secs / 1e6 << " M words/s per core" << endl;
+    }
+}
+
+
+/***************************************************************
+Function: sweep
+
+
+Use:      Classifies every word of the range. Threads take
+          chunks of 2^20 words in increasing order, so each
+          thread's first mismatches are its lowest.
+
+
+Arguments:
+    opt - Options.
+
+
+Returns:
+    true if the decoder and executor agree on every word.
+***************************************************************/
+static bool sweep(const options &opt)
+{
+    uint64_t chunks = (opt.count + (uint64_t(1) << chunk_bits) - 1) >> chunk_bits;
+    std::atomic<uint64_t> next { 0 };
+    std::vector<std::vector<uint64_t>> counts(opt.threads, std::vector<uint64_t>(verdicts));
+    std::vector<std::vector<mismatch>> found(opt.threads);
+
+
+    double secs = run_threads(opt.threads, [&](uint32_t t)
+    {
+        probe p;
+        for (uint64_t c; (c = next++) < chunks; )
+        {
+            uint64_t lo = c << chunk_bits;
+            uint64_t hi = std::min(lo + (uint64_t(1) << chunk_bits), opt.count);
+            for (uint64_t i = lo; i < hi; ++i)
+            {
+                uint32_t insn = static_cast<uint32_t>(opt.first + i);
+                verdict v = classify(p, insn);
+                ++counts[t][v];
+                if ((v == decoder_only || v == executor_only) && found[t].size() < opt.examples)
+                    found[t].push_back({ insn, v });
+            }
+        }
+    });
+
+
+    uint64_t total[verdicts] = { 0 };
+    std::vector<mismatch> all;
+    for (uint32_t t = 0; t < opt.threads; ++t)
+    {
+        for (int v = 0; v < verdicts; ++v)
+            total[v] += counts[t][v];
+        all.insert(all.end(), found[t].begin(), found[t].end());
+    }
+    std::sort(all.begin(), all.end(), [](const mismatch &a, const mismatch &b) { return a.insn < b.insn; });
+    if (all.size() > opt.examples)
+        all.resize(opt.examples);
+
+
+    uint64_t mismatches = total[decoder_only] + total[executor_only];
+    cout << "Sweep " << hex::to_hex0x32(opt.first) << "-"
+         << hex::to_hex0x32(static_cast<uint32_t>(opt.first + opt.count - 1)) << ": "
+         << opt.count << " words on " << opt.threads << " threads in "
+         << std::fixed << std::setprecision(1) << secs << " s ("
+         << std::setprecision(2) << opt.count / secs / 1e6 << " M words/s)" << endl;
+    cout << "  legal to both       " << std::setw(12) << total[both_legal] << endl;
+    cout << "  illegal to both     " << std::setw(12) << total[both_illegal] << endl;
+    cout << "  CSR access traps    " << std::setw(12) << total[csr_trap]
+         << "  (decoded; the hart has no such CSR, or it is read-only)" << endl;
+    cout << "  decoder only        " << std::setw(12) << total[decoder_only]
+         << "  (decoded; the hart traps)" << endl;
+    cout << "  executor only       " << std::setw(12) << total[executor_only]
+         << "  (illegal to the decoder; the hart runs it)" << endl;
+
+
+    for (const mismatch &m : all)
+    {
+        cout << "  " << hex::to_hex0x32(m.insn) << "  "
+             << (m.v == decoder_only ? "decoder only   " : "executor only  ")
+             << rv32i_decode::decode(0, m.insn) << endl;
+    }
+
+
+    if (mismatches)
+        cout << mismatches << " mismatches" << endl;
+    else
+        cout << "Decoder and executor agree" << endl;
+    return mismatches == 0;
+}
+
+
+/***************************************************************
+Function: usage
+
+
+Use:      Prints the usage message and exits.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Does not return.
+***************************************************************/
+static void usage()
+{
+    cerr << "Usage: rv32i_validate [-j threads] [--first word] [--count n] "
+         << "[--bench n] [--examples n]" << endl;
+    cerr << "  -j threads       threads to run (default one per core)" << endl;
+    cerr << "  --first word     first word of the sweep (default 0)" << endl;
+    cerr << "  --count n        words to sweep (default 4294967296, all of them;" << endl;
+    cerr << "                   0 = no sweep)" << endl;
+    cerr << "  --bench n        words per thread for the throughput measurement" << endl;
+    cerr << "                   (default 1048576; 0 = none)" << endl;
+    cerr << "  --examples n     mismatches to list (default 20)" << endl;
+    std::exit(1);
+}
+
+
+/***************************************************************
+Function: parse_u64
+
+
+Use:      Parses an option value, decimal or 0x-prefixed hex,
+          within limits.
+
+
+Arguments:
+    s        - Text.
+    lo, hi   - Allowed range.
+
+
+Returns:
+    The value; prints the usage message and exits if invalid.
+***************************************************************/
+static uint64_t parse_u64(const string &s, uint64_t lo, uint64_t hi)
+{
+    std::istringstream iss(s);
+    iss.unsetf(std::ios::basefield);
+    uint64_t v;
+    if (!(iss >> v) || !iss.eof() || v < lo || v > hi)
+        usage();
+    return v;
+}
+
+
+/***************************************************************
+Function: main
+
+
+Use:      Measures decode throughput, then sweeps the words.
+
+
+Arguments:
+    argc - Number of command-line arguments.
+    argv - Argument vector.
+
+
+Returns:
+    0 if the decoder and executor agree, 1 on a mismatch or
+    an error.
+***************************************************************/
+int main(int argc, char **argv)
+{
+    options opt;
+
+
+    enum { opt_first = 256, opt_count, opt_bench, opt_examples };
+    static const struct option long_opts[] =
+    {
+        { "first",    required_argument, nullptr, opt_first },
+        { "count",    required_argument, nullptr, opt_count },
+        { "bench",    required_argument, nullptr, opt_bench },
+        { "examples", required_argument, nullptr, opt_examples },
+        { nullptr,    0,                 nullptr, 0 }
+    };
+
+
+    int o;
+    while ((o = getopt_long(argc, argv, "j:", long_opts, nullptr)) != -1)
+    {
+        switch (o)
+        {
+        case 'j':
+            opt.threads = static_cast<uint32_t>(parse_u64(optarg, 1, 1024));
+            break;
+
+
+        case opt_first:
+            opt.first = static_cast<uint32_t>(parse_u64(optarg, 0, 0xffffffff));
+            break;
+
+
+        case opt_count:
+            opt.count = parse_u64(optarg, 0, uint64_t(1) << 32);
+            break;
+
+
+        case opt_bench:
+            opt.bench = static_cast<uint32_t>(parse_u64(optarg, 0, 1u << 30));
+            break;
+
+
+        case opt_examples:
+            opt.examples = static_cast<uint32_t>(parse_u64(optarg, 0, 1000000));
+            break;
+
+
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+        usage();
+
+
+    if (opt.threads == 0)
+        opt.threads = std::max(1u, std::thread::hardware_concurrency());
+
+
+    if (opt.bench)
+        bench(opt);
+    if (opt.count && !sweep(opt))
+        return 1;
+    return 0;
+}
@@ -0,0 +1,287 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'stack_profiler' class. Calls and returns are noticed in
+    on_insn and acted on in on_branch, when the target is known; the stack
+    pointer is followed in on_reg_write and the heap in on_store.
+********************************************************************************************/
+
+
+#include "stackprof.h"
+
+
+#include <algorithm>
+#include <iomanip>
+
+
+#include "hex.h"
+#include "rv32i_decode.h"
+
+
+/***************************************************************
+Function: stack_profiler::stack_profiler
+
+
+Use:      Attaches the profiler to a hart. The heap is taken to
+          start at the end of the highest loaded image.
+
+
+Arguments:
+    mem  - The hart's memory, with its images loaded.
+    hart - The hart.
+***************************************************************/
+stack_profiler::stack_profiler(const memory &mem, const rv32i_hart &hart)
+    : hart(hart)
+{
+    for (const auto &img : mem.get_images())
+    {
+        uint64_t end = uint64_t(img.first) + img.second;
+        heap_base = static_cast<uint32_t>(std::max<uint64_t>(heap_base, std::min<uint64_t>(end, mem.get_size())));
+    }
+    heap_top = heap_base;
+}
+
+
+/***************************************************************
+Function: stack_profiler::leave
+
+
+Use:      Ends the innermost activation and adds its frame to its
+          function's high-water marks.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void stack_profiler::leave()
+{
+    activation a = stack.back();
+    stack.pop_back();
+
+
+    func_info &f = funcs[a.entry];
+    f.frame = std::max(f.frame, a.entry_sp - a.low);
+    if (a.low < init_sp)
+        f.depth = std::max(f.depth, init_sp - a.low);
+}
+
+
+/***************************************************************
+Function: stack_profiler::on_insn
+
+
+Use:      Starts the outermost activation at the first
+          instruction, and notes whether the instruction is a call
+          or a return.
+
+
+Arguments:
+    pc   - Instruction address.
+    insn - Instruction word.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void stack_profiler::on_insn(uint32_t pc, uint32_t insn)
+{
+    if (insns++ == 0)
+    {
+        init_sp = sp = low_sp = static_cast<uint32_t>(hart.get_reg(2));
+        stack.push_back({ pc, sp, sp });
+        funcs[pc].calls = 1;
+        deepest = { pc };
+    }
+
+
+    uint32_t opcode = rv32i_decode::get_opcode(insn);
+    if (opcode != rv32i_decode::opcode_jal && opcode != rv32i_decode::opcode_jalr)
+    {
+        call = ret = false;
+        return;
+    }
+
+
+    uint32_t rd  = rv32i_decode::get_rd(insn);
+    uint32_t rs1 = rv32i_decode::get_rs1(insn);
+    call = rd == 1 || rd == 5;
+    ret  = !call && rd == 0 && opcode == rv32i_decode::opcode_jalr && (rs1 == 1 || rs1 == 5);
+}
+
+
+/***************************************************************
+Function: stack_profiler::on_reg_write
+
+
+Use:      Follows the stack pointer, recording the call chain
+          each time it reaches a new low.
+
+
+Arguments:
+    r   - Register written.
+    val - Value written.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void stack_profiler::on_reg_write(uint32_t r, uint32_t val)
+{
+    if (r != 2)
+        return;
+
+
+    sp = val;
+    activation &a = stack.back();
+    a.low = std::min(a.low, sp);
+    if (sp < low_sp)
+    {
+        low_sp = sp;
+        deepest.clear();
+        for (const activation &s : stack)
+            deepest.push_back(s.entry);
+    }
+}
+
+
+/***************************************************************
+Function: stack_profiler::on_store
+
+
+Use:      Raises the heap's high-water mark for a store above the
+          images and below the stack.
+
+
+Arguments:
+    pc   - Store address (unused).
+    addr - Address stored to.
+    len  - Bytes stored.
+    val  - Value stored (unused).
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void stack_profiler::on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val)
+{
+    (void)pc;
+    (void)val;
+    if (addr >= heap_base && addr < sp)
+        heap_top = std::max(heap_top, addr + len);
+}
+
+
+/***************************************************************
+Function: stack_profiler::on_branch
+
+
+Use:      Starts an activation for a call and ends one for a
+          return. A return with no call to match (e.g. from the
+          program's entry point) is ignored.
+
+
+Arguments:
+    pc          - Jump address (unused).
+    target      - Jump target.
+    taken       - Always true for a jump (unused).
+    conditional - A conditional branch (else a jump).
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void stack_profiler::on_branch(uint32_t pc, uint32_t target, bool taken, bool conditional)
+{
+    (void)pc;
+    (void)taken;
+    if (conditional)
+        return;
+
+
+    if (call)
+    {
+        stack.push_back({ target, sp, sp });
+        ++funcs[target].calls;
+    }
+    else if (ret && stack.size() > 1)
+    {
+        leave();
+    }
+}
+
+
+/***************************************************************
+Function: stack_profiler::report
+
+
+Use:      Prints the stack's and heap's high-water marks, the
+          deepest call chain and the functions with the deepest
+          stacks.
+
+
+Arguments:
+    os  - Output stream.
+    top - Most functions to list.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void stack_profiler::report(std::ostream &os, uint32_t top)
+{
+    while (!stack.empty())
+        leave();
+
+
+    std::vector<std::pair<uint32_t, const func_info *>> rows;
+    for (const auto &e : funcs)
+        rows.emplace_back(e.first, &e.second);
+    std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b)
+    {
+        if (a.second->depth != b.second->depth)
+            return a.second->depth > b.second->depth;
+        return a.first < b.first;
+    });
+
+
+    std::ios_base::fmtflags flags = os.flags();
+
+
+    uint32_t used = init_sp - std::min(low_sp, init_sp);
+    os << "Stack profile: " << insns << " instructions, " << funcs.size() << " functions" << std::endl;
+    os << "  initial sp:     " << hex::to_hex0x32(init_sp) << std::endl;
+    os << "  lowest sp:      " << hex::to_hex0x32(low_sp) << " (" << used << " bytes of stack)" << std::endl;
+    os << "  heap:           " << hex::to_hex0x32(heap_base) << "-" << hex::to_hex0x32(heap_top)
+       << " (" << (heap_top - heap_base) << " bytes written above the images)" << std::endl;
+    if (low_sp > heap_top)
+        os << "  headroom:       " << (low_sp - heap_top) << " bytes between heap and stack" << std::endl;
+    else
+        os << "  headroom:       none, the stack reached the heap" << std::endl;
+
+
+    os << "  deepest chain:  ";
+    for (size_t i = 0; i < deepest.size(); ++i)
+        os << (i ? " > " : "") << hex::to_hex0x32(deepest[i]);
+    os << std::endl;
+
+
+    if (!rows.empty())
+        os << "  " << std::left << std::setw(12) << "function" << std::right << std::setw(12) << "calls"
+           << std::setw(10) << "frame" << std::setw(10) << "depth" << std::endl;
+    for (size_t i = 0; i < rows.size() && i < top; ++i)
+    {
+        const func_info &f = *rows[i].second;
+        os << "  " << std::left << std::setw(12) << hex::to_hex0x32(rows[i].first) << std::right
+           << std::setw(12) << f.calls << std::setw(10) << f.frame << std::setw(10) << f.depth << std::endl;
+    }
+
+
+    os.flags(flags);
+}
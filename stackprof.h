@@ -0,0 +1,116 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'stack_profiler' class, which measures how much memory a
+    program really needs for its stack and heap: the lowest the stack
+    pointer goes below its initial value, the deepest call chain, each
+    function's stack high-water mark, and how far the program's data grows
+    up from its loaded images. For sizing the RAM of an embedded target.
+********************************************************************************************/
+
+
+#ifndef STACKPROF_H
+#define STACKPROF_H
+
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+
+#include "memory.h"
+#include "rv32i_hart.h"
+#include "rv32i_observer.h"
+
+
+/***************************************************************
+Class: stack_profiler
+
+
+Use:   Observer that follows the stack pointer (x2) through its
+       writes only, so instructions that do not write x2 cost a
+       decode of their opcode and nothing more.
+
+       Calls and returns are recognised by the usual link
+       registers (a jal or jalr that links through ra or t0 is a
+       call, the jump target being the function; jalr x0 through
+       ra or t0 is a return), giving a stack of activations. Each
+       one keeps the lowest sp reached while it was innermost;
+       when it returns, that gives its function's own frame size
+       (sp at entry - lowest sp) and depth (initial sp - lowest
+       sp). The call chain is saved each time sp reaches a new
+       low.
+
+       There are no brk/sbrk system calls to watch, so the heap
+       is measured from its stores: the highest byte written
+       above the loaded images and below the current sp.
+
+
+Data:
+       funcs     - Per function entry: calls, frame, depth.
+       stack     - Activations in progress, innermost last.
+       deepest   - Function entries of the call chain at the
+                   lowest sp.
+       init_sp   - sp when the first instruction ran.
+       low_sp    - Lowest sp seen.
+       heap_base - End of the highest loaded image.
+       heap_top  - End of the highest byte stored between
+                   heap_base and sp.
+***************************************************************/
+class stack_profiler : public rv32i_observer
+{
+public:
+    stack_profiler(const memory &mem, const rv32i_hart &hart);
+
+
+    void on_insn(uint32_t pc, uint32_t insn) override;
+    void on_reg_write(uint32_t r, uint32_t val) override;
+    void on_store(uint32_t pc, uint32_t addr, uint32_t len, uint32_t val) override;
+    void on_branch(uint32_t pc, uint32_t target, bool taken, bool conditional) override;
+
+
+    // Print the stack and heap usage and up to top functions by
+    // stack depth.
+    void report(std::ostream &os, uint32_t top);
+
+
+private:
+    struct func_info
+    {
+        uint64_t calls = 0;
+        uint32_t frame = 0;             // most bytes below sp at entry
+        uint32_t depth = 0;             // most bytes below init_sp
+    };
+
+
+    struct activation
+    {
+        uint32_t  entry;                // function entry
+        uint32_t  entry_sp;
+        uint32_t  low;                  // lowest sp while innermost
+    };
+
+
+    void leave();
+
+
+    const rv32i_hart &hart;
+    std::unordered_map<uint32_t, func_info> funcs;
+    std::vector<activation> stack;
+    std::vector<uint32_t> deepest;
+    uint64_t insns     = 0;
+    uint32_t init_sp   = 0;
+    uint32_t sp        = 0;
+    uint32_t low_sp    = 0;
+    uint32_t heap_base = 0;
+    uint32_t heap_top  = 0;
+    bool     call      = false;         // current insn is a call
+    bool     ret       = false;         // current insn is a return
+};
+
+
+#endif
@@ -0,0 +1,675 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'timetravel' class (reverse execution through an undo log
+    plus copy-on-write snapshots). See timetravel.h for an overview.
+
+    Restoring snapshot i writes back the pages saved by every snapshot from the
+    newest down to i; the oldest copy of a page wins, which leaves memory as it
+    was when snapshot i was taken.
+********************************************************************************************/
+
+
+#include "timetravel.h"
+#include "rv32i_hart.h"
+#include "memory.h"
+
+
+#include <algorithm>
+
+
+/***************************************************************
+Function: timetravel::timetravel
+
+
+Use:      Constructor. Nothing is journalled until attach().
+
+
+Arguments:
+    h                 - Hart to journal.
+    m                 - The hart's memory.
+    snapshot_interval - Instructions between snapshots.
+    max_snaps         - Snapshot count that triggers thinning.
+    undo_lim          - Maximum length of the undo log.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+timetravel::timetravel(rv32i_hart &h, memory &m, uint64_t snapshot_interval,
+                       size_t max_snaps, size_t undo_lim)
+    : hart(h), mem(m),
+      interval(snapshot_interval ? snapshot_interval : 1),
+      max_snapshots(max_snaps < 2 ? 2 : max_snaps),
+      undo_limit(undo_lim)
+{
+}
+
+
+/***************************************************************
+Function: timetravel::attach
+
+
+Use:      Hooks the journal into the hart. The base snapshot is
+          taken when the first instruction is journalled, so any
+          set-up done between attach() and running is included.
+          If the hart has no replay log one is supplied so that
+          nondeterministic inputs can be replayed when
+          re-executing.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void timetravel::attach()
+{
+    npages = (mem.get_size() + page_size - 1) / page_size;
+    snaps.clear();
+    undo.clear();
+    csr_undo.clear();
+
+
+    if (!hart.replay)
+    {
+        own_log.start_record();
+        hart.replay = &own_log;
+    }
+
+
+    next_snapshot = hart.insn_counter;
+    hart.tt = this;
+}
+
+
+/***************************************************************
+Function: timetravel::forget
+
+
+Use:      Discards the snapshots and the undo log. The next
+          instruction journalled takes a new base snapshot. Used
+          when the state is changed other than by execution, which
+          restoring older history would silently undo.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void timetravel::forget()
+{
+    snaps.clear();
+    undo.clear();
+    csr_undo.clear();
+    next_snapshot = hart.insn_counter;
+}
+
+
+/***************************************************************
+Function: timetravel::journal
+
+
+Use:      Records what insn is about to overwrite. Only the
+          register named by the rd field, the bytes covered by a
+          store, and the CSRs (for a CSR write) can change, so
+          that is all an undo record holds. Takes a snapshot when
+          one is due and saves any page a store is about to dirty.
+
+
+Arguments:
+    insn - The instruction the hart is about to execute.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void timetravel::journal(uint32_t insn)
+{
+    if (hart.insn_counter >= next_snapshot)
+        take_snapshot();
+
+
+    undo_rec u;
+    u.pc         = hart.pc;
+    u.rd         = static_cast<uint8_t>(rv32i_decode::get_rd(insn));
+    u.rd_val     = hart.regs.get(u.rd);
+    u.replay_pos = hart.replay ? hart.replay->position() : 0;
+    u.kind       = undo_none;
+    u.addr       = 0;
+    u.old        = 0;
+    u.size       = 0;
+
+
+    uint32_t opcode = rv32i_decode::get_opcode(insn);
+    uint32_t f3     = rv32i_decode::get_funct3(insn);
+
+
+    if (opcode == rv32i_decode::opcode_store && f3 <= 0b010)
+    {
+        u.kind = undo_store;
+        u.size = static_cast<uint8_t>(1u << f3);
+        u.addr = static_cast<uint32_t>(hart.regs.get(rv32i_decode::get_rs1(insn)))
+                 + rv32i_decode::get_imm_s(insn);
+
+
+        for (uint32_t i = 0; i < u.size; ++i)
+        {
+            uint32_t a = u.addr + i;
+            if (a < mem.get_size())
+            {
+                u.old |= uint32_t(mem.get8(a)) << (8 * i);
+                save_page(a / page_size);
+            }
+        }
+    }
+    else if (opcode == rv32i_decode::opcode_system && f3 != 0
+             && (f3 == 0b001 || f3 == 0b101 || rv32i_decode::get_rs1(insn) != 0))
+    {
+        // A CSR write can change several counters at once (mcountinhibit),
+        // so the whole CSR file is kept. CSR writes are rare.
+        u.kind = undo_csr;
+        csr_undo.push_back(hart.csrs);
+    }
+
+
+    // Performance counters change on every instruction while counting;
+    // only snapshots (which re-execute) can go back then.
+    if (hart.hpm.is_active())
+    {
+        undo.clear();
+        csr_undo.clear();
+        return;
+    }
+
+
+    undo.push_back(u);
+    if (undo.size() > undo_limit)
+    {
+        if (undo.front().kind == undo_csr)
+            csr_undo.pop_front();
+        undo.pop_front();
+    }
+}
+
+
+/***************************************************************
+Function: timetravel::reverse_step
+
+
+Use:      Moves the hart back by one instruction.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    false if the hart is already at the earliest reachable
+    state, true otherwise.
+***************************************************************/
+bool timetravel::reverse_step()
+{
+    if (hart.insn_counter <= get_earliest())
+        return false;
+    return reverse_to(hart.insn_counter - 1);
+}
+
+
+/***************************************************************
+Function: timetravel::reverse_to
+
+
+Use:      Puts the hart into the state it had just before
+          instruction number insn_count executed. Uses the undo
+          log when it reaches far enough back; otherwise restores
+          the nearest earlier snapshot and re-executes.
+
+
+Arguments:
+    insn_count - Target value of the instruction counter.
+
+
+Returns:
+    true on success, false if insn_count is in the future or
+    older than the earliest snapshot.
+***************************************************************/
+bool timetravel::reverse_to(uint64_t insn_count)
+{
+    if (insn_count > hart.insn_counter || insn_count < get_earliest())
+        return false;
+
+
+    if (insn_count >= hart.insn_counter - undo.size())
+    {
+        while (hart.insn_counter > insn_count)
+            undo_one();
+        return true;
+    }
+
+
+    size_t i = snaps.size();
+    while (i > 0 && snaps[i - 1].insn_counter > insn_count)
+        --i;
+    if (i == 0)
+        return false;
+
+
+    restore_snapshot(i - 1);
+    run_forward(insn_count);
+    return hart.insn_counter == insn_count;
+}
+
+
+/***************************************************************
+Function: timetravel::reverse_continue
+
+
+Use:      Runs backwards until stop() holds. The undo log is
+          searched first; after that each earlier snapshot
+          interval is re-executed forward once, remembering the
+          last state at which stop() held, so the search costs
+          one forward pass per interval rather than one per
+          instruction.
+
+
+Arguments:
+    stop - Predicate on the current hart state.
+
+
+Returns:
+    true if a stopping state was found (the hart is left there),
+    false if the earliest state was reached first.
+***************************************************************/
+bool timetravel::reverse_continue(const std::function<bool()> &stop)
+{
+    while (!undo.empty())
+    {
+        undo_one();
+        if (stop())
+            return true;
+    }
+
+
+    uint64_t hi = hart.insn_counter;
+    while (hi > get_earliest())
+    {
+        size_t i = snaps.size();
+        while (i > 0 && snaps[i - 1].insn_counter >= hi)
+            --i;
+        if (i == 0)
+            break;
+
+
+        uint64_t seg_start = snaps[i - 1].insn_counter;
+        restore_snapshot(i - 1);
+
+
+        bool found = false;
+        uint64_t found_at = 0;
+        while (true)
+        {
+            if (stop())
+            {
+                found = true;
+                found_at = hart.insn_counter;
+            }
+            if (hart.insn_counter + 1 >= hi)
+                break;
+            run_forward(hart.insn_counter + 1);
+        }
+
+
+        if (found)
+            return reverse_to(found_at);
+
+
+        hi = seg_start;
+    }
+
+
+    reverse_to(get_earliest());
+    return false;
+}
+
+
+/***************************************************************
+Function: timetravel::get_earliest
+
+
+Use:      Returns the oldest instruction count still reachable,
+          which is that of the oldest snapshot.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Instruction count of the oldest reachable state.
+***************************************************************/
+uint64_t timetravel::get_earliest() const
+{
+    return snaps.empty() ? hart.insn_counter : snaps.front().insn_counter;
+}
+
+
+/***************************************************************
+Function: timetravel::get_memory_usage
+
+
+Use:      Estimates the memory held by the history.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Approximate size in bytes.
+***************************************************************/
+size_t timetravel::get_memory_usage() const
+{
+    size_t n = undo.size() * sizeof(undo_rec) + csr_undo.size() * sizeof(csr_file);
+    for (const snapshot &s : snaps)
+    {
+        n += sizeof(snapshot) + s.saved.size() / 8;
+        n += s.pages.size() * (page_size + sizeof(s.pages[0]));
+    }
+    return n;
+}
+
+
+/***************************************************************
+Function: timetravel::take_snapshot
+
+
+Use:      Captures the non-memory hart state. Memory pages are
+          added later by save_page() as they are first written.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void timetravel::take_snapshot()
+{
+    snapshot s;
+    s.insn_counter = hart.insn_counter;
+    s.pc           = hart.pc;
+    s.regs         = hart.regs;
+    s.csrs         = hart.csrs;
+    s.hpm_history  = hart.hpm.get_history();
+    s.replay_pos   = hart.replay ? hart.replay->position() : 0;
+    s.saved.assign(npages, false);
+    snaps.push_back(std::move(s));
+
+
+    if (snaps.size() > max_snapshots)
+        thin_snapshots();
+
+
+    next_snapshot = snaps.back().insn_counter + interval;
+}
+
+
+/***************************************************************
+Function: timetravel::save_page
+
+
+Use:      Copy-on-write: saves a page into the newest snapshot
+          the first time it is about to be modified.
+
+
+Arguments:
+    page - Page number (address / page_size).
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void timetravel::save_page(uint32_t page)
+{
+    snapshot &s = snaps.back();
+    if (s.saved[page])
+        return;
+
+
+    uint32_t base = page * page_size;
+    uint32_t len  = std::min<uint32_t>(page_size, mem.get_size() - base);
+
+
+    std::vector<uint8_t> data(len);
+    mem.read_block(base, data.data(), len);
+    s.pages.emplace_back(page, std::move(data));
+    s.saved[page] = true;
+}
+
+
+/***************************************************************
+Function: timetravel::restore_snapshot
+
+
+Use:      Returns the hart and memory to snapshot i. Newer
+          snapshots and the undo log describe a future that is
+          about to be re-executed, so they are dropped.
+
+
+Arguments:
+    i - Index into snaps.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void timetravel::restore_snapshot(size_t i)
+{
+    for (size_t j = snaps.size(); j-- > i; )
+    {
+        // A page that was stored to but ends up unchanged (e.g. a
+        // stack frame rewritten with the same values) needs no copy.
+        for (const auto &p : snaps[j].pages)
+        {
+            uint32_t len = static_cast<uint32_t>(p.second.size());
+            if (!mem.same_block(p.first * page_size, p.second.data(), len))
+                mem.write_block(p.first * page_size, p.second.data(), len);
+        }
+    }
+
+
+    snaps.resize(i + 1);
+    snapshot &s = snaps[i];
+    s.pages.clear();
+    s.saved.assign(npages, false);
+
+
+    hart.insn_counter = s.insn_counter;
+    hart.pc           = s.pc;
+    hart.regs         = s.regs;
+    hart.csrs         = s.csrs;
+    hart.hpm.set_history(s.hpm_history);
+    hart.hpm_changed();
+    hart.halt         = false;
+    hart.halt_reason  = "none";
+    hart.delta_valid  = false;
+    if (hart.replay)
+        hart.replay->rewind(s.replay_pos);
+
+
+    undo.clear();
+    csr_undo.clear();
+    next_snapshot = s.insn_counter + interval;
+}
+
+
+/***************************************************************
+Function: timetravel::thin_snapshots
+
+
+Use:      Keeps the snapshot count bounded by folding every
+          second snapshot into its predecessor and doubling the
+          interval. The predecessor inherits any page it had not
+          saved itself; such a page was unchanged between the two
+          snapshots, so the folded copy is also correct for it.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void timetravel::thin_snapshots()
+{
+    std::vector<snapshot> kept;
+    for (size_t i = 0; i < snaps.size(); ++i)
+    {
+        if (i % 2 == 0)
+        {
+            kept.push_back(std::move(snaps[i]));
+            continue;
+        }
+
+
+        snapshot &prev = kept.back();
+        for (auto &p : snaps[i].pages)
+        {
+            if (!prev.saved[p.first])
+            {
+                prev.saved[p.first] = true;
+                prev.pages.push_back(std::move(p));
+            }
+        }
+    }
+
+
+    // The newest snapshot keeps collecting pages, so its bitmap must
+    // reflect every page saved since it was taken.
+    snaps.swap(kept);
+    interval *= 2;
+}
+
+
+/***************************************************************
+Function: timetravel::undo_one
+
+
+Use:      Pops the newest undo record and applies it.
+
+
+Arguments:
+    None.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void timetravel::undo_one()
+{
+    const undo_rec &u = undo.back();
+
+
+    hart.regs.set(u.rd, u.rd_val);
+
+
+    if (u.kind == undo_store)
+    {
+        for (uint32_t i = 0; i < u.size; ++i)
+        {
+            if (u.addr + i < mem.get_size())
+                mem.set8(u.addr + i, static_cast<uint8_t>(u.old >> (8 * i)));
+        }
+    }
+    else if (u.kind == undo_csr)
+    {
+        hart.csrs = csr_undo.back();
+        csr_undo.pop_back();
+        hart.hpm_changed();
+    }
+
+
+    hart.pc = u.pc;
+    hart.insn_counter--;
+    hart.halt = false;
+    hart.halt_reason = "none";
+    hart.delta_valid = false;
+    if (hart.replay)
+        hart.replay->rewind(u.replay_pos);
+
+
+    undo.pop_back();
+
+
+    // Snapshots taken after this point describe a state we are no
+    // longer in. Schedule the next one from the latest left, so they
+    // are retaken when execution passes them again.
+    if (snaps.size() > 1 && snaps.back().insn_counter > hart.insn_counter)
+    {
+        while (snaps.size() > 1 && snaps.back().insn_counter > hart.insn_counter)
+            snaps.pop_back();
+        next_snapshot = snaps.back().insn_counter + interval;
+    }
+}
+
+
+/***************************************************************
+Function: timetravel::run_forward
+
+
+Use:      Re-executes silently, ignoring breakpoints, until the
+          instruction counter reaches insn_count (or the hart
+          halts).
+
+
+Arguments:
+    insn_count - Instruction count to stop at.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void timetravel::run_forward(uint64_t insn_count)
+{
+    bool si = hart.show_instructions;
+    bool sr = hart.show_registers;
+    breakpoints *b = hart.bps;
+    hart.show_instructions = false;
+    hart.show_registers    = false;
+    hart.bps               = nullptr;
+
+
+    // Profilers already saw these instructions; only the performance
+    // counters, which the snapshot rolled back, must see them again.
+    std::vector<rv32i_observer*> obs;
+    obs.swap(hart.observers);
+    if (hart.hpm.is_active())
+        hart.observers.push_back(&hart.hpm);
+
+
+    while (hart.insn_counter < insn_count && !hart.halt)
+        hart.tick();
+
+
+    hart.show_instructions = si;
+    hart.show_registers    = sr;
+    hart.bps               = b;
+
+
+    // hpm may have been switched on or off by the code re-executed
+    obs.erase(std::remove(obs.begin(), obs.end(), &hart.hpm), obs.end());
+    if (hart.hpm.is_active())
+        obs.push_back(&hart.hpm);
+    hart.observers.swap(obs);
+}
@@ -0,0 +1,166 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'timetravel' class, which lets a hart run backwards. While the
+    hart executes it keeps:
+
+      - a bounded undo log holding, for each recent instruction, the values it
+        is about to overwrite (rd, the bytes of a store, the CSRs), so stepping
+        back one instruction is a constant-time pop, and
+      - periodic snapshots of the hart state. Memory is captured copy-on-write:
+        a snapshot saves a page only the first time that page is stored to
+        after the snapshot was taken.
+
+    Any earlier instruction count is reached either by popping the undo log or
+    by restoring the nearest earlier snapshot and re-executing forward.
+    Nondeterministic inputs are replayed from the hart's replay_log so the
+    re-execution follows the original run exactly.
+********************************************************************************************/
+
+
+#ifndef TIMETRAVEL_H
+#define TIMETRAVEL_H
+
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include <utility>
+
+
+#include "registerfile.h"
+#include "replay_log.h"
+#include "csr.h"
+
+
+class rv32i_hart;
+class memory;
+
+
+/***************************************************************
+Class: timetravel
+
+
+Use:   Reverse execution for one hart. Construct it, call attach()
+       before running, and then use reverse_step(), reverse_to()
+       or reverse_continue() whenever the hart is stopped.
+
+
+Data:
+       hart, mem      - The hart being journalled and its memory.
+       interval       - Instructions between snapshots. Doubles
+                        each time the snapshot count is thinned.
+       max_snapshots  - Snapshot count that triggers thinning.
+       undo_limit     - Maximum undo log length.
+       snaps          - Snapshots, oldest first.
+       undo           - Undo records, oldest first.
+       next_snapshot  - Instruction count of the next snapshot.
+       own_log        - Replay log used if the hart has none.
+***************************************************************/
+class timetravel
+{
+public:
+    static constexpr uint32_t page_size = 4096;
+
+
+    timetravel(rv32i_hart &h, memory &m, uint64_t snapshot_interval,
+               size_t max_snapshots, size_t undo_limit);
+
+
+    // Start journalling the hart from its current state.
+    void attach();
+
+
+    // Discard all history; the current state becomes the oldest
+    // reachable one. For when something other than execution (a
+    // debugger) changes registers or memory.
+    void forget();
+
+
+    // Called by the hart just before it executes insn.
+    void journal(uint32_t insn);
+
+
+    // Step back one instruction. false if already at the oldest
+    // reachable state.
+    bool reverse_step();
+
+
+    // Reconstruct the state at an earlier instruction count. false if
+    // the count is outside the recorded history.
+    bool reverse_to(uint64_t insn_count);
+
+
+    // Step back until stop() is true for the current state or the
+    // oldest state is reached. Returns true if stop() matched.
+    bool reverse_continue(const std::function<bool()> &stop);
+
+
+    // Earliest instruction count that can still be reached.
+    uint64_t get_earliest() const;
+
+
+    // Approximate bytes held by snapshots and the undo log.
+    size_t get_memory_usage() const;
+
+
+private:
+    enum : uint8_t { undo_none, undo_store, undo_csr };
+
+
+    struct undo_rec
+    {
+        uint32_t pc;
+        int32_t  rd_val;        // old value of the rd-field register
+        uint32_t addr;          // store address
+        uint32_t old;           // old store bytes
+        size_t   replay_pos;    // replay log position before the insn
+        uint8_t  rd;
+        uint8_t  kind;
+        uint8_t  size;          // store width in bytes
+    };
+
+
+    struct snapshot
+    {
+        uint64_t insn_counter;
+        uint32_t pc;
+        registerfile regs;
+        csr_file csrs;
+        uint32_t hpm_history;
+        size_t replay_pos;
+        std::vector<bool> saved;        // page already copied?
+        std::vector<std::pair<uint32_t, std::vector<uint8_t>>> pages;
+    };
+
+
+    void take_snapshot();
+    void save_page(uint32_t page);
+    void restore_snapshot(size_t i);
+    void thin_snapshots();
+    void undo_one();
+    void run_forward(uint64_t insn_count);
+
+
+    rv32i_hart &hart;
+    memory &mem;
+    uint64_t interval;
+    size_t max_snapshots;
+    size_t undo_limit;
+    uint32_t npages = 0;
+
+
+    std::vector<snapshot> snaps;
+    std::deque<undo_rec> undo;
+    std::deque<csr_file> csr_undo;      // CSR file before each undo_csr
+    uint64_t next_snapshot = 0;
+    replay_log own_log;
+};
+
+
+#endif
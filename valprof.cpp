@@ -0,0 +1,231 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Implements the 'value_profiler' class. An instruction is picked for
+    profiling by its opcode in on_insn, and its result is taken from the
+    register write that follows.
+********************************************************************************************/
+
+
+#include "valprof.h"
+
+
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+
+#include "hex.h"
+#include "rv32i_decode.h"
+
+
+/***************************************************************
+Function: value_profiler::record
+
+
+Use:      Adds one result to an instruction's sketch and stride
+          detector.
+
+
+Arguments:
+    p   - The instruction's profile.
+    val - The result.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void value_profiler::record(profile &p, uint32_t val)
+{
+    if (p.execs >= 2 && val == p.last + static_cast<uint32_t>(p.stride))
+        ++p.stride_hits;
+    if (p.execs >= 1)
+        p.stride = static_cast<int32_t>(val - p.last);
+    p.last = val;
+    ++p.execs;
+
+
+    uint32_t min = 0;
+    for (uint32_t i = 0; i < p.used; ++i)
+    {
+        if (p.value[i] == val)
+        {
+            ++p.count[i];
+            return;
+        }
+        if (p.count[i] < p.count[min])
+            min = i;
+    }
+
+
+    if (p.used < top_k)
+    {
+        p.value[p.used] = val;
+        p.count[p.used] = 1;
+        p.error[p.used] = 0;
+        ++p.used;
+    }
+    else
+    {
+        p.value[min] = val;
+        p.error[min] = p.count[min];
+        ++p.count[min];
+    }
+}
+
+
+/***************************************************************
+Function: value_profiler::on_insn
+
+
+Use:      Selects the profile for a load or ALU instruction.
+
+
+Arguments:
+    pc   - Instruction address.
+    insn - Instruction word.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void value_profiler::on_insn(uint32_t pc, uint32_t insn)
+{
+    uint32_t opcode = rv32i_decode::get_opcode(insn);
+    if (opcode == rv32i_decode::opcode_load
+        || opcode == rv32i_decode::opcode_alu_imm
+        || opcode == rv32i_decode::opcode_alu_reg)
+        cur = &profiles[pc];
+    else
+        cur = nullptr;
+}
+
+
+/***************************************************************
+Function: value_profiler::on_reg_write
+
+
+Use:      Records the current instruction's result.
+
+
+Arguments:
+    r   - Unused.
+    val - The result.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void value_profiler::on_reg_write(uint32_t r, uint32_t val)
+{
+    (void)r;
+    if (cur)
+    {
+        record(*cur, val);
+        cur = nullptr;
+    }
+}
+
+
+/***************************************************************
+Function: value_profiler::report
+
+
+Use:      Prints the invariant and the stride-predictable
+          instructions.
+
+
+Arguments:
+    os  - Output stream.
+    mem - Memory, to disassemble the instructions listed.
+    top - Most instructions to list in each group.
+
+
+Returns:
+    Nothing.
+***************************************************************/
+void value_profiler::report(std::ostream &os, const memory &mem, uint32_t top)
+{
+    struct row
+    {
+        uint32_t pc;
+        const profile *p;
+        uint32_t value;         // invariant value, or stride
+        double   share;
+    };
+    std::vector<row> invariant, strided;
+    uint64_t execs = 0;
+
+
+    for (const auto &e : profiles)
+    {
+        const profile &p = e.second;
+        execs += p.execs;
+        if (p.execs < min_execs)
+            continue;
+
+
+        uint32_t best = 0;
+        for (uint32_t i = 1; i < p.used; ++i)
+        {
+            if (p.count[i] - p.error[i] > p.count[best] - p.error[best])
+                best = i;
+        }
+        double share = double(p.count[best] - p.error[best]) / p.execs;
+        double hits  = double(p.stride_hits) / (p.execs - 2);
+        if (share >= predictable)
+            invariant.push_back({ e.first, &p, p.value[best], share });
+        else if (p.stride != 0 && hits >= predictable)
+            strided.push_back({ e.first, &p, static_cast<uint32_t>(p.stride), hits });
+    }
+
+
+    auto hottest = [](const row &a, const row &b)
+    {
+        if (a.p->execs != b.p->execs)
+            return a.p->execs > b.p->execs;
+        return a.pc < b.pc;
+    };
+    std::sort(invariant.begin(), invariant.end(), hottest);
+    std::sort(strided.begin(), strided.end(), hottest);
+
+
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+
+
+    os << "Value profile: " << execs << " load/ALU results from " << profiles.size()
+       << " instructions (top " << top_k << " values and a stride detector each)" << std::endl;
+
+
+    auto print = [&](const std::vector<row> &rows, const char *title, const char *what, bool is_stride)
+    {
+        os << "  " << rows.size() << " " << title << std::endl;
+        if (rows.empty())
+            return;
+        os << "  " << std::left << std::setw(12) << "pc" << std::right << std::setw(12) << "execs"
+           << std::setw(12) << what << std::setw(8) << "hit%" << "  insn" << std::endl;
+        for (size_t i = 0; i < rows.size() && i < top; ++i)
+        {
+            const row &r = rows[i];
+            os << "  " << std::left << std::setw(12) << hex::to_hex0x32(r.pc) << std::right
+               << std::setw(12) << r.p->execs << std::setw(12);
+            if (is_stride)
+                os << static_cast<int32_t>(r.value);
+            else
+                os << hex::to_hex0x32(r.value);
+            os << std::setw(8) << 100.0 * r.share
+               << "  " << rv32i_decode::decode(r.pc, mem.get32(r.pc)) << std::endl;
+        }
+    };
+    print(invariant, "invariant instructions (one value):", "value", false);
+    print(strided, "stride-predictable instructions (last value + stride):", "stride", true);
+
+
+    os.flags(flags);
+    os.precision(precision);
+}
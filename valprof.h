@@ -0,0 +1,97 @@
+/********************************************************************************************
+RISC-V Simulator
+
+Programmer:  Aasim Ghani
+
+Purpose:
+    Declares the 'value_profiler' class, which watches the values produced
+    by each static load and ALU instruction, for value prediction and
+    specialisation studies. It finds instructions that nearly always
+    produce the same value (invariant) and ones whose value nearly always
+    moves by a fixed amount from one execution to the next
+    (stride-predictable).
+********************************************************************************************/
+
+
+#ifndef VALPROF_H
+#define VALPROF_H
+
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+
+
+#include "memory.h"
+#include "rv32i_observer.h"
+
+
+/***************************************************************
+Class: value_profiler
+
+
+Use:   Observer that keeps, per static load or ALU instruction,
+       a space-saving sketch of its most frequent results and a
+       stride detector. Both are fixed-size, so memory grows
+       only with the number of distinct instructions executed.
+
+       The sketch holds top_k values with a count each; a value
+       not in a full sketch takes over the slot with the lowest
+       count, inheriting it as its error bound. A value's true
+       count is at least count - error, which is what the
+       invariance test uses.
+
+       The stride detector predicts last value + last stride;
+       an instruction is stride-predictable when most of those
+       predictions hit and the stride is not 0 (a 0 stride is
+       an invariant value).
+
+       Results written to x0 are not seen, so instructions whose
+       rd is x0 are not profiled.
+
+
+Data:
+       profiles - Per instruction address.
+       cur      - Profile of the current instruction, if it is
+                  profiled, until its result arrives.
+***************************************************************/
+class value_profiler : public rv32i_observer
+{
+public:
+    static constexpr uint32_t top_k = 8;
+    static constexpr uint64_t min_execs = 16;       // fewer aren't classified
+    static constexpr double   predictable = 0.9;    // fraction that must hit
+
+
+    void on_insn(uint32_t pc, uint32_t insn) override;
+    void on_reg_write(uint32_t r, uint32_t val) override;
+
+
+    // Print up to top invariant and top stride-predictable
+    // instructions, most executed first, disassembled from mem.
+    void report(std::ostream &os, const memory &mem, uint32_t top);
+
+
+private:
+    struct profile
+    {
+        uint64_t execs = 0;
+        uint32_t used  = 0;             // sketch slots in use
+        uint32_t value[top_k];
+        uint64_t count[top_k];
+        uint64_t error[top_k];
+        uint32_t last   = 0;
+        int32_t  stride = 0;
+        uint64_t stride_hits = 0;       // last + stride predicted it
+    };
+
+
+    static void record(profile &p, uint32_t val);
+
+
+    std::unordered_map<uint32_t, profile> profiles;
+    profile *cur = nullptr;
+};
+
+
+#endif